@@ -8,43 +8,20 @@
 #include <ifaddrs.h>
 #include <net/if.h>
 #include <map>
+#include <vector>
+#include <deque>
 #include <sstream>
-#include <cstdio>
-#include <memory>
-#include <stdexcept>
-#include <regex>
-#include <array>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cerrno>
+#include <ctime>
 #include "../logic/logic.h"
-#include "msg.h"
-
-// Exécute une commande et retourne sa sortie
-std::string execCommand(const char* cmd) {
-    std::array<char, 256> buffer;
-    std::string result;
-    FILE* pipe = popen(cmd, "r");
-    if (!pipe) throw std::runtime_error("popen() a échoué !");
-    while (fgets(buffer.data(), buffer.size(), pipe) != nullptr) {
-        result += buffer.data();
-    }
-    pclose(pipe);
-    return result;
-}
+#include "../logic/wire.h"
 
-// Récupère le débit max configuré (rate) d'une interface via "tc qdisc show"
-std::string getInterfaceRate(const std::string& iface) {
-    std::string cmd = "tc qdisc show dev " + iface;
-    try {
-        std::string tcOutput = execCommand(cmd.c_str());
-        std::regex rateRegex(R"(rate\s+(\d+[KMG]?bit))");
-        std::smatch match;
-        if (std::regex_search(tcOutput, match, rateRegex)) {
-            return match[1];
-        }
-    } catch (...) {
-        // ignore errors silently for this example
-    }
-    return "none";
-}
+// Générateur de charge pour le serveur : une topologie virtuelle de routeurs reliés par des
+// sous-réseaux /24, dont les déclarations sont envoyées en continu au rythme demandé.
+// Options en arguments "nom=valeur" (voir usage()), le rapport sort sur la sortie standard
 
 // Récupère les interfaces actives et leur adresse IP (hors loopback)
 std::map<std::string, std::string> getNetworkInterfacesWithIPs() {
@@ -79,49 +56,312 @@ std::map<std::string, std::string> getNetworkInterfacesWithIPs() {
     return interfaces_info;
 }
 
-// Envoie un message multicast via l'interface donnée
+void usage() {
+    std::cerr << "Usage: client [name=value]...\n"
+              << "  routers=100          virtual routers, named R<router_base + i>\n"
+              << "  links=300            /24 links between two routers (at least routers - 1, all connected)\n"
+              << "  router_base=1000     first router number, away from the real routers\n"
+              << "  pps=1000             datagrams per second (0 = as fast as possible)\n"
+              << "  burst=32             datagrams per sendmmsg\n"
+              << "  duration_ms=10000    how long to send\n"
+              << "  wire_format=text     text or binary\n"
+              << "  datagram_size=1472   declarations packed per datagram up to this size (0 = one per datagram)\n"
+              << "  interfaces=a,b       source interface ips, used in turn (default: every interface but lo)\n"
+              << "  destination=239.0.0.1:8080\n"
+              << "  churn_interval_ms=0  every interval churn_links links change (0 = no churn)\n"
+              << "  churn_links=1\n"
+              << "  churn=mixed          flap (withdrawn / declared again), cost (new random cost) or mixed\n"
+              << "  seed=1               same seed, same topology and same churn\n";
+}
+
+// Un lien virtuel : deux routeurs sur un /24, chacun y déclare son adresse
+struct VirtualLink {
+    int router_a;
+    int router_b;
+    uint32_t network; // 10.128.0.0/9, un /24 par lien
+    int cost;
+    bool up = true;
+};
 
-int main() {
-    std::string interface_ip_for_sending = "10.2.0.4";
+// Les deux déclarations d'un lien avec le timestamp donné (coût LINK_COST_WITHDRAWN si le lien est down)
+void add_link_declarations(const VirtualLink& link, int router_base, long long timestamp, std::vector<RouterDeclaration>& declarations) {
+    int cost = link.up ? link.cost : LINK_COST_WITHDRAWN;
+    for (int side = 0; side < 2; ++side) {
+        RouterDeclaration declaration;
+        declaration.router_name = "R" + std::to_string(router_base + (side == 0 ? link.router_a : link.router_b));
+        declaration.ip_with_mask = uint_to_ip(link.network + 1 + side) + "/24";
+        declaration.link_cost = cost;
+        declaration.timestamp = timestamp;
+        declarations.push_back(declaration);
+    }
+}
 
-    RouterDeclaration router_declaration = create_router_definition("Router1", interface_ip_for_sending + "/24", 10);
-    std::map<std::string, std::map<std::string, RouterDeclaration>> local_lsdb;
-    add_router_declaration(local_lsdb, router_declaration);
-    debug_known_router(local_lsdb);
+// Arbre couvrant aléatoire d'abord pour que tout soit connecté, puis des liens entre routeurs au hasard
+std::vector<VirtualLink> build_topology(int routers, int links, std::mt19937& gen) {
+    std::vector<VirtualLink> topology;
+    std::uniform_int_distribution<> cost_dis(1, 100);
+    for (int i = 0; i < links; ++i) {
+        VirtualLink link;
+        if (i < routers - 1) {
+            link.router_a = i + 1;
+            link.router_b = std::uniform_int_distribution<>(0, i)(gen);
+        } else {
+            link.router_a = std::uniform_int_distribution<>(0, routers - 1)(gen);
+            do {
+                link.router_b = std::uniform_int_distribution<>(0, routers - 1)(gen);
+            } while (routers > 1 && link.router_b == link.router_a);
+        }
+        link.network = (10u << 24) | (128u << 16) | ((uint32_t)i << 8);
+        link.cost = cost_dis(gen);
+        topology.push_back(link);
+    }
+    return topology;
+}
+
+// Les timestamps doivent toujours croître, même pour deux envois dans la même ms
+long long next_timestamp(long long& last_timestamp) {
+    long long now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+    last_timestamp = std::max(now, last_timestamp + 1);
+    return last_timestamp;
+}
 
-    std::map<std::string, std::string> active_interfaces = getNetworkInterfacesWithIPs();
-    
-    if (active_interfaces.empty()) {
-        std::cerr << "No active IPv4 network interfaces found (excluding loopback)." << std::endl;
+long long monotonic_us() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+// Ce qui a été envoyé, au total et depuis le dernier rapport
+struct SendCounters {
+    size_t datagrams = 0;
+    size_t declarations = 0;
+    size_t bytes = 0;
+    size_t errors = 0; // Datagrammes refusés (ENOBUFS, EAGAIN...)
+    size_t churn_events = 0;
+    size_t rounds = 0; // Topologie complète envoyée
+};
+
+int main(int argc, char** argv) {
+    std::map<std::string, std::string> options;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        size_t equal_pos = argument.find('=');
+        if (equal_pos == std::string::npos) {
+            usage();
+            return 1;
+        }
+        options[argument.substr(0, equal_pos)] = argument.substr(equal_pos + 1);
+    }
+    auto option = [&options](const std::string& name, const std::string& default_value) {
+        auto it = options.find(name);
+        return it == options.end() ? default_value : it->second;
+    };
+    auto option_int = [&option](const std::string& name, long long default_value, long long min_value, long long max_value) {
+        long long value = default_value;
+        try {
+            value = std::stoll(option(name, std::to_string(default_value)));
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value for option " << name << ", using " << default_value << std::endl;
+        }
+        return std::min(max_value, std::max(min_value, value));
+    };
+
+    int routers = option_int("routers", 100, 1, 32769); // Assez de liens pour les relier tous
+    int links = option_int("links", 300, std::max(1, routers - 1), 32768); // 32768 /24 dans 10.128.0.0/9
+    int router_base = option_int("router_base", 1000, 0, 999999 - routers);
+    long long pps = option_int("pps", 1000, 0, 100000000);
+    int burst = option_int("burst", 32, 1, 1024);
+    long long duration_ms = option_int("duration_ms", 10000, 1, 86400000);
+    size_t datagram_size = option_int("datagram_size", WIRE_MAX_DATAGRAM_SIZE, 0, 65507);
+    long long churn_interval_ms = option_int("churn_interval_ms", 0, 0, 86400000);
+    int churn_links = option_int("churn_links", 1, 1, links);
+    std::string churn = option("churn", "mixed");
+    WireFormat format = (option("wire_format", "text") == "binary") ? WIRE_FORMAT_BINARY : WIRE_FORMAT_TEXT;
+    std::mt19937 gen(option_int("seed", 1, 0, UINT32_MAX));
+    if (churn != "flap" && churn != "cost" && churn != "mixed") {
+        usage();
         return 1;
     }
 
-    std::ostringstream message_stream;
-
-    // Construction du message dans le format attendu
-    for (const auto& pair : active_interfaces) {
-        const std::string& iface_name = pair.first;
-        const std::string& iface_ip = pair.second;
-        std::string rate = getInterfaceRate(iface_name);
-
-        // Conversion du débit en coût arbitraire pour la démo
-        int cost = 10; // Valeur par défaut
-        if (rate != "none") {
-            if (rate.find("Mbit") != std::string::npos) {
-                cost = 1000 / std::stoi(rate.substr(0, rate.find("Mbit"))); // Exemple : plus le débit est élevé, plus le coût est faible
-            } else if (rate.find("Kbit") != std::string::npos) {
-                cost = 10000 / std::stoi(rate.substr(0, rate.find("Kbit"))); // Plus le débit est faible, plus le coût est élevé
-            }
+    std::string destination_text = option("destination", "239.0.0.1:8080");
+    struct sockaddr_in destination = {};
+    destination.sin_family = AF_INET;
+    size_t colon = destination_text.find(':');
+    destination.sin_port = htons(colon == std::string::npos ? 8080 : std::atoi(destination_text.c_str() + colon + 1));
+    if (inet_aton(destination_text.substr(0, colon).c_str(), &destination.sin_addr) == 0) {
+        std::cerr << "Invalid destination: " << destination_text << std::endl;
+        return 1;
+    }
+
+    // Une socket par interface source, IP_MULTICAST_IF n'est réglé qu'une fois
+    std::vector<std::string> interface_ips;
+    std::stringstream interface_list(option("interfaces", ""));
+    std::string interface_ip;
+    while (std::getline(interface_list, interface_ip, ',')) {
+        if (!interface_ip.empty()) interface_ips.push_back(interface_ip);
+    }
+    if (interface_ips.empty()) {
+        for (const auto& [name, ip] : getNetworkInterfacesWithIPs()) {
+            interface_ips.push_back(ip);
         }
+    }
+    if (interface_ips.empty()) {
+        std::cerr << "No active IPv4 network interfaces found (excluding loopback), use interfaces=" << std::endl;
+        return 1;
+    }
+    std::vector<int> sockets;
+    for (const std::string& ip : interface_ips) {
+        int sock = socket(AF_INET, SOCK_DGRAM, 0);
+        struct in_addr local_interface;
+        if (sock < 0 || inet_aton(ip.c_str(), &local_interface) == 0 ||
+            setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &local_interface, sizeof(local_interface)) < 0) {
+            std::cerr << "Cannot send from " << ip << ": " << strerror(errno) << std::endl;
+            if (sock >= 0) close(sock);
+            for (int opened : sockets) close(opened);
+            return 1;
+        }
+        sockets.push_back(sock);
+    }
 
-        // Exemple : Nom du routeur = nom de l'interface
-        message_stream << iface_name << " " << iface_ip << "/24 " << cost << "; ";
+    std::vector<VirtualLink> topology = build_topology(routers, links, gen);
+    long long last_timestamp = 0;
+
+    std::vector<RouterDeclaration> first_round;
+    for (const VirtualLink& link : topology) {
+        add_link_declarations(link, router_base, 0, first_round);
     }
+    std::cout << "Topology: " << routers << " routers (R" << router_base << "-R" << router_base + routers - 1 << "), "
+              << links << " links, " << first_round.size() << " declarations in "
+              << pack_router_declarations(first_round, format, datagram_size).size() << " datagrams per round" << std::endl;
+    std::cout << "Sending to " << destination_text << " from " << interface_ips.size() << " interface(s) at "
+              << (pps == 0 ? std::string("max") : std::to_string(pps)) << " datagrams/s in bursts of " << burst
+              << " for " << duration_ms << " ms" << std::endl;
+
+    // Les changements passent devant le rafraîchissement de la topologie
+    std::deque<std::pair<std::string, size_t>> churn_queue; // (datagramme, nombre de déclarations)
+    std::deque<std::pair<std::string, size_t>> round_queue;
+    // Les datagrammes de pack_router_declarations, avec le nombre de déclarations de chacun
+    auto enqueue = [format, datagram_size](const std::vector<RouterDeclaration>& declarations, std::deque<std::pair<std::string, size_t>>& queue) {
+        std::vector<size_t> counts;
+        std::vector<std::string> datagrams = pack_router_declarations(declarations, format, datagram_size, counts);
+        for (size_t i = 0; i < datagrams.size(); ++i) {
+            queue.push_back({std::move(datagrams[i]), counts[i]});
+        }
+    };
+
+    SendCounters total;
+    SendCounters last_report;
+    std::vector<struct mmsghdr> messages(burst);
+    std::vector<struct iovec> iovecs(burst);
+    std::vector<std::pair<std::string, size_t>> in_burst;
+    size_t next_socket = 0;
+
+    long long start_us = monotonic_us();
+    long long end_us = start_us + duration_ms * 1000;
+    long long next_report_us = start_us + 1000000;
+    long long next_churn_us = start_us + churn_interval_ms * 1000;
+    std::uniform_int_distribution<> link_dis(0, links - 1);
+    std::uniform_int_distribution<> cost_dis(1, 100);
+
+    std::cout << "time_s\tdatagrams\tdatagrams_per_s\tdeclarations\tbytes\terrors\tchurn_events\trounds" << std::endl;
+    long long now_us = start_us;
+    while (now_us < end_us) {
+        if (churn_interval_ms > 0 && now_us >= next_churn_us) {
+            std::vector<RouterDeclaration> changed;
+            long long timestamp = next_timestamp(last_timestamp);
+            for (int i = 0; i < churn_links; ++i) {
+                VirtualLink& link = topology[link_dis(gen)];
+                bool flap = (churn == "flap") || (churn == "mixed" && gen() % 2 == 0) || !link.up;
+                if (flap) {
+                    link.up = !link.up;
+                } else {
+                    link.cost = cost_dis(gen);
+                }
+                add_link_declarations(link, router_base, timestamp, changed);
+            }
+            enqueue(changed, churn_queue);
+            total.churn_events += churn_links;
+            next_churn_us += churn_interval_ms * 1000;
+        }
+        if (round_queue.empty()) {
+            // Toute la topologie à nouveau, avec un timestamp plus récent pour que le serveur la garde
+            std::vector<RouterDeclaration> round;
+            long long timestamp = next_timestamp(last_timestamp);
+            for (const VirtualLink& link : topology) {
+                if (link.up) add_link_declarations(link, router_base, timestamp, round);
+            }
+            enqueue(round, round_queue);
+            total.rounds++;
+        }
 
-    std::string message = message_stream.str();
-    if (!message.empty() && message.back() == ' ') {
-        message.pop_back(); // On retire l'espace final
+        // Autant de datagrammes que le rythme le permet, par rafales de burst
+        long long due = (pps == 0) ? burst : (long long)((now_us - start_us) * pps / 1000000) - (long long)(total.datagrams + total.errors);
+        int count = std::min<long long>(burst, due);
+        if (count <= 0) {
+            long long wake_us = start_us + (long long)((total.datagrams + total.errors + 1) * 1000000 / pps);
+            wake_us = std::min(wake_us, std::min(end_us, next_report_us));
+            struct timespec wake = {(time_t)(wake_us / 1000000), (long)(wake_us % 1000000) * 1000};
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr);
+        } else {
+            in_burst.clear();
+            while ((int)in_burst.size() < count && (!churn_queue.empty() || !round_queue.empty())) {
+                std::deque<std::pair<std::string, size_t>>& queue = churn_queue.empty() ? round_queue : churn_queue;
+                in_burst.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+            for (size_t i = 0; i < in_burst.size(); ++i) {
+                iovecs[i] = {(void*)in_burst[i].first.data(), in_burst[i].first.size()};
+                messages[i] = {};
+                messages[i].msg_hdr.msg_name = &destination;
+                messages[i].msg_hdr.msg_namelen = sizeof(destination);
+                messages[i].msg_hdr.msg_iov = &iovecs[i];
+                messages[i].msg_hdr.msg_iovlen = 1;
+            }
+
+            // Chaque rafale part d'une interface source différente
+            int sock = sockets[next_socket];
+            next_socket = (next_socket + 1) % sockets.size();
+            size_t done = 0;
+            while (done < in_burst.size()) {
+                int sent = sendmmsg(sock, messages.data() + done, in_burst.size() - done, 0);
+                if (sent <= 0) {
+                    if (errno != EINTR) {
+                        total.errors++; // Ce datagramme est perdu, on passe au suivant
+                        done++;
+                    }
+                    continue;
+                }
+                for (int i = 0; i < sent; ++i) {
+                    total.datagrams++;
+                    total.bytes += messages[done + i].msg_len;
+                    total.declarations += in_burst[done + i].second;
+                }
+                done += sent;
+            }
+        }
+
+        now_us = monotonic_us();
+        if (now_us >= next_report_us || now_us >= end_us) {
+            double elapsed_s = (now_us - start_us) / 1e6;
+            double interval_s = (now_us - (next_report_us - 1000000)) / 1e6;
+            std::cout << elapsed_s << "\t" << total.datagrams << "\t" << (long long)((total.datagrams - last_report.datagrams) / interval_s)
+                      << "\t" << total.declarations << "\t" << total.bytes << "\t" << total.errors << "\t" << total.churn_events
+                      << "\t" << total.rounds << std::endl;
+            last_report = total;
+            next_report_us += 1000000;
+        }
     }
 
-    return send_message(message, interface_ip_for_sending);
+    double elapsed_s = (monotonic_us() - start_us) / 1e6;
+    std::cout << "Sent " << total.datagrams << " datagrams (" << (long long)(total.datagrams / elapsed_s) << "/s), "
+              << total.declarations << " declarations (" << (long long)(total.declarations / elapsed_s) << "/s), "
+              << total.bytes << " bytes in " << elapsed_s << " s, " << total.errors << " send errors, "
+              << total.churn_events << " churn events, " << total.rounds << " rounds" << std::endl;
+
+    for (int sock : sockets) {
+        close(sock);
+    }
+    return total.errors == 0 ? 0 : 2;
 }
@@ -8,9 +8,59 @@
 #include <ifaddrs.h>
 #include <net/if.h>
 #include "../logic/logic.h"
+#include "../logic/lsdb_store.h"
+#include "../logic/wire.h"
+#include "msg.h"
 #include <map>
 #include <bits/chrono.h>
 #include <vector>
+#include <algorithm>
+
+// Encoding used for the declarations we send, every server reads both (see detect_wire_format)
+// Keep text until all the routers are updated, then switch to binary with wire_format=binary in config
+WireFormat outgoing_wire_format = WIRE_FORMAT_TEXT;
+
+void set_wire_format(WireFormat format) {
+    outgoing_wire_format = format;
+}
+
+// Max size of a flooded datagram, 0 sends one declaration per datagram like before because older routers
+// only read the first one. Raise it with flood_datagram_size in config once all the routers unpack batches
+size_t flood_datagram_size = 0;
+
+void set_flood_datagram_size(size_t size) {
+    flood_datagram_size = size;
+}
+
+// Withdrawals (LINK_COST_WITHDRAWN) are only flooded with flood_withdrawals=on in config : an older router would
+// store one as a link with a negative cost. Without them a lost link ages out of the other lsdbs like before
+bool flood_withdrawals = false;
+
+void set_flood_withdrawals(bool enabled) {
+    flood_withdrawals = enabled;
+}
+
+bool get_flood_withdrawals() {
+    return flood_withdrawals;
+}
+
+// The link capacities are only sent with advertise_capacity=on in config : an older router stops reading
+// a datagram at a binary declaration with capacity and refuses a text one with 6 segments
+bool advertise_capacity = false;
+
+void set_advertise_capacity(bool enabled) {
+    advertise_capacity = enabled;
+}
+
+// What we send of the declarations, our own and the relayed ones
+std::vector<RouterDeclaration> outgoing_declarations(std::vector<RouterDeclaration> declarations) {
+    if (!advertise_capacity) {
+        for (RouterDeclaration& declaration : declarations) {
+            declaration.capacity_mbps = 0; // 24 bytes binary or 5 segments text
+        }
+    }
+    return declarations;
+}
 
 int send_message(const std::string& message, const std::string& interface_ip) {
     int sock = socket(AF_INET, SOCK_DGRAM, 0);
@@ -54,7 +104,7 @@ int send_message(const std::string& message, const std::string& interface_ip) {
 
 bool send_router_declaration_to_all(const RouterDeclaration& router_declaration, std::vector<std::string> interfaces) {
     bool success = true;
-    std::string message = serialize_router_definition(router_declaration);
+    std::string message = encode_router_declaration(outgoing_declarations({router_declaration})[0], outgoing_wire_format);
     for (const auto& iface_ip : interfaces) {
         int result = send_message(message, iface_ip);
         if (result != 0) {
@@ -86,3 +136,180 @@ bool send_all_router_declarations_to_all(
     return success;
 }
 
+// What has been flooded since the last reset_flood_counters, to compare the flood modes
+FloodCounters flood_counters;
+
+const FloodCounters& get_flood_counters() {
+    return flood_counters;
+}
+
+void reset_flood_counters() {
+    flood_counters = FloodCounters();
+}
+
+// Sockets kept open between two floods, one per interface ip (IP_MULTICAST_IF is only set once)
+std::map<std::string, int> interface_sockets;
+
+int get_interface_socket(const std::string& interface_ip) {
+    auto it = interface_sockets.find(interface_ip);
+    if (it != interface_sockets.end()) {
+        return it->second;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    struct in_addr local_interface;
+    if (inet_aton(interface_ip.c_str(), &local_interface) == 0) {
+        std::cerr << "Invalid interface IP: " << interface_ip << std::endl;
+        close(sock);
+        return -1;
+    }
+
+    if (setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF,
+                   &local_interface, sizeof(local_interface)) < 0) {
+        perror("setsockopt IP_MULTICAST_IF");
+        close(sock);
+        return -1;
+    }
+
+    interface_sockets[interface_ip] = sock;
+    return sock;
+}
+
+void close_interface_sockets() {
+    for (const auto& [interface_ip, sock] : interface_sockets) {
+        close(sock);
+    }
+    interface_sockets.clear();
+}
+
+// Send the declarations packed in MTU sized datagrams on every interface
+// Returns the number of datagrams sent, or -1 if any send failed
+int send_router_declarations_batched(const std::vector<RouterDeclaration>& declarations, const std::vector<std::string>& interfaces) {
+    std::vector<std::string> datagrams = pack_router_declarations(outgoing_declarations(declarations), outgoing_wire_format, flood_datagram_size);
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(8080);
+    addr.sin_addr.s_addr = inet_addr("239.0.0.1");
+
+    int sent_datagrams = 0;
+    bool success = true;
+    for (const auto& iface_ip : interfaces) {
+        int sock = get_interface_socket(iface_ip);
+        if (sock < 0) {
+            std::cerr << "Failed to send router declarations to interface: " << iface_ip << std::endl;
+            success = false;
+            continue;
+        }
+
+        for (const std::string& datagram : datagrams) {
+            ssize_t sent = sendto(sock, datagram.data(), datagram.size(), 0,
+                                  (struct sockaddr*)&addr, sizeof(addr));
+            if (sent < 0) {
+                perror("sendto");
+                // Maybe the interface changed, the socket will be created again next time
+                close(sock);
+                interface_sockets.erase(iface_ip);
+                success = false;
+                break;
+            }
+            sent_datagrams++;
+            flood_counters.packets++;
+            flood_counters.bytes += sent;
+        }
+    }
+    flood_counters.declarations += declarations.size();
+
+    std::cout << "Flooded " << declarations.size() << " declarations in " << sent_datagrams
+              << " datagrams on " << interfaces.size() << " interfaces" << std::endl;
+    return success ? sent_datagrams : -1;
+}
+
+bool send_all_router_declarations_to_all(const LinkStateStore& local_lsdb, const std::vector<std::string>& interfaces)
+{
+    std::vector<RouterDeclaration> declarations;
+    declarations.reserve(local_lsdb.link_count());
+    for (const PackedLink& link : local_lsdb.get_links()) {
+        declarations.push_back(local_lsdb.to_declaration(link));
+    }
+    // Withdrawn links are sent too until they age out, a router that missed the first one still removes the link
+    if (flood_withdrawals) {
+        std::vector<RouterDeclaration> withdrawals = local_lsdb.get_withdrawn_declarations();
+        declarations.insert(declarations.end(), withdrawals.begin(), withdrawals.end());
+    }
+    return send_router_declarations_batched(declarations, interfaces) >= 0;
+}
+
+// Change sequence of the store up to which everything has already been flooded
+uint64_t last_flooded_sequence = 0;
+
+// After a warm restart the declarations loaded from the checkpoint don't need to be sent again
+void set_last_flooded_sequence(uint64_t sequence)
+{
+    last_flooded_sequence = sequence;
+}
+
+// Only send the declarations added or updated since the last call (new links, newer received ones, refreshes)
+// Returns the number of datagrams sent, or -1 if any send failed
+int flood_changed_declarations(const LinkStateStore& local_lsdb, const std::vector<std::string>& interfaces)
+{
+    if (local_lsdb.get_change_sequence() == last_flooded_sequence) {
+        return 0; // Nothing changed, nothing to send
+    }
+
+    std::vector<RouterDeclaration> declarations = local_lsdb.get_declarations_changed_since(last_flooded_sequence);
+    last_flooded_sequence = local_lsdb.get_change_sequence();
+    if (!flood_withdrawals) {
+        declarations.erase(std::remove_if(declarations.begin(), declarations.end(), [](const RouterDeclaration& declaration) {
+            return declaration.link_cost == LINK_COST_WITHDRAWN;
+        }), declarations.end());
+    }
+    if (declarations.empty()) {
+        return 0; // The changed links have already been cleaned up
+    }
+    return send_router_declarations_batched(declarations, interfaces);
+}
+
+// One hello per interface on the hello port, returns the number of interfaces where it could not be sent
+int send_hello_to_all(const std::string& router_name, const std::vector<std::string>& interfaces_with_mask,
+                      uint32_t hello_interval_ms, uint32_t dead_interval_ms)
+{
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(WIRE_HELLO_PORT);
+    addr.sin_addr.s_addr = inet_addr("239.0.0.1");
+
+    int failed = 0;
+    for (const std::string& iface : interfaces_with_mask) {
+        WireHello hello;
+        hello.router_name = router_name;
+        hello.hello_interval_ms = hello_interval_ms;
+        hello.dead_interval_ms = dead_interval_ms;
+        if (!parse_ip_with_mask(iface, hello.address, hello.prefix_len)) {
+            failed++;
+            continue;
+        }
+
+        uint8_t buffer[WIRE_HELLO_HEADER_SIZE + WIRE_HELLO_MAX_NAME];
+        size_t length = encode_wire_hello(hello, buffer, sizeof(buffer));
+        std::string iface_ip = iface.substr(0, iface.find('/'));
+        int sock = get_interface_socket(iface_ip);
+        if (length == 0 || sock < 0) {
+            failed++;
+            continue;
+        }
+
+        if (sendto(sock, buffer, length, 0, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            perror("sendto hello");
+            close(sock);
+            interface_sockets.erase(iface_ip);
+            failed++;
+        }
+    }
+    return failed;
+}
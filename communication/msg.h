@@ -5,8 +5,31 @@
 #include <map>    // For std::map
 #include <vector> // For std::vector
 #include "../logic/logic.h" // For RouterDeclaration
+#include "../logic/lsdb_store.h" // For LinkStateStore
+#include "../logic/wire.h" // For WireFormat
 
+// Everything sent by the flooding functions
+struct FloodCounters {
+    size_t packets = 0;
+    size_t bytes = 0;
+    size_t declarations = 0;
+};
+
+void set_wire_format(WireFormat format);
+void set_flood_datagram_size(size_t size);
+void set_flood_withdrawals(bool enabled);
+bool get_flood_withdrawals();
+void set_advertise_capacity(bool enabled);
 int send_message(const std::string& message, const std::string& interface_ip);
 bool send_all_router_declarations_to_all(const std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb, const std::vector<std::string>& interfaces);
+bool send_all_router_declarations_to_all(const LinkStateStore& local_lsdb, const std::vector<std::string>& interfaces);
+int send_router_declarations_batched(const std::vector<RouterDeclaration>& declarations, const std::vector<std::string>& interfaces);
+void set_last_flooded_sequence(uint64_t sequence);
+int flood_changed_declarations(const LinkStateStore& local_lsdb, const std::vector<std::string>& interfaces);
+const FloodCounters& get_flood_counters();
+void reset_flood_counters();
+int send_hello_to_all(const std::string& router_name, const std::vector<std::string>& interfaces_with_mask,
+                      uint32_t hello_interval_ms, uint32_t dead_interval_ms);
+void close_interface_sockets();
 
 #endif // MSG_H
\ No newline at end of file
@@ -0,0 +1,963 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstring>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netlink/netlink.h>
+#include <netlink/socket.h>
+#include <netlink/cache.h>
+#include <netlink/route/route.h>
+#include <netlink/route/nexthop.h>
+#include <netlink/route/addr.h>
+#include <netlink/route/link.h>
+#include <cerrno>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/nexthop.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h> // For rtnl_link_stats64
+#include "netlink_manager.h"
+#include "reactor.h" // For monotonic_time_ms
+#include "../logic/fib.h" // For parse_next_hops
+
+NetlinkManager::~NetlinkManager()
+{
+    close();
+}
+
+bool NetlinkManager::open()
+{
+    request_sock = nl_socket_alloc();
+    if (!request_sock) {
+        std::cerr << "Failed to allocate netlink socket" << std::endl;
+        return false;
+    }
+    if (nl_connect(request_sock, NETLINK_ROUTE) < 0) {
+        std::cerr << "Failed to connect netlink socket" << std::endl;
+        close();
+        return false;
+    }
+
+    // ACKs of the batches are read from the reactor, never waited for
+    batch_sock = nl_socket_alloc();
+    if (!batch_sock || nl_connect(batch_sock, NETLINK_ROUTE) < 0) {
+        std::cerr << "Failed to connect netlink batch socket" << std::endl;
+        close();
+        return false;
+    }
+    nl_socket_set_nonblocking(batch_sock);
+    nl_socket_set_buffer_size(batch_sock, 1 << 20, 1 << 20); // Room for the ACKs of a big batch
+
+    // The manager dumps the caches once, then only reads the notifications
+    int err = nl_cache_mngr_alloc(nullptr, NETLINK_ROUTE, NL_AUTO_PROVIDE, &cache_manager);
+    if (err < 0) {
+        std::cerr << "Failed to allocate netlink cache manager: " << nl_geterror(err) << std::endl;
+        close();
+        return false;
+    }
+    err = nl_cache_mngr_add(cache_manager, "route/link", &NetlinkManager::on_cache_change, this, &link_cache);
+    if (err >= 0) {
+        err = nl_cache_mngr_add(cache_manager, "route/addr", &NetlinkManager::on_cache_change, this, &address_cache);
+    }
+    if (err < 0) {
+        std::cerr << "Failed to fill the link and address caches: " << nl_geterror(err) << std::endl;
+        close();
+        return false;
+    }
+
+    rebuild_tables();
+    nexthop_objects_supported = probe_nexthop_objects();
+    use_nexthop_objects = nexthop_objects_supported;
+    std::cout << "Kernel nexthop objects " << (nexthop_objects_supported ? "supported" : "not supported, using per route gateways") << std::endl;
+    std::cout << "Netlink caches ready: " << interfaces.size() << " interfaces, "
+              << prefixes.size() << " IPv4 prefixes" << std::endl;
+    return true;
+}
+
+void NetlinkManager::close()
+{
+    if (cache_manager) {
+        nl_cache_mngr_free(cache_manager); // Also frees the caches
+        cache_manager = nullptr;
+        link_cache = nullptr;
+        address_cache = nullptr;
+    }
+    if (request_sock) {
+        nl_close(request_sock);
+        nl_socket_free(request_sock);
+        request_sock = nullptr;
+    }
+    if (batch_sock) {
+        nl_close(batch_sock);
+        nl_socket_free(batch_sock);
+        batch_sock = nullptr;
+    }
+}
+
+int NetlinkManager::event_fd() const
+{
+    return cache_manager ? nl_cache_mngr_get_fd(cache_manager) : -1;
+}
+
+bool NetlinkManager::process_events()
+{
+    if (!cache_manager) {
+        return false;
+    }
+    tables_changed = false;
+    int err = nl_cache_mngr_data_ready(cache_manager);
+    if (err < 0) {
+        std::cerr << "Failed to read netlink notifications: " << nl_geterror(err) << std::endl;
+    }
+    if (nexthops_need_refresh) {
+        refresh_nexthops();
+    }
+    return tables_changed;
+}
+
+void NetlinkManager::on_cache_change(struct nl_cache*, struct nl_object*, int, void* data)
+{
+    // Only a few interfaces, rebuilding everything is simpler than patching the tables
+    ((NetlinkManager*)data)->rebuild_tables();
+}
+
+void NetlinkManager::rebuild_tables()
+{
+    interfaces.clear();
+    for (struct nl_object* obj = nl_cache_get_first(link_cache); obj != nullptr; obj = nl_cache_get_next(obj)) {
+        struct rtnl_link* link = (struct rtnl_link*)obj;
+        const char* name = rtnl_link_get_name(link);
+        unsigned int flags = rtnl_link_get_flags(link);
+        interfaces[rtnl_link_get_ifindex(link)] = {name ? name : "", (flags & IFF_UP) != 0, (flags & IFF_RUNNING) != 0};
+    }
+
+    prefixes.clear();
+    for (struct nl_object* obj = nl_cache_get_first(address_cache); obj != nullptr; obj = nl_cache_get_next(obj)) {
+        struct rtnl_addr* addr = (struct rtnl_addr*)obj;
+        struct nl_addr* local_addr = rtnl_addr_get_local(addr);
+        if (!local_addr || nl_addr_get_family(local_addr) != AF_INET) continue;
+
+        uint32_t address;
+        memcpy(&address, nl_addr_get_binary_addr(local_addr), sizeof(address));
+        prefixes.push_back({ntohl(address), (uint8_t)rtnl_addr_get_prefixlen(addr), rtnl_addr_get_ifindex(addr)});
+    }
+
+    std::stable_sort(prefixes.begin(), prefixes.end(), [](const InterfacePrefix& a, const InterfacePrefix& b) {
+        return a.prefix_len > b.prefix_len;
+    });
+
+    // Nexthops are not sent from the cache callback, process_events does it once the batch of changes is read
+    nexthops_need_refresh = !nexthops.empty();
+    tables_changed = true;
+}
+
+bool NetlinkManager::address_usable(uint32_t address) const
+{
+    for (const InterfacePrefix& prefix : prefixes) {
+        if (prefix.address != address) continue;
+        auto it = interfaces.find(prefix.ifindex);
+        return it != interfaces.end() && it->second.up && it->second.running;
+    }
+    return false; // Address removed from the interface
+}
+
+int NetlinkManager::find_ifindex_for_gateway(uint32_t gateway) const
+{
+    for (const InterfacePrefix& prefix : prefixes) {
+        uint32_t mask = (prefix.prefix_len == 0) ? 0 : (0xFFFFFFFF << (32 - prefix.prefix_len));
+        if ((gateway & mask) == prefix.network()) {
+            return prefix.ifindex;
+        }
+    }
+    return 0;
+}
+
+// A dump of the nexthop objects only works on kernels that have them
+bool NetlinkManager::probe_nexthop_objects()
+{
+    struct nhmsg header{};
+    header.nh_family = AF_UNSPEC;
+    if (nl_send_simple(request_sock, RTM_GETNEXTHOP, NLM_F_DUMP, &header, sizeof(header)) < 0) {
+        return false;
+    }
+    return nl_recvmsgs_default(request_sock) >= 0;
+}
+
+// Create (or move to a new interface) the nexthop object of a neighbor, one request per neighbor
+int NetlinkManager::ensure_nexthop(uint32_t gateway, int ifindex)
+{
+    auto it = nexthops.find(gateway);
+    if (it != nexthops.end() && it->second.ifindex == ifindex) {
+        return it->second.id;
+    }
+    uint32_t id = (it != nexthops.end()) ? it->second.id : next_nexthop_id++;
+
+    struct nl_msg* msg = nlmsg_alloc_simple(RTM_NEWNEXTHOP, NLM_F_CREATE | NLM_F_REPLACE);
+    if (!msg) {
+        return 0;
+    }
+    struct nhmsg header{};
+    header.nh_family = AF_INET;
+    header.nh_protocol = route_protocol;
+    uint32_t gateway_network = htonl(gateway);
+    if (nlmsg_append(msg, &header, sizeof(header), NLMSG_ALIGNTO) < 0 ||
+        nla_put_u32(msg, NHA_ID, id) < 0 ||
+        nla_put_u32(msg, NHA_OIF, ifindex) < 0 ||
+        nla_put(msg, NHA_GATEWAY, sizeof(gateway_network), &gateway_network) < 0) {
+        nlmsg_free(msg);
+        return 0;
+    }
+
+    int err = nl_send_sync(request_sock, msg); // Frees msg
+    requests_sent++;
+    if (err < 0) {
+        std::cerr << "Failed to create nexthop " << id << ": " << nl_geterror(err) << std::endl;
+        return 0;
+    }
+    nexthops[gateway] = {id, ifindex};
+    return id;
+}
+
+void NetlinkManager::refresh_nexthops()
+{
+    nexthops_need_refresh = false;
+    std::vector<uint32_t> gateways;
+    for (const auto& [gateway, nexthop] : nexthops) {
+        gateways.push_back(gateway);
+    }
+
+    for (uint32_t gateway : gateways) {
+        int ifindex = find_ifindex_for_gateway(gateway);
+        if (ifindex != 0 && ifindex != nexthops[gateway].ifindex) {
+            // Every route using it follows in the same operation
+            ensure_nexthop(gateway, ifindex);
+        }
+    }
+}
+
+// Group of the member nexthops with their weights, one per set of next hops
+uint32_t NetlinkManager::ensure_nexthop_group(const std::string& next_hops, const std::vector<MultipathMember>& members)
+{
+    auto it = nexthop_groups.find(next_hops);
+    if (it != nexthop_groups.end()) {
+        return it->second;
+    }
+
+    std::vector<struct nexthop_grp> group;
+    for (const MultipathMember& member : members) {
+        struct nexthop_grp entry{};
+        entry.id = ensure_nexthop(member.gateway, member.ifindex);
+        entry.weight = member.weight - 1; // The kernel adds one
+        if (entry.id == 0) {
+            return 0;
+        }
+        group.push_back(entry);
+    }
+
+    uint32_t id = next_nexthop_id++;
+    struct nl_msg* msg = nlmsg_alloc_simple(RTM_NEWNEXTHOP, NLM_F_CREATE | NLM_F_REPLACE);
+    if (!msg) {
+        return 0;
+    }
+    struct nhmsg header{};
+    header.nh_family = AF_UNSPEC; // Groups have no family of their own
+    header.nh_protocol = route_protocol;
+    if (nlmsg_append(msg, &header, sizeof(header), NLMSG_ALIGNTO) < 0 ||
+        nla_put_u32(msg, NHA_ID, id) < 0 ||
+        nla_put(msg, NHA_GROUP, group.size() * sizeof(struct nexthop_grp), group.data()) < 0) {
+        nlmsg_free(msg);
+        return 0;
+    }
+
+    int err = nl_send_sync(request_sock, msg);
+    requests_sent++;
+    if (err < 0) {
+        std::cerr << "Failed to create nexthop group " << id << " (" << next_hops << "): " << nl_geterror(err) << std::endl;
+        return 0;
+    }
+    nexthop_groups[next_hops] = id;
+    return id;
+}
+
+bool NetlinkManager::delete_nexthop_object(uint32_t id)
+{
+    struct nl_msg* msg = nlmsg_alloc_simple(RTM_DELNEXTHOP, 0);
+    if (!msg) {
+        return false;
+    }
+    struct nhmsg header{};
+    header.nh_family = AF_UNSPEC;
+    if (nlmsg_append(msg, &header, sizeof(header), NLMSG_ALIGNTO) < 0 || nla_put_u32(msg, NHA_ID, id) < 0) {
+        nlmsg_free(msg);
+        return false;
+    }
+
+    int err = nl_send_sync(request_sock, msg);
+    requests_sent++;
+    if (err < 0 && err != -NLE_OBJ_NOTFOUND) {
+        std::cerr << "Failed to delete nexthop " << id << ": " << nl_geterror(err) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool NetlinkManager::remove_nexthop(const std::string& next_hop)
+{
+    struct in_addr address;
+    if (!use_nexthop_objects || inet_pton(AF_INET, next_hop.c_str(), &address) != 1) {
+        return false;
+    }
+    auto it = nexthops.find(ntohl(address.s_addr));
+    if (it == nexthops.end()) {
+        return false;
+    }
+    // A route added through this neighbor before the delete gets a new object, the old one only has stale routes
+    released_nexthops.push_back(it->second.id);
+    nexthops.erase(it);
+    return true;
+}
+
+// The routes moved off a released nexthop must be replaced before it goes, or they would go with it
+void NetlinkManager::delete_released_nexthops()
+{
+    if (pending_route_operations() != 0) {
+        return;
+    }
+    // The kernel takes them out of their groups, remove_unused_nexthop_groups deletes the groups
+    for (uint32_t id : released_nexthops) {
+        delete_nexthop_object(id);
+    }
+    released_nexthops.clear();
+}
+
+void NetlinkManager::remove_unused_nexthop_groups(const std::set<std::string>& wanted_next_hops)
+{
+    for (auto group = nexthop_groups.begin(); group != nexthop_groups.end();) {
+        if (wanted_next_hops.count(group->first) == 0 && delete_nexthop_object(group->second)) {
+            std::cout << "[INFO] Removed nexthop group " << group->second << " (" << group->first << ")" << std::endl;
+            group = nexthop_groups.erase(group);
+        } else {
+            ++group;
+        }
+    }
+}
+
+// Fill a route to destination via next_hop (no nexthop if next_hop is empty), the caller owns the returned route
+struct rtnl_route* NetlinkManager::build_route(const std::string& destination, const std::string& next_hop, int ifindex, int& err) const
+{
+    struct nl_addr *dst_addr = nullptr, *gw_addr = nullptr;
+    if ((err = nl_addr_parse(destination.c_str(), AF_INET, &dst_addr)) < 0) {
+        std::cerr << "Invalid destination address: " << destination << std::endl;
+        return nullptr;
+    }
+    if (next_hop.empty()) {
+        struct rtnl_route* route = rtnl_route_alloc();
+        if (!route) {
+            nl_addr_put(dst_addr);
+            err = -NLE_NOMEM;
+            return nullptr;
+        }
+        rtnl_route_set_family(route, AF_INET);
+        rtnl_route_set_dst(route, dst_addr);
+        rtnl_route_set_protocol(route, route_protocol);
+        rtnl_route_set_table(route, route_table);
+        rtnl_route_set_scope(route, RT_SCOPE_UNIVERSE); // libnl would guess link scope without a gateway
+        nl_addr_put(dst_addr);
+        err = 0;
+        return route;
+    }
+    if ((err = nl_addr_parse(next_hop.c_str(), AF_INET, &gw_addr)) < 0) {
+        std::cerr << "Invalid gateway address: " << next_hop << std::endl;
+        nl_addr_put(dst_addr);
+        return nullptr;
+    }
+
+    struct rtnl_route* route = rtnl_route_alloc();
+    struct rtnl_nexthop* nh = rtnl_route_nh_alloc();
+    if (!route || !nh) {
+        std::cerr << "Failed to allocate route" << std::endl;
+        if (route) rtnl_route_put(route);
+        if (nh) rtnl_route_nh_free(nh);
+        nl_addr_put(dst_addr);
+        nl_addr_put(gw_addr);
+        err = -NLE_NOMEM;
+        return nullptr;
+    }
+
+    rtnl_route_set_family(route, AF_INET);
+    rtnl_route_set_dst(route, dst_addr);
+    rtnl_route_set_protocol(route, route_protocol); // Our routes are found (and only ours deleted) with it
+    rtnl_route_set_table(route, route_table);
+    rtnl_route_nh_set_gateway(nh, gw_addr);
+    if (ifindex > 0) {
+        rtnl_route_nh_set_ifindex(nh, ifindex);
+    }
+    rtnl_route_add_nexthop(route, nh);
+
+    // The route keeps its own references
+    nl_addr_put(dst_addr);
+    nl_addr_put(gw_addr);
+    err = 0;
+    return route;
+}
+
+// Route with one nexthop per member (RTA_MULTIPATH), for when nexthop objects are not used
+struct rtnl_route* NetlinkManager::build_multipath_route(const std::string& destination, const std::vector<MultipathMember>& members, int& err) const
+{
+    struct rtnl_route* route = build_route(destination, "", 0, err);
+    if (!route) {
+        return nullptr;
+    }
+    for (const MultipathMember& member : members) {
+        struct nl_addr* gw_addr = nullptr;
+        struct rtnl_nexthop* nh = rtnl_route_nh_alloc();
+        if (!nh || (err = nl_addr_parse(member.address.c_str(), AF_INET, &gw_addr)) < 0) {
+            std::cerr << "Invalid gateway address: " << member.address << std::endl;
+            if (nh) rtnl_route_nh_free(nh);
+            rtnl_route_put(route);
+            err = nh ? err : -NLE_NOMEM;
+            return nullptr;
+        }
+        rtnl_route_nh_set_gateway(nh, gw_addr);
+        rtnl_route_nh_set_ifindex(nh, member.ifindex);
+        rtnl_route_nh_set_weight(nh, member.weight - 1); // Sent as rtnh_hops, the kernel adds one
+        rtnl_route_add_nexthop(route, nh);
+        nl_addr_put(gw_addr);
+    }
+    err = 0;
+    return route;
+}
+
+int NetlinkManager::add_route(const std::string& destination, const std::string& next_hop)
+{
+    if (!request_sock) {
+        return -NLE_BAD_SOCK;
+    }
+
+    struct in_addr gateway;
+    if (inet_pton(AF_INET, next_hop.c_str(), &gateway) != 1) {
+        std::cerr << "Invalid gateway address: " << next_hop << std::endl;
+        return -NLE_INVAL;
+    }
+    int ifindex = find_ifindex_for_gateway(ntohl(gateway.s_addr));
+    if (ifindex == 0) {
+        std::cerr << "No interface found on the same network as gateway " << next_hop << std::endl;
+        return -NLE_NOADDR;
+    }
+
+    int err;
+    struct rtnl_route* route = build_route(destination, next_hop, ifindex, err);
+    if (!route) {
+        return err;
+    }
+
+    // Replace takes the place of the old route to the same destination in one message
+    err = rtnl_route_add(request_sock, route, NLM_F_CREATE | NLM_F_REPLACE);
+    requests_sent++;
+    rtnl_route_put(route);
+    return err;
+}
+
+int NetlinkManager::delete_route(const std::string& destination, const std::string& next_hop)
+{
+    if (!request_sock) {
+        return -NLE_BAD_SOCK;
+    }
+
+    int err;
+    struct rtnl_route* route = build_route(destination, use_nexthop_objects ? "" : next_hop, 0, err);
+    if (!route) {
+        return err;
+    }
+
+    err = rtnl_route_delete(request_sock, route, 0);
+    requests_sent++;
+    rtnl_route_put(route);
+    return err;
+}
+
+void NetlinkManager::queue_route_operation(const RouteOperation& operation)
+{
+    // Only the last wanted state of a destination matters
+    queued_operations[operation.destination] = operation;
+}
+
+int NetlinkManager::batch_fd() const
+{
+    return batch_sock ? nl_socket_get_fd(batch_sock) : -1;
+}
+
+void NetlinkManager::complete_route_operation(const RouteOperation& operation, int error)
+{
+    // Asking to delete a route that is already gone is not a failure
+    if (operation.type == ROUTE_DELETE && error == -ESRCH) {
+        error = 0;
+    }
+
+    bool superseded = queued_operations.find(operation.destination) != queued_operations.end();
+    for (const auto& [sequence, in_flight] : in_flight_operations) {
+        superseded = superseded || in_flight.destination == operation.destination;
+    }
+
+    if (error != 0 && operation.attempts < MAX_ROUTE_ATTEMPTS && !superseded) {
+        // Retry later with a backoff (500 ms, 1 s, 2 s...), unless a newer operation for this destination exists
+        RouteOperation retry = operation;
+        retry.retry_at_ms = monotonic_time_ms() + (500LL << (operation.attempts - 1));
+        queued_operations[retry.destination] = retry;
+        return;
+    }
+
+    if (error != 0) {
+        route_operations_failed++;
+        std::cerr << "Failed to " << (operation.type == ROUTE_ADD ? "add" : "delete") << " route "
+                  << operation.destination << " via " << operation.next_hop << " after " << operation.attempts
+                  << " attempt(s): " << strerror(-error) << std::endl;
+    }
+    if (route_completion) {
+        route_completion(operation, error);
+    }
+}
+
+size_t NetlinkManager::flush_route_operations()
+{
+    if (!batch_sock || queued_operations.empty()) {
+        delete_released_nexthops();
+        return 0;
+    }
+
+    long long now = monotonic_time_ms();
+    std::vector<char> batch;
+    batch.reserve(MAX_BATCH_BYTES);
+    std::vector<uint32_t> batch_sequences;
+    size_t sent = 0;
+
+    struct sockaddr_nl kernel{};
+    kernel.nl_family = AF_NETLINK;
+
+    // Sends what is in batch, returns false if the socket is full (the operations are queued again)
+    auto send_batch = [&]() -> bool {
+        if (batch.empty()) return true;
+        ssize_t ret = sendto(nl_socket_get_fd(batch_sock), batch.data(), batch.size(), 0,
+                             (struct sockaddr*)&kernel, sizeof(kernel));
+        if (ret < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("sendto netlink batch");
+            }
+            for (uint32_t sequence : batch_sequences) {
+                RouteOperation& operation = in_flight_operations[sequence];
+                if (queued_operations.find(operation.destination) == queued_operations.end()) {
+                    queued_operations[operation.destination] = operation;
+                }
+                in_flight_operations.erase(sequence);
+            }
+            batch.clear();
+            batch_sequences.clear();
+            return false;
+        }
+        sent += batch_sequences.size();
+        requests_sent += batch_sequences.size();
+        batch.clear();
+        batch_sequences.clear();
+        return true;
+    };
+
+    if (in_flight_operations.empty()) {
+        batch_start_ms = now;
+        batch_completed = 0;
+    }
+
+    auto it = queued_operations.begin();
+    while (it != queued_operations.end()) {
+        RouteOperation operation = it->second;
+        if (operation.retry_at_ms > now) {
+            ++it;
+            continue;
+        }
+        it = queued_operations.erase(it);
+        operation.attempts++;
+
+        int ifindex = 0;
+        uint32_t nexthop_id = 0;
+        std::vector<MultipathMember> members; // The next hops we have an interface for
+        for (const NextHop& next_hop : parse_next_hops(operation.next_hop)) {
+            struct in_addr gateway;
+            if (inet_pton(AF_INET, next_hop.address.c_str(), &gateway) != 1) continue;
+            int member_ifindex = find_ifindex_for_gateway(ntohl(gateway.s_addr));
+            if (member_ifindex != 0) {
+                members.push_back({next_hop.address, ntohl(gateway.s_addr), member_ifindex, next_hop.weight});
+            }
+        }
+        if (operation.type == ROUTE_ADD) {
+            if (members.empty()) {
+                complete_route_operation(operation, -ENETUNREACH); // The interface may come back, so retried
+                continue;
+            }
+            ifindex = members[0].ifindex;
+            if (use_nexthop_objects && members.size() == 1) {
+                nexthop_id = ensure_nexthop(members[0].gateway, ifindex); // 0 falls back to the gateway
+            }
+            else if (use_nexthop_objects && members.size() == parse_next_hops(operation.next_hop).size()) {
+                nexthop_id = ensure_nexthop_group(operation.next_hop, members); // 0 falls back to RTA_MULTIPATH
+            }
+        }
+
+        int err;
+        // A route using a nexthop object or several next hops is deleted by destination only
+        bool without_gateway = nexthop_id != 0 || (operation.type == ROUTE_DELETE && (use_nexthop_objects || members.size() != 1));
+        struct rtnl_route* route = nullptr;
+        if (operation.type == ROUTE_ADD && nexthop_id == 0 && members.size() > 1) {
+            route = build_multipath_route(operation.destination, members, err);
+        } else {
+            route = build_route(operation.destination, without_gateway ? "" : members[0].address, ifindex, err);
+        }
+        if (!route) {
+            operation.attempts = MAX_ROUTE_ATTEMPTS; // Bad address, no need to retry
+            complete_route_operation(operation, -EINVAL);
+            continue;
+        }
+
+        struct nl_msg* msg = nullptr;
+        if (operation.type == ROUTE_ADD) {
+            err = rtnl_route_build_add_request(route, NLM_F_CREATE | NLM_F_REPLACE, &msg);
+        } else {
+            err = rtnl_route_build_del_request(route, 0, &msg);
+        }
+        rtnl_route_put(route);
+        if (err >= 0 && nexthop_id != 0) {
+            err = nla_put_u32(msg, RTA_NH_ID, nexthop_id);
+        }
+        if (err < 0) {
+            if (msg) nlmsg_free(msg);
+            operation.attempts = MAX_ROUTE_ATTEMPTS;
+            complete_route_operation(operation, -EINVAL);
+            continue;
+        }
+
+        // Each message asks for its own ACK so errors can be matched to the route
+        struct nlmsghdr* header = nlmsg_hdr(msg);
+        header->nlmsg_flags |= NLM_F_REQUEST | NLM_F_ACK; // nl_send_auto would add them, we send the raw bytes
+        header->nlmsg_seq = next_sequence++;
+        header->nlmsg_pid = nl_socket_get_local_port(batch_sock);
+
+        size_t length = NLMSG_ALIGN(header->nlmsg_len);
+        if (batch.size() + length > MAX_BATCH_BYTES && !send_batch()) {
+            queued_operations[operation.destination] = operation;
+            nlmsg_free(msg);
+            break;
+        }
+        batch.insert(batch.end(), (const char*)header, (const char*)header + length);
+        batch_sequences.push_back(header->nlmsg_seq);
+        in_flight_operations[header->nlmsg_seq] = operation;
+        nlmsg_free(msg);
+    }
+    send_batch();
+    delete_released_nexthops(); // Only if every operation failed before being sent
+    return sent;
+}
+
+void NetlinkManager::process_route_acks()
+{
+    if (!batch_sock) {
+        return;
+    }
+
+    char buffer[16384];
+    while (true) {
+        ssize_t len = recv(nl_socket_get_fd(batch_sock), buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (len < 0) {
+            if (errno == ENOBUFS) {
+                // Some ACKs were lost, send everything again (replace and delete can be repeated safely)
+                std::cerr << "Netlink ACKs lost, resending " << in_flight_operations.size() << " route operation(s)" << std::endl;
+                for (const auto& [sequence, operation] : in_flight_operations) {
+                    if (queued_operations.find(operation.destination) == queued_operations.end()) {
+                        queued_operations[operation.destination] = operation;
+                    }
+                }
+                in_flight_operations.clear();
+                continue;
+            }
+            break; // EAGAIN : everything has been read
+        }
+
+        for (struct nlmsghdr* header = (struct nlmsghdr*)buffer; NLMSG_OK(header, (size_t)len); header = NLMSG_NEXT(header, len)) {
+            if (header->nlmsg_type != NLMSG_ERROR) continue;
+
+            auto it = in_flight_operations.find(header->nlmsg_seq);
+            if (it == in_flight_operations.end()) continue;
+
+            const struct nlmsgerr* ack = (const struct nlmsgerr*)NLMSG_DATA(header);
+            RouteOperation operation = it->second;
+            in_flight_operations.erase(it);
+            if (ack->error == 0) {
+                batch_completed++;
+            }
+            complete_route_operation(operation, ack->error);
+        }
+    }
+
+    if (in_flight_operations.empty() && batch_completed > 0) {
+        long long elapsed_ms = std::max(1LL, monotonic_time_ms() - batch_start_ms);
+        last_batch_routes_per_second = batch_completed * 1000.0 / elapsed_ms;
+        std::cout << "Programmed " << batch_completed << " route(s) in " << elapsed_ms << " ms ("
+                  << last_batch_routes_per_second << " routes/s)" << std::endl;
+        batch_completed = 0;
+    }
+    delete_released_nexthops();
+}
+
+// Our nexthop objects left by a previous run, from a dump of all the nexthops
+struct OwnNexthopDump {
+    uint8_t protocol;
+    std::map<uint32_t, std::pair<uint32_t, int>> nexthops; // Id -> (gateway in host order, ifindex)
+    std::map<uint32_t, std::vector<struct nexthop_grp>> groups; // Id -> members
+};
+
+static int collect_own_nexthop(struct nl_msg* msg, void* arg)
+{
+    auto* dump = (OwnNexthopDump*)arg;
+    struct nlmsghdr* header = nlmsg_hdr(msg);
+    if (header->nlmsg_type != RTM_NEWNEXTHOP) return NL_OK;
+
+    const struct nhmsg* nexthop = (const struct nhmsg*)nlmsg_data(header);
+    struct nlattr* attributes[NHA_MAX + 1];
+    if (nexthop->nh_protocol != dump->protocol ||
+        nlmsg_parse(header, sizeof(struct nhmsg), attributes, NHA_MAX, nullptr) < 0 || !attributes[NHA_ID]) {
+        return NL_OK;
+    }
+
+    if (attributes[NHA_GROUP]) {
+        const struct nexthop_grp* members = (const struct nexthop_grp*)nla_data(attributes[NHA_GROUP]);
+        size_t count = nla_len(attributes[NHA_GROUP]) / sizeof(struct nexthop_grp);
+        dump->groups[nla_get_u32(attributes[NHA_ID])] = std::vector<struct nexthop_grp>(members, members + count);
+        return NL_OK;
+    }
+
+    uint32_t gateway = 0;
+    if (attributes[NHA_GATEWAY] && nla_len(attributes[NHA_GATEWAY]) == sizeof(gateway)) {
+        memcpy(&gateway, nla_data(attributes[NHA_GATEWAY]), sizeof(gateway));
+    }
+    int ifindex = attributes[NHA_OIF] ? nla_get_u32(attributes[NHA_OIF]) : 0;
+    dump->nexthops[nla_get_u32(attributes[NHA_ID])] = {ntohl(gateway), ifindex};
+    return NL_OK;
+}
+
+struct OwnRouteDump {
+    uint8_t protocol;
+    uint32_t table;
+    std::vector<std::string> destinations;
+    std::vector<uint32_t> gateways; // Same order as destinations, 0 if the route uses a nexthop object
+    std::vector<uint32_t> nexthop_ids; // Same order as destinations, 0 if the route has its own gateway
+};
+
+static int collect_own_route(struct nl_msg* msg, void* arg)
+{
+    auto* dump = (OwnRouteDump*)arg;
+    struct nlmsghdr* header = nlmsg_hdr(msg);
+    if (header->nlmsg_type != RTM_NEWROUTE) return NL_OK;
+
+    const struct rtmsg* route = (const struct rtmsg*)nlmsg_data(header);
+    struct nlattr* attributes[RTA_MAX + 1];
+    if (route->rtm_family != AF_INET || nlmsg_parse(header, sizeof(struct rtmsg), attributes, RTA_MAX, nullptr) < 0) {
+        return NL_OK;
+    }
+    uint32_t table = attributes[RTA_TABLE] ? nla_get_u32(attributes[RTA_TABLE]) : route->rtm_table;
+
+    // Old kernels ignore the dump filter, so check again here
+    if (route->rtm_protocol != dump->protocol || table != dump->table) {
+        return NL_OK;
+    }
+
+    uint32_t destination = 0;
+    if (attributes[RTA_DST]) {
+        memcpy(&destination, nla_data(attributes[RTA_DST]), sizeof(destination));
+    }
+    char text[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &destination, text, sizeof(text));
+    dump->destinations.push_back(std::string(text) + "/" + std::to_string(route->rtm_dst_len));
+
+    uint32_t gateway = 0;
+    if (attributes[RTA_GATEWAY] && nla_len(attributes[RTA_GATEWAY]) == sizeof(gateway)) {
+        memcpy(&gateway, nla_data(attributes[RTA_GATEWAY]), sizeof(gateway));
+    }
+    dump->gateways.push_back(ntohl(gateway));
+    dump->nexthop_ids.push_back(attributes[RTA_NH_ID] ? nla_get_u32(attributes[RTA_NH_ID]) : 0);
+    return NL_OK;
+}
+
+// Send a dump request on a fresh socket and give every answer to callback
+static int dump_with_callback(int type, const void* header, size_t header_size, const void* filter_attribute, int filter_type, size_t filter_size, nl_recvmsg_msg_cb_t callback, void* arg)
+{
+    struct nl_sock* sock = nl_socket_alloc();
+    if (!sock) return -NLE_NOMEM;
+    int err = nl_connect(sock, NETLINK_ROUTE);
+    if (err < 0) {
+        nl_socket_free(sock);
+        return err;
+    }
+
+    // With strict checking the kernel only sends the entries matching the header and attributes
+    int strict = 1;
+    setsockopt(nl_socket_get_fd(sock), SOL_NETLINK, NETLINK_GET_STRICT_CHK, &strict, sizeof(strict));
+
+    struct nl_msg* msg = nlmsg_alloc_simple(type, NLM_F_DUMP);
+    if (!msg || nlmsg_append(msg, (void*)header, header_size, NLMSG_ALIGNTO) < 0 ||
+        (filter_attribute && nla_put(msg, filter_type, filter_size, filter_attribute) < 0)) {
+        if (msg) nlmsg_free(msg);
+        nl_close(sock);
+        nl_socket_free(sock);
+        return -NLE_NOMEM;
+    }
+
+    nl_socket_modify_cb(sock, NL_CB_VALID, NL_CB_CUSTOM, callback, arg);
+    err = nl_send_auto(sock, msg);
+    nlmsg_free(msg);
+    if (err >= 0) {
+        err = nl_recvmsgs_default(sock);
+    }
+    nl_close(sock);
+    nl_socket_free(sock);
+    return err;
+}
+
+static int collect_link_counters(struct nl_msg* msg, void* arg)
+{
+    auto* counters = (std::map<int, LinkCounters>*)arg;
+    struct nlmsghdr* header = nlmsg_hdr(msg);
+    if (header->nlmsg_type != RTM_NEWLINK) return NL_OK;
+
+    const struct ifinfomsg* link = (const struct ifinfomsg*)nlmsg_data(header);
+    struct nlattr* attributes[IFLA_MAX + 1];
+    if (nlmsg_parse(header, sizeof(struct ifinfomsg), attributes, IFLA_MAX, nullptr) < 0 || !attributes[IFLA_STATS64] ||
+        nla_len(attributes[IFLA_STATS64]) < (int)sizeof(struct rtnl_link_stats64)) {
+        return NL_OK;
+    }
+    struct rtnl_link_stats64 stats;
+    memcpy(&stats, nla_data(attributes[IFLA_STATS64]), sizeof(stats)); // Attributes are only 4 byte aligned
+    (*counters)[link->ifi_index] = {stats.rx_bytes, stats.tx_bytes};
+    return NL_OK;
+}
+
+bool NetlinkManager::read_link_counters(std::map<int, LinkCounters>& counters) const
+{
+    struct ifinfomsg header{};
+    header.ifi_family = AF_UNSPEC;
+    int err = dump_with_callback(RTM_GETLINK, &header, sizeof(header), nullptr, 0, 0, collect_link_counters, &counters);
+    if (err < 0) {
+        std::cerr << "Failed to read the interface counters: " << nl_geterror(err) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+OwnRouteDump NetlinkManager::dump_own_routes() const
+{
+    OwnRouteDump dump{route_protocol, route_table, {}, {}, {}};
+    struct rtmsg header{};
+    header.rtm_family = AF_INET;
+    header.rtm_protocol = route_protocol;
+    header.rtm_table = route_table < 256 ? route_table : RT_TABLE_UNSPEC;
+    int err = dump_with_callback(RTM_GETROUTE, &header, sizeof(header), &route_table, RTA_TABLE, sizeof(route_table), collect_own_route, &dump);
+    if (err < 0) {
+        std::cerr << "Failed to dump our routes: " << nl_geterror(err) << std::endl;
+    }
+    return dump;
+}
+
+// Warm restart : take back the routes and nexthops of the previous run instead of removing them
+size_t NetlinkManager::read_own_routes(std::map<std::string, std::string>& installed_routes)
+{
+    auto gateway_text = [](uint32_t gateway) {
+        struct in_addr address;
+        address.s_addr = htonl(gateway);
+        char text[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &address, text, sizeof(text));
+        return std::string(text);
+    };
+
+    std::map<uint32_t, std::string> nexthop_texts; // Id -> next hop as in the route tables
+    if (nexthop_objects_supported) {
+        OwnNexthopDump own_nexthops{route_protocol, {}, {}};
+        struct nhmsg header{};
+        header.nh_family = AF_UNSPEC;
+        dump_with_callback(RTM_GETNEXTHOP, &header, sizeof(header), nullptr, 0, 0, collect_own_nexthop, &own_nexthops);
+
+        std::map<uint32_t, uint32_t> nexthop_gateways; // Id -> gateway
+        for (const auto& [id, nexthop] : own_nexthops.nexthops) {
+            nexthop_gateways[id] = nexthop.first;
+            nexthop_texts[id] = gateway_text(nexthop.first);
+            nexthops[nexthop.first] = {id, nexthop.second}; // Reused by the next installs
+            next_nexthop_id = std::max(next_nexthop_id, id + 1);
+        }
+        for (const auto& [id, members] : own_nexthops.groups) {
+            // Written back sorted by address like compute_all_routes does
+            std::vector<std::pair<uint32_t, int>> gateways;
+            for (const struct nexthop_grp& member : members) {
+                auto it = nexthop_gateways.find(member.id);
+                if (it != nexthop_gateways.end()) {
+                    gateways.push_back({it->second, member.weight + 1});
+                }
+            }
+            std::sort(gateways.begin(), gateways.end());
+            std::vector<NextHop> next_hops;
+            for (const auto& [gateway, weight] : gateways) {
+                next_hops.push_back({gateway_text(gateway), weight});
+            }
+            nexthop_texts[id] = format_next_hops(next_hops);
+            nexthop_groups[nexthop_texts[id]] = id;
+            next_nexthop_id = std::max(next_nexthop_id, id + 1);
+        }
+    }
+
+    OwnRouteDump dump = dump_own_routes();
+    for (size_t i = 0; i < dump.destinations.size(); ++i) {
+        std::string next_hop;
+        if (dump.nexthop_ids[i] != 0) {
+            auto it = nexthop_texts.find(dump.nexthop_ids[i]);
+            next_hop = (it != nexthop_texts.end()) ? it->second : "";
+        } else if (dump.gateways[i] != 0) {
+            next_hop = gateway_text(dump.gateways[i]);
+        }
+        if (next_hop.empty()) continue;
+        installed_routes[dump.destinations[i]] = next_hop;
+    }
+    return installed_routes.size();
+}
+
+size_t NetlinkManager::flush_own_routes()
+{
+    size_t removed = 0;
+
+    // Our nexthops first, the kernel removes the routes that use them with them
+    if (nexthop_objects_supported) {
+        OwnNexthopDump own_nexthops{route_protocol, {}, {}};
+        struct nhmsg header{};
+        header.nh_family = AF_UNSPEC;
+        dump_with_callback(RTM_GETNEXTHOP, &header, sizeof(header), nullptr, 0, 0, collect_own_nexthop, &own_nexthops);
+
+        // Groups before their members, deleting the last member would take the group with it
+        for (const auto& [id, members] : own_nexthops.groups) {
+            if (delete_nexthop_object(id)) removed++;
+        }
+        for (const auto& [id, nexthop] : own_nexthops.nexthops) {
+            if (delete_nexthop_object(id)) removed++;
+        }
+    }
+
+    // One dump filtered on our protocol and table, then the deletes go in one batch
+    OwnRouteDump dump = dump_own_routes();
+
+    bool with_nexthop_objects = use_nexthop_objects;
+    use_nexthop_objects = true; // Delete by destination only, whatever the gateway was
+    for (const std::string& destination : dump.destinations) {
+        queue_route_operation({ROUTE_DELETE, destination, ""});
+    }
+    removed += flush_route_operations();
+    use_nexthop_objects = with_nexthop_objects;
+
+    std::cout << "Removed " << removed << " route(s) and nexthop(s) of protocol " << (int)route_protocol
+              << " from table " << route_table << std::endl;
+    return removed;
+}
@@ -0,0 +1,179 @@
+#ifndef NETLINK_MANAGER_H
+#define NETLINK_MANAGER_H
+
+#include <string> // For std::string
+#include <vector> // For std::vector
+#include <map>    // For std::map
+#include <set>    // For std::set
+#include <cstdint>
+#include <functional> // For std::function
+
+struct nl_sock;
+struct nl_cache;
+struct nl_cache_mngr;
+struct rtnl_route;
+struct OwnRouteDump;
+
+// One IPv4 address of a local interface
+struct InterfacePrefix {
+    uint32_t address; // Host order
+    uint8_t prefix_len;
+    int ifindex;
+
+    uint32_t network() const
+    {
+        uint32_t mask = (prefix_len == 0) ? 0 : (0xFFFFFFFF << (32 - prefix_len));
+        return address & mask;
+    }
+};
+
+enum RouteOperationType {
+    ROUTE_ADD, // RTM_NEWROUTE with NLM_F_REPLACE
+    ROUTE_DELETE, // RTM_DELROUTE
+};
+
+struct RouteOperation {
+    RouteOperationType type;
+    std::string destination;
+    std::string next_hop;
+    int attempts = 0;
+    long long retry_at_ms = 0; // Not sent again before this time (monotonic)
+};
+
+// Called once per queued operation, error is 0 or a negative errno from the kernel
+typedef std::function<void(const RouteOperation& operation, int error)> RouteCompletion;
+
+// Kernel nexthop object (RTM_NEWNEXTHOP) shared by every route going through one neighbor
+struct NexthopObject {
+    uint32_t id;
+    int ifindex; // Egress interface it was created with, replaced when the prefix table moves it
+};
+
+// One next hop of a multipath route with the interface it goes through
+struct MultipathMember {
+    std::string address;
+    uint32_t gateway; // Host order
+    int ifindex;
+    int weight; // 1 to 256
+};
+
+// Byte counters of one interface (IFLA_STATS64)
+struct LinkCounters {
+    uint64_t rx_bytes;
+    uint64_t tx_bytes;
+};
+
+struct InterfaceInfo {
+    std::string name;
+    bool up; // IFF_UP, set by the administrator
+    bool running; // IFF_RUNNING, the link has a carrier
+};
+
+// Netlink sockets opened once at startup :
+//  - the cache manager keeps the links and addresses up to date from the kernel notifications
+//    (RTNLGRP_LINK and RTNLGRP_IPV4_IFADDR), its fd goes in the reactor
+//  - the request socket sends the route changes, one message per route
+class NetlinkManager {
+public:
+    ~NetlinkManager();
+
+    bool open();
+    void close();
+    int event_fd() const; // -1 if not open
+    bool process_events(); // To call when event_fd is readable, true if a link or an address changed
+
+    // Interface of the local subnet holding this gateway (longest prefix), 0 if none
+    int find_ifindex_for_gateway(uint32_t gateway) const;
+    const std::vector<InterfacePrefix>& get_prefixes() const { return prefixes; }
+    const std::map<int, InterfaceInfo>& get_interfaces() const { return interfaces; }
+    // The address is configured on an interface that is up with a carrier
+    bool address_usable(uint32_t address) const;
+    // Counters of every interface in one link dump (the cache doesn't get new counters), false on error
+    bool read_link_counters(std::map<int, LinkCounters>& counters) const;
+
+    // Both return a libnl error code (0 on success)
+    int add_route(const std::string& destination, const std::string& next_hop);
+    int delete_route(const std::string& destination, const std::string& next_hop);
+
+    size_t requests_sent = 0; // Route requests since start, to check that one install costs one request
+
+    // Asynchronous route programming : queued operations are packed in as few sendmsg as possible,
+    // the kernel ACKs are read later from batch_fd and matched to their operation by sequence number
+    void queue_route_operation(const RouteOperation& operation); // Replaces a queued one for the same destination
+    void set_route_completion(RouteCompletion completion) { route_completion = completion; }
+    size_t flush_route_operations(); // Sends the operations that are due, returns how many
+    int batch_fd() const; // -1 if not open
+    void process_route_acks(); // To call when batch_fd is readable
+    size_t pending_route_operations() const { return queued_operations.size() + in_flight_operations.size(); }
+
+    // Nexthop objects need Linux 5.3, without them each route carries its own gateway like before
+    void set_use_nexthop_objects(bool enabled) { use_nexthop_objects = enabled && nexthop_objects_supported; }
+    bool nexthop_objects_in_use() const { return use_nexthop_objects; }
+    // Deleting the neighbor nexthop removes every route through it in one kernel operation,
+    // done once no route operation is queued or waiting for its ACK
+    bool remove_nexthop(const std::string& next_hop);
+    const std::map<uint32_t, NexthopObject>& get_nexthops() const { return nexthops; }
+    // Multipath routes share one group nexthop per set of next hops, the groups no wanted route uses are deleted
+    void remove_unused_nexthop_groups(const std::set<std::string>& wanted_next_hops);
+    const std::map<std::string, uint32_t>& get_nexthop_groups() const { return nexthop_groups; }
+
+    // Our routes and nexthops are tagged with route_protocol and installed in route_table (set before flush_own_routes)
+    void set_route_protocol(uint8_t protocol) { route_protocol = protocol; }
+    void set_route_table(uint32_t table) { route_table = table; }
+    // Remove what a previous run left, without touching the routes of anybody else
+    size_t flush_own_routes();
+    // Or keep them (warm restart) : fills installed_routes (destination -> next hop) with what the kernel has
+    size_t read_own_routes(std::map<std::string, std::string>& installed_routes);
+
+    double last_batch_routes_per_second = 0; // Routes ACKed / time from the first send to the last ACK
+    size_t route_operations_failed = 0; // Given up after MAX_ROUTE_ATTEMPTS
+
+private:
+    static void on_cache_change(struct nl_cache* cache, struct nl_object* object, int action, void* data);
+    void rebuild_tables();
+    void complete_route_operation(const RouteOperation& operation, int error);
+    struct rtnl_route* build_route(const std::string& destination, const std::string& next_hop, int ifindex, int& err) const;
+    struct rtnl_route* build_multipath_route(const std::string& destination, const std::vector<MultipathMember>& members, int& err) const;
+    OwnRouteDump dump_own_routes() const;
+    bool probe_nexthop_objects();
+    int ensure_nexthop(uint32_t gateway, int ifindex); // Nexthop id, 0 if it could not be created
+    uint32_t ensure_nexthop_group(const std::string& next_hops, const std::vector<MultipathMember>& members); // 0 if it could not be created
+    bool delete_nexthop_object(uint32_t id);
+    void refresh_nexthops(); // Replace the nexthops whose egress interface changed
+    void delete_released_nexthops(); // The ones remove_nexthop released, when no route operation is pending
+
+    static const uint32_t NEXTHOP_ID_BASE = 0x4F530000; // Our ids start here to stay away from the ones of other daemons
+
+    static const int MAX_ROUTE_ATTEMPTS = 5;
+    static const size_t MAX_BATCH_BYTES = 32768; // One sendmsg, well under the netlink socket buffer
+
+    struct nl_sock* request_sock = nullptr;
+    struct nl_sock* batch_sock = nullptr; // Non blocking, only for the queued route operations
+    struct nl_cache_mngr* cache_manager = nullptr;
+    struct nl_cache* link_cache = nullptr; // Owned by cache_manager
+    struct nl_cache* address_cache = nullptr; // Owned by cache_manager
+
+    std::vector<InterfacePrefix> prefixes; // Sorted by prefix length, longest first
+    std::map<int, InterfaceInfo> interfaces; // Ifindex -> interface
+
+    std::map<std::string, RouteOperation> queued_operations; // Destination -> next operation to send
+    std::map<uint32_t, RouteOperation> in_flight_operations; // Sequence number -> operation waiting for its ACK
+    uint32_t next_sequence = 1;
+    RouteCompletion route_completion;
+
+    uint8_t route_protocol = 200; // Not used by iproute2 or the known routing daemons (see /etc/iproute2/rt_protos)
+    uint32_t route_table = 254; // RT_TABLE_MAIN
+
+    bool nexthop_objects_supported = false;
+    bool use_nexthop_objects = false;
+    std::map<uint32_t, NexthopObject> nexthops; // Gateway (host order) -> nexthop object
+    std::map<std::string, uint32_t> nexthop_groups; // Multipath next hops ("10.0.1.2,10.0.2.3") -> group nexthop id
+    std::vector<uint32_t> released_nexthops; // Ids to delete once the pending route operations are ACKed
+    uint32_t next_nexthop_id = NEXTHOP_ID_BASE;
+    bool nexthops_need_refresh = false;
+    bool tables_changed = false; // Set by rebuild_tables, returned by process_events
+    long long batch_start_ms = 0; // First send since in_flight_operations was empty
+    size_t batch_completed = 0;
+};
+
+#endif // NETLINK_MANAGER_H
@@ -0,0 +1,120 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include "reactor.h"
+
+int create_reactor() {
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        perror("epoll_create1");
+    }
+    return epoll_fd;
+}
+
+bool reactor_add_fd(int epoll_fd, int fd) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        perror("epoll_ctl");
+        return false;
+    }
+    return true;
+}
+
+bool reactor_remove_fd(int epoll_fd, int fd) {
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr) < 0) {
+        perror("epoll_ctl");
+        return false;
+    }
+    return true;
+}
+
+// Fill ready_fds with the fds that can be read, returns their number or -1 on error
+int reactor_wait(int epoll_fd, std::vector<int>& ready_fds, int max_events, int timeout_ms) {
+    std::vector<epoll_event> events(max_events);
+    ready_fds.clear();
+
+    int count = epoll_wait(epoll_fd, events.data(), max_events, timeout_ms);
+    if (count < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        perror("epoll_wait");
+        return -1;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        ready_fds.push_back(events[i].data.fd);
+    }
+    return count;
+}
+
+bool create_protocol_timer(ProtocolTimer& timer, int epoll_fd) {
+    timer.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer.fd < 0) {
+        perror("timerfd_create");
+        return false;
+    }
+    if (!reactor_add_fd(epoll_fd, timer.fd) || (timer.periodic && !arm_protocol_timer(timer))) {
+        close_protocol_timer(timer);
+        return false;
+    }
+    return true;
+}
+
+bool arm_protocol_timer(ProtocolTimer& timer) {
+    static std::mt19937 generator(std::random_device{}());
+
+    long long delay_ms = timer.interval_ms;
+    if (timer.jitter_percent > 0) {
+        std::uniform_int_distribution<long long> jitter(0, timer.interval_ms * timer.jitter_percent / 100);
+        delay_ms -= jitter(generator);
+    }
+    // One shot timer, the next delay is drawn again when it expires
+    return schedule_protocol_timer(timer, delay_ms);
+}
+
+bool schedule_protocol_timer(ProtocolTimer& timer, long long delay_ms) {
+    if (delay_ms < 1) {
+        delay_ms = 1; // A zero it_value would disarm the timer
+    }
+
+    itimerspec spec{};
+    spec.it_value.tv_sec = delay_ms / 1000;
+    spec.it_value.tv_nsec = (delay_ms % 1000) * 1000000;
+    if (timerfd_settime(timer.fd, 0, &spec, nullptr) < 0) {
+        perror("timerfd_settime");
+        return false;
+    }
+    return true;
+}
+
+bool acknowledge_protocol_timer(ProtocolTimer& timer) {
+    uint64_t expirations;
+    if (read(timer.fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        return false; // Already read, nothing to do
+    }
+    return !timer.periodic || arm_protocol_timer(timer);
+}
+
+void close_protocol_timer(ProtocolTimer& timer) {
+    if (timer.fd >= 0) {
+        close(timer.fd);
+        timer.fd = -1;
+    }
+}
+
+// Not affected by date changes, for intervals only (declaration timestamps stay on the system clock)
+long long monotonic_time_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
@@ -0,0 +1,33 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <string> // For std::string
+#include <vector> // For std::vector
+
+// One periodic task of the server, backed by its own timerfd
+// The timer is re-armed after every expiry with a random jitter so routers don't all send at the same time
+struct ProtocolTimer {
+    std::string name;
+    long long interval_ms;
+    int jitter_percent; // The next expiry is between interval * (1 - jitter) and interval
+    int fd = -1;
+    size_t runs = 0; // Number of times the handler ran
+    long long max_handler_ms = 0; // Longest handler run, to see if one of them is too slow
+    bool periodic = true; // False : only fires when armed with schedule_protocol_timer
+};
+
+// Small epoll wrapper, every fd added is watched for input
+int create_reactor();
+bool reactor_add_fd(int epoll_fd, int fd);
+bool reactor_remove_fd(int epoll_fd, int fd);
+int reactor_wait(int epoll_fd, std::vector<int>& ready_fds, int max_events, int timeout_ms);
+
+bool create_protocol_timer(ProtocolTimer& timer, int epoll_fd);
+bool arm_protocol_timer(ProtocolTimer& timer);
+bool schedule_protocol_timer(ProtocolTimer& timer, long long delay_ms); // One expiry after delay_ms
+bool acknowledge_protocol_timer(ProtocolTimer& timer); // Read the timerfd and re-arm it
+void close_protocol_timer(ProtocolTimer& timer);
+
+long long monotonic_time_ms();
+
+#endif // REACTOR_H
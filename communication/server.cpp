@@ -14,8 +14,23 @@
 #include <queue>
 #include <set>
 #include <climits>
+#include <chrono>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
 #include "../logic/logic.h"
+#include "../logic/lsdb_store.h"
+#include "../logic/fib.h"
+#include "../logic/lsdb_checkpoint.h"
+#include "../logic/neighbor_table.h"
+#include "../logic/spf_scheduler.h"
+#include "../logic/incremental_spf.h"
+#include "../logic/metric.h"
+#include "../logic/link_load.h"
 #include "msg.h"
+#include "reactor.h"
+#include "netlink_manager.h"
+#include "tc_query.h"
 #include <netlink/netlink.h>
 #include <netlink/socket.h>
 #include <netlink/route/route.h>
@@ -27,6 +42,11 @@ std::map<std::string, std::string> current_system_routes;
 std::map<std::string, std::string> forwardingTable;
 std::map<std::string, std::map<std::string, RouterDeclaration>> local_lsdb; 
 
+// Flooding mode, set from the config file (flood_mode and self_refresh_interval_ms)
+bool delta_flooding = true;
+long long self_refresh_interval_ms = 10000;
+long long declaration_max_age_ms = 30000; // Same threshold as update_lsdb
+
 std::string get_local_hostname() {
     char hostname[256]; // Taille typique suffisante pour les hostnames
     if (gethostname(hostname, sizeof(hostname)) != 0) {
@@ -36,82 +56,18 @@ std::string get_local_hostname() {
     return std::string(hostname);
 }
 
+// Opened in main, add_route and delete_route reuse its socket and interface tables
+NetlinkManager netlink;
+
 // Fonction pour supprimer une route
 void delete_route(const std::string& destination, const std::string& nextHop) {
     std::cout << "[DEBUG] Attempting to delete route: " << destination << " via " << nextHop << std::endl;
-    struct nl_sock *sock = nl_socket_alloc();
-    if (!sock) {
-        std::cerr << "Failed to allocate netlink socket" << std::endl;
-        return;
-    }
-    if (nl_connect(sock, NETLINK_ROUTE) < 0) {
-        std::cerr << "Failed to connect netlink socket" << std::endl;
-        nl_socket_free(sock);
-        return;
-    }
-
-    struct rtnl_route *route = rtnl_route_alloc();
-    if (!route) {
-        std::cerr << "Failed to allocate route" << std::endl;
-        nl_close(sock);
-        nl_socket_free(sock);
-        return;
-    }
-
-    struct nl_addr *dst_addr = nullptr, *gw_addr = nullptr;
-
-    if (nl_addr_parse(destination.c_str(), AF_INET, &dst_addr) < 0) {
-        std::cerr << "Invalid destination address: " << destination << std::endl;
-        rtnl_route_put(route);
-        nl_close(sock);
-        nl_socket_free(sock);
-        return;
-    }
-
-    if (nl_addr_parse(nextHop.c_str(), AF_INET, &gw_addr) < 0) {
-        std::cerr << "Invalid gateway address: " << nextHop << std::endl;
-        nl_addr_put(dst_addr);
-        rtnl_route_put(route);
-        nl_close(sock);
-        nl_socket_free(sock);
-        return;
-    }
-
-    rtnl_route_set_family(route, AF_INET);
-    rtnl_route_set_dst(route, dst_addr);
-
-    struct rtnl_nexthop *nh = rtnl_route_nh_alloc();
-    if (!nh) {
-        std::cerr << "Failed to allocate nexthop" << std::endl;
-        nl_addr_put(dst_addr);
-        nl_addr_put(gw_addr);
-        rtnl_route_put(route);
-        nl_close(sock);
-        nl_socket_free(sock);
-        return;
-    }
-
-    rtnl_route_nh_set_gateway(nh, gw_addr);
-    rtnl_route_add_nexthop(route, nh);
 
-    int err = rtnl_route_delete(sock, route, 0);
-    if (err < 0) {
-        if (err == -NLE_OBJ_NOTFOUND) {
-            std::cerr << "Route not found: " << destination << std::endl;
-        } else {
-            std::cerr << "Failed to delete route: " << nl_geterror(err) << std::endl;
-        }
-    } else {
-        std::cout << "Route deleted successfully" << std::endl;
+    int err = netlink.delete_route(destination, nextHop);
+    if (err == -NLE_OBJ_NOTFOUND) {
+        std::cerr << "Route not found: " << destination << std::endl;
     }
 
-    // Nettoyage
-    nl_addr_put(dst_addr);
-    nl_addr_put(gw_addr);
-    rtnl_route_put(route);
-    nl_close(sock);
-    nl_socket_free(sock);
-
     if (err < 0) {
         std::cerr << "[ERROR] Failed to delete route " << destination << " via " << nextHop << ": " << nl_geterror(err) << std::endl;
     } else {
@@ -143,59 +99,6 @@ int route_delete_callback(struct nl_msg *msg, void *arg) {
     return NL_OK;
 }
 
-void delete_indirect_routes() {
-    struct nl_sock *sock = nl_socket_alloc();
-    if (!sock) {
-        std::cerr << "Erreur allocation socket" << std::endl;
-        return;
-    }
-
-    if (nl_connect(sock, NETLINK_ROUTE) < 0) {
-        std::cerr << "Erreur connexion socket" << std::endl;
-        nl_socket_free(sock);
-        return;
-    }
-
-    struct rtnl_route *filter = rtnl_route_alloc();
-    rtnl_route_set_family(filter, AF_INET);
-
-    struct nl_cache *route_cache;
-    if (rtnl_route_alloc_cache(sock, AF_INET, 0, &route_cache) < 0) {
-        std::cerr << "Erreur chargement cache route" << std::endl;
-        rtnl_route_put(filter);
-        nl_close(sock);
-        nl_socket_free(sock);
-        return;
-    }
-
-    std::cout << "🔧 Suppression des routes avec une gateway (routes indirectes)..." << std::endl;
-
-    nl_cache_foreach(route_cache, [](struct nl_object *obj, void *arg) {
-        struct rtnl_route *route = (struct rtnl_route *)obj;
-
-        // Vérifier si la route a une gateway
-        struct rtnl_nexthop *nh = rtnl_route_nexthop_n(route, 0);
-        if (nh != nullptr && rtnl_route_nh_get_gateway(nh) != nullptr) {
-            // Supprimer la route car elle a une gateway
-            int err = rtnl_route_delete((struct nl_sock *)arg, route, 0);
-            if (err < 0) {
-                std::cerr << "Erreur suppression: " << nl_geterror(err) << std::endl;
-            } else {
-                std::cout << "Route supprimée." << std::endl;
-            }
-        } else {
-            std::cout << "Route conservée (voisin direct)." << std::endl;
-        }
-    }, sock);
-
-    nl_cache_free(route_cache);
-    rtnl_route_put(filter);
-    nl_close(sock);
-    nl_socket_free(sock);
-
-    std::cout << "Suppression terminée." << std::endl;
-}
-
 // Fonction pour ajouter une route avec suppression de toutes les routes existantes pour la même destination
 void add_route(const std::string& destination, const std::string& nextHop) {
     if (destination.empty()) {
@@ -207,169 +110,17 @@ void add_route(const std::string& destination, const std::string& nextHop) {
         return;
     }
 
-    struct nl_sock *sock = nl_socket_alloc();
-    if (!sock) {
-        std::cerr << "Failed to allocate netlink socket" << std::endl;
-        return;
-    }
-    if (nl_connect(sock, NETLINK_ROUTE) < 0) {
-        std::cerr << "Failed to connect netlink socket" << std::endl;
-        nl_socket_free(sock);
-        return;
-    }
-
-    struct nl_addr *dst_addr = nullptr, *gw_addr = nullptr;
-
-    // These calls are now protected by the checks above
-    if (nl_addr_parse(destination.c_str(), AF_INET, &dst_addr) < 0) {
-        std::cerr << "Invalid destination address: " << destination << std::endl;
-        nl_close(sock);
-        nl_socket_free(sock);
-        return;
-    }
-
-    if (nl_addr_parse(nextHop.c_str(), AF_INET, &gw_addr) < 0) {
-        std::cerr << "Invalid gateway address: " << nextHop << std::endl;
-        nl_addr_put(dst_addr); // Don't forget to free dst_addr if it was successfully parsed
-        nl_close(sock);
-        nl_socket_free(sock);
-        return;
-    }
-
-    // Supprimer les routes existantes pour cette destination (optionnel)
-    struct nl_cache *route_cache = nullptr;
-    if (rtnl_route_alloc_cache(sock, AF_INET, 0, &route_cache) < 0) {
-        std::cerr << "Failed to allocate route cache. Proceeding without deleting existing routes." << std::endl;
-        route_cache = nullptr;
-    }
-
-    if (route_cache) {
-        for (struct nl_object *obj = nl_cache_get_first(route_cache); obj != nullptr; obj = nl_cache_get_next(obj)) {
-            struct rtnl_route *existing_route = (struct rtnl_route *)obj;
-            struct nl_addr *existing_dst = rtnl_route_get_dst(existing_route);
-            if (existing_dst && nl_addr_cmp(existing_dst, dst_addr) == 0) {
-                int del_err = rtnl_route_delete(sock, existing_route, 0);
-                if (del_err < 0 && del_err != -NLE_OBJ_NOTFOUND) {
-                    std::cerr << "Failed to delete existing route: " << nl_geterror(del_err) << std::endl;
-                }
-            }
-        }
-    }
-
-    // Trouver l'interface sur le même réseau que la gateway
-    struct nl_cache *link_cache = nullptr;
-    if (rtnl_link_alloc_cache(sock, AF_UNSPEC, &link_cache) < 0) {
-        std::cerr << "Failed to allocate link cache" << std::endl;
-        if (route_cache) nl_cache_free(route_cache);
-        nl_addr_put(dst_addr);
-        nl_addr_put(gw_addr);
-        nl_close(sock);
-        nl_socket_free(sock);
-        return;
-    }
-
-    int ifindex = 0;
-    struct nl_object *link_obj = nullptr;
-    for (link_obj = nl_cache_get_first(link_cache); link_obj != nullptr; link_obj = nl_cache_get_next(link_obj)) {
-        struct rtnl_link *link = (struct rtnl_link *)link_obj;
-        int link_ifindex = rtnl_link_get_ifindex(link);
-
-        // Récupérer les adresses IPv4 associées à cette interface
-        struct nl_cache *addr_cache = nullptr;
-        if (rtnl_addr_alloc_cache(sock, &addr_cache) < 0) continue;
-
-        for (struct nl_object *addr_obj = nl_cache_get_first(addr_cache); addr_obj != nullptr; addr_obj = nl_cache_get_next(addr_obj)) {
-            struct rtnl_addr *addr = (struct rtnl_addr *)addr_obj;
-            if (rtnl_addr_get_ifindex(addr) != link_ifindex) continue;
-
-            struct nl_addr *local_addr = rtnl_addr_get_local(addr);
-            if (!local_addr || nl_addr_get_family(local_addr) != AF_INET) continue;
-
-            // Calculer le masque réseau pour cette adresse
-            int prefixlen = rtnl_addr_get_prefixlen(addr);
-
-            // Vérifier si la gateway est dans ce subnet
-            if (nl_addr_get_family(gw_addr) != AF_INET) continue;
-
-            // Appliquer le masque sur les adresses pour comparer le réseau
-            unsigned char gw_buf[4], local_buf[4];
-            memcpy(gw_buf, nl_addr_get_binary_addr(gw_addr), 4);
-            memcpy(local_buf, nl_addr_get_binary_addr(local_addr), 4);
-
-            uint32_t gw_ip = ntohl(*((uint32_t*)gw_buf));
-            uint32_t local_ip = ntohl(*((uint32_t*)local_buf));
-            uint32_t mask = prefixlen == 0 ? 0 : (~0u << (32 - prefixlen));
-
-            if ((gw_ip & mask) == (local_ip & mask)) {
-                ifindex = link_ifindex;
-                nl_cache_free(addr_cache);
-                goto found_interface; // on sort des boucles
-            }
-        }
-        nl_cache_free(addr_cache);
-    }
-
-found_interface:
-    if (ifindex == 0) {
-        std::cerr << "No interface found on the same network as gateway " << nextHop << std::endl;
-        nl_cache_free(link_cache);
-        if (route_cache) nl_cache_free(route_cache);
-        nl_addr_put(dst_addr);
-        nl_addr_put(gw_addr);
-        nl_close(sock);
-        nl_socket_free(sock);
-        return;
-    }
-    nl_cache_free(link_cache);
-
-    // Créer la route et ajouter nexthop avec ifindex et gateway
-    struct rtnl_route *route = rtnl_route_alloc();
-    if (!route) {
-        std::cerr << "Failed to allocate route" << std::endl;
-        nl_addr_put(dst_addr);
-        nl_addr_put(gw_addr);
-        if (route_cache) nl_cache_free(route_cache);
-        nl_close(sock);
-        nl_socket_free(sock);
-        return;
-    }
-    rtnl_route_set_family(route, AF_INET);
-    rtnl_route_set_dst(route, dst_addr);
-
-    struct rtnl_nexthop *nh = rtnl_route_nh_alloc();
-    if (!nh) {
-        std::cerr << "Failed to allocate nexthop" << std::endl;
-        nl_addr_put(dst_addr);
-        nl_addr_put(gw_addr);
-        rtnl_route_put(route);
-        if (route_cache) nl_cache_free(route_cache);
-        nl_close(sock);
-        nl_socket_free(sock);
-        return;
-    }
-    rtnl_route_nh_set_gateway(nh, gw_addr);
-    rtnl_route_nh_set_ifindex(nh, ifindex);
-    rtnl_route_add_nexthop(route, nh);
-
-    int err = rtnl_route_add(sock, route, 0);
+    // One request : the egress interface comes from the cached prefixes and NLM_F_REPLACE
+    // takes the place of the previous route to this destination
+    int err = netlink.add_route(destination, nextHop);
     if (err < 0) {
         std::cerr << "Failed to add route: " << nl_geterror(err) << std::endl;
     } else {
         std::cout << "Route added successfully" << std::endl;
         current_system_routes[destination] = nextHop;
     }
-
-    // Nettoyage
-    nl_addr_put(dst_addr);
-    nl_addr_put(gw_addr);
-    rtnl_route_put(route);
-    if (route_cache) nl_cache_free(route_cache);
-    nl_close(sock);
-    nl_socket_free(sock);
 }
 
-
-
 void update_route(const std::string& destination, const std::string& nextHop) {
     delete_route(destination, nextHop); 
     add_route(destination, nextHop);
@@ -427,29 +178,83 @@ void updateRoutingTable(const std::string& message, std::map<std::string, std::m
     }
 }
 
-void cleanup_stale_system_routes(const std::vector<std::pair<std::string, std::string>>& new_computed_routes) {
-    std::cout << "[DEBUG] Starting cleanup_stale_system_routes." << std::endl;
-    std::set<std::pair<std::string, std::string>> new_routes_set;
-    std::cout << "[DEBUG] current_system_routes size: " << current_system_routes.size() << std::endl;
-    for (const auto& entry : current_system_routes) {
-        std::cout << "[DEBUG] Current installed route: " << entry.first << " via " << entry.second << std::endl;
+// Kernel answer for a queued route, only failures need something (retries are already done)
+void on_route_programmed(const RouteOperation& operation, int error) {
+    if (error == 0) {
+        return;
     }
+    // Forget the route so the next reconcile tries again
+    auto it = current_system_routes.find(operation.destination);
+    if (operation.type == ROUTE_ADD && it != current_system_routes.end() && it->second == operation.next_hop) {
+        current_system_routes.erase(it);
+    }
+}
 
-    auto it = current_system_routes.begin();
-    while (it != current_system_routes.end()) {
-        const std::string& destination = it->first;
-        const std::string& nextHop = it->second;
+// Route requests sent to the kernel since the last reconcile, stays 0 when the topology doesn't move
+size_t route_operations = 0;
 
-        if (new_routes_set.find({destination, nextHop}) == new_routes_set.end()) {
-            std::cout << "[INFO] Detected stale route for deletion: Dest=" << destination << ", NH=" << nextHop << std::endl;
-            delete_route(destination, nextHop);
-            it = current_system_routes.erase(it);
-        } else {
-            // std::cout << "[DEBUG] Route is still valid: Dest=" << destination << ", NH=" << nextHop << std::endl;
-            ++it;
+// Next hops the kernel still needs for these routes : a multipath next hop as a whole (its nexthop group)
+// and each of its neighbors
+std::set<std::string> get_wanted_next_hops(const std::vector<std::pair<std::string, std::string>>& routes)
+{
+    std::set<std::string> wanted_next_hops;
+    for (const auto& route : routes) {
+        wanted_next_hops.insert(route.first);
+        for (const NextHop& next_hop : parse_next_hops(route.first)) {
+            wanted_next_hops.insert(next_hop.address);
         }
     }
-    std::cout << "[DEBUG] Finished cleanup_stale_system_routes." << std::endl;
+    return wanted_next_hops;
+}
+
+// Only send what differs between the routes we installed and the ones just computed
+void reconcile_fib(const std::vector<std::pair<std::string, std::string>>& new_computed_routes) {
+    FibDelta delta = compute_fib_delta(current_system_routes, routes_to_table(new_computed_routes));
+
+    // Queued for the netlink batch, current_system_routes already holds the wanted state
+    // and on_route_programmed fixes it if the kernel refuses an operation
+    // A neighbor that no route uses anymore is removed with its nexthop object, the kernel drops every route
+    // through it at once. The netlink manager deletes it after the replacements below are ACKed
+    std::set<std::string> wanted_next_hops = get_wanted_next_hops(new_computed_routes);
+    std::set<std::string> removed_next_hops;
+    for (const auto& [destination, nextHops] : delta.deleted) {
+        for (const NextHop& next_hop : parse_next_hops(nextHops)) {
+            const std::string& nextHop = next_hop.address;
+            if (wanted_next_hops.count(nextHop) == 0 && removed_next_hops.count(nextHop) == 0 && netlink.remove_nexthop(nextHop)) {
+                std::cout << "[INFO] Releasing nexthop " << nextHop << " and all its routes" << std::endl;
+                removed_next_hops.insert(nextHop);
+                route_operations++;
+            }
+        }
+    }
+
+    for (const auto& [destination, nextHop] : delta.deleted) {
+        std::cout << "[INFO] Detected stale route for deletion: Dest=" << destination << ", NH=" << nextHop << std::endl;
+        if (removed_next_hops.count(nextHop) == 0) {
+            netlink.queue_route_operation({ROUTE_DELETE, destination, nextHop});
+            route_operations++;
+        }
+        current_system_routes.erase(destination);
+    }
+
+    // Replace in place (NLM_F_REPLACE) so a new next hop never leaves a hole
+    for (const auto& [destination, nextHop] : delta.added) {
+        netlink.queue_route_operation({ROUTE_ADD, destination, nextHop});
+        current_system_routes[destination] = nextHop;
+        route_operations++;
+    }
+    for (const auto& [destination, nextHop] : delta.replaced) {
+        netlink.queue_route_operation({ROUTE_ADD, destination, nextHop});
+        current_system_routes[destination] = nextHop;
+        route_operations++;
+    }
+    netlink.flush_route_operations();
+    netlink.remove_unused_nexthop_groups(wanted_next_hops); // Their routes were just replaced
+
+    if (delta.size() > 0) {
+        std::cout << "[INFO] FIB changes: " << delta.added.size() << " added, " << delta.replaced.size()
+                  << " replaced, " << delta.deleted.size() << " deleted" << std::endl;
+    }
 }
 
 void computeShortestPaths(const std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb, const std::string& LOCAL_ROUTER_ID) {
@@ -526,68 +331,816 @@ void apply_route_to_system(const std::string& destination, const std::string& ne
 }
 
 
-// Traitement des messages reçus
-void on_receive(int sock, std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb, const std::string& LOCAL_ROUTER_ID) {
-    char buffer[1024]; // Normaly this should be less than 1024 bytes, but we add some extra space for safety
-    sockaddr_in sender_addr{};
-    socklen_t sender_len = sizeof(sender_addr);
+// Receive buffers reused between wakeups, one slot per datagram of a recvmmsg batch
+struct ReceiveBatch {
+    static const size_t DATAGRAM_SIZE = 2048; // Flooded datagrams are at most one MTU (WIRE_MAX_DATAGRAM_SIZE)
+    std::vector<char> buffers;
+    std::vector<sockaddr_in> senders;
+    std::vector<iovec> iovecs;
+    std::vector<mmsghdr> messages;
+    std::vector<char> controls; // Ancillary data, the SO_RXQ_OVFL drop counter comes here
+};
 
-    ssize_t len = recvfrom(sock, buffer, sizeof(buffer) - 1, 0,
-                           (sockaddr*)&sender_addr, &sender_len);
-    if (len < 0) {
-        perror("recvfrom");
+size_t receive_batch_size = 64;
+ReceiveBatch receive_batch;
+
+// Datagrams dropped by the kernel because our receive queue was full (SO_RXQ_OVFL, total since start)
+uint32_t kernel_dropped_datagrams = 0;
+
+uint32_t get_kernel_dropped_datagrams() {
+    return kernel_dropped_datagrams;
+}
+
+// Datagrams bigger than a receive slot, dropped instead of parsed cut short (total since start)
+size_t truncated_datagrams = 0;
+
+static const size_t RECEIVE_CONTROL_SIZE = CMSG_SPACE(sizeof(uint32_t));
+
+void setup_receive_batch(size_t batch_size) {
+    receive_batch_size = std::max<size_t>(1, batch_size);
+    receive_batch.buffers.assign(receive_batch_size * ReceiveBatch::DATAGRAM_SIZE, 0);
+    receive_batch.senders.assign(receive_batch_size, sockaddr_in{});
+    receive_batch.iovecs.assign(receive_batch_size, iovec{});
+    receive_batch.messages.assign(receive_batch_size, mmsghdr{});
+    receive_batch.controls.assign(receive_batch_size * RECEIVE_CONTROL_SIZE, 0);
+}
+
+// Bigger kernel queue and drop counter on the listening socket, failures are only logged
+void configure_receive_socket(int sock, int receive_buffer_size) {
+    if (receive_buffer_size > 0) {
+        if (setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &receive_buffer_size, sizeof(receive_buffer_size)) < 0) {
+            perror("setsockopt SO_RCVBUF");
+        }
+        int actual_size = 0;
+        socklen_t option_len = sizeof(actual_size);
+        if (getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &actual_size, &option_len) == 0) {
+            // The kernel doubles the asked value and caps it with net.core.rmem_max
+            std::cout << "Receive buffer size: " << actual_size << " bytes" << std::endl;
+        }
+    }
+
+    int enable = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable)) < 0) {
+        perror("setsockopt SO_RXQ_OVFL");
+    }
+}
+
+// Read every datagram already queued (up to receive_batch_size) with one system call
+// Returns the number of datagrams read, or -1 on error
+int receive_datagrams_batched(int sock) {
+    if (receive_batch.messages.size() != receive_batch_size) {
+        setup_receive_batch(receive_batch_size);
+    }
+
+    for (size_t i = 0; i < receive_batch_size; ++i) {
+        iovec& io = receive_batch.iovecs[i];
+        io.iov_base = &receive_batch.buffers[i * ReceiveBatch::DATAGRAM_SIZE];
+        io.iov_len = ReceiveBatch::DATAGRAM_SIZE;
+
+        msghdr& header = receive_batch.messages[i].msg_hdr;
+        header = msghdr{};
+        header.msg_name = &receive_batch.senders[i];
+        header.msg_namelen = sizeof(sockaddr_in);
+        header.msg_iov = &io;
+        header.msg_iovlen = 1;
+        header.msg_control = &receive_batch.controls[i * RECEIVE_CONTROL_SIZE];
+        header.msg_controllen = RECEIVE_CONTROL_SIZE;
+        receive_batch.messages[i].msg_len = 0;
+    }
+
+    // epoll reported the socket readable, don't wait for the batch to be full
+    // MSG_TRUNC gives the real length of a datagram that did not fit, so it can be recognized
+    int count = recvmmsg(sock, receive_batch.messages.data(), receive_batch_size, MSG_DONTWAIT | MSG_TRUNC, nullptr);
+    if (count < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            perror("recvmmsg");
+            return -1;
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        msghdr& header = receive_batch.messages[i].msg_hdr;
+        if ((header.msg_flags & MSG_TRUNC) || receive_batch.messages[i].msg_len > ReceiveBatch::DATAGRAM_SIZE) {
+            // Only the start of it is in the buffer, the last record would be read cut short
+            truncated_datagrams++;
+            std::cerr << "Dropped a datagram of " << receive_batch.messages[i].msg_len << " bytes from "
+                      << inet_ntoa(receive_batch.senders[i].sin_addr) << ", bigger than " << ReceiveBatch::DATAGRAM_SIZE
+                      << " (total " << truncated_datagrams << ")\n";
+            receive_batch.messages[i].msg_len = 0;
+        }
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&header); cmsg != nullptr; cmsg = CMSG_NXTHDR(&header, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+                uint32_t dropped;
+                memcpy(&dropped, CMSG_DATA(cmsg), sizeof(dropped));
+                if (dropped != kernel_dropped_datagrams) {
+                    std::cerr << "Kernel dropped " << (dropped - kernel_dropped_datagrams)
+                              << " datagram(s), receive queue full (total " << dropped << ")\n";
+                    kernel_dropped_datagrams = dropped;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+// Traitement des messages reçus
+void on_receive(int sock, LinkStateStore& local_lsdb, const std::vector<std::string>& interfaces) {
+    int datagram_count = receive_datagrams_batched(sock);
+    if (datagram_count <= 0) {
         return;
     }
-    buffer[len] = '\0';
 
-    try
+    // A datagram can hold several declarations, in text or binary (see detect_wire_format)
+    std::vector<RouterDeclaration> received_declarations;
+    size_t received_bytes = 0;
+    for (int i = 0; i < datagram_count; ++i)
+    {
+        const uint8_t* buffer = (const uint8_t*)receive_batch.iovecs[i].iov_base;
+        size_t len = receive_batch.messages[i].msg_len;
+        received_bytes += len;
+
+        size_t invalid = decode_router_declarations(buffer, len, received_declarations);
+        if (invalid > 0)
+        {
+            std::cerr << "Failed to decode " << invalid << " router declaration(s) from " << inet_ntoa(receive_batch.senders[i].sin_addr) << "\n";
+        }
+    }
+
+    // The whole batch goes in the lsdb before anything else looks at it
+    size_t updated = 0;
+    for (const RouterDeclaration& received_declaration : received_declarations)
     {
-        // Deserialize received message
-        RouterDeclaration received_declaration = deserialize_router_definition(buffer);
         // Calling add_router_declaration to update the local_lsdb
-        add_router_declaration(local_lsdb, received_declaration);
+        if (local_lsdb.add_router_declaration(received_declaration))
+        {
+            updated++;
+        }
     }
-    catch (const std::exception& e)
+
+    // Only the declarations that were newer than ours are sent again, the others stop here
+    if (delta_flooding)
     {
-        std::cerr << "Failed to deserialize router declaration: " << e.what() << "\n";
-        return; // Ignore invalid messages
+        flood_changed_declarations(local_lsdb, interfaces);
     }
 
-    std::cout << "[UDP] Received from " << inet_ntoa(sender_addr.sin_addr) << ": " << buffer << "\n";
+    std::cout << "[UDP] Received " << datagram_count << " datagram(s): "
+              << received_declarations.size() << " declaration(s) in " << received_bytes << " bytes, "
+              << updated << " new or newer\n";
+}
 
-    //updateRoutingTable(buffer, local_lsdb);
 
-    //computeShortestPaths(local_lsdb, LOCAL_ROUTER_ID);
 
-    //updateForwardingTable();
+// Periodic tasks, each one runs from its own timer (see the ProtocolTimer list in main)
+void on_self_refresh(LinkStateStore& local_lsdb, const std::string& LOCAL_ROUTER_ID)
+{
+    // Give a new timestamp to this router own declarations so the others don't age them out
+    long long new_timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+    local_lsdb.refresh_router(LOCAL_ROUTER_ID, new_timestamp);
+}
 
-    for (const auto& [destination, nextHop] : forwardingTable) {
-        apply_route_to_system(destination, nextHop);
+void on_lsdb_aging(LinkStateStore& local_lsdb)
+{
+    if (local_lsdb.cleanup_old_declarations(declaration_max_age_ms))
+    {
+        std::cout << "Old declarations cleaned up." << std::endl;
     }
+}
+
+void on_flood(LinkStateStore& local_lsdb, const std::vector<std::string>& interfaces)
+{
+    if (delta_flooding)
+    {
+        flood_changed_declarations(local_lsdb, interfaces);
+    }
+    else
+    {
+        send_all_router_declarations_to_all(local_lsdb, interfaces);
+    }
+
+    // Everything flooded since the last tick, received declarations included
+    const FloodCounters& counters = get_flood_counters();
+    std::cout << "Flood tick: " << counters.packets << " packets, " << counters.bytes << " bytes, "
+              << counters.declarations << " declarations (" << (delta_flooding ? "delta" : "full") << " mode), "
+              << get_kernel_dropped_datagrams() << " datagrams dropped by the kernel and " << truncated_datagrams
+              << " truncated since start" << std::endl;
+    reset_flood_counters();
+}
+
+// Routes of the last SPF run, installed again by on_fib_reconcile
+std::vector<std::pair<std::string, std::string>> computed_routes;
 
+// Warm restart state, see graceful_restart in config
+bool graceful_restart = false;
+std::string checkpoint_file = "lsdb.checkpoint";
+long long restart_grace_until_ms = 0; // Monotonic time, 0 once the first refresh round is over
+uint64_t checkpoint_sequence = 0;
+size_t checkpoint_link_count = 0;
+
+// Until the grace period is over the routes of the previous run stay as they are (logged once in main)
+bool in_restart_grace(LinkStateStore& local_lsdb)
+{
+    if (restart_grace_until_ms == 0) {
+        return false;
+    }
+    if (monotonic_time_ms() < restart_grace_until_ms) {
+        return true;
+    }
+    restart_grace_until_ms = 0;
+    size_t removed = local_lsdb.sweep_stale_links();
+    std::cout << "Graceful restart over, " << removed << " stale declaration(s) removed" << std::endl;
+    return false;
+}
+
+void on_checkpoint(const LinkStateStore& local_lsdb)
+{
+    // Aging removes links without a new sequence, so the count is checked too
+    if (local_lsdb.get_change_sequence() == checkpoint_sequence && local_lsdb.link_count() == checkpoint_link_count) {
+        return;
+    }
+    if (save_lsdb_checkpoint(local_lsdb, checkpoint_file)) {
+        checkpoint_sequence = local_lsdb.get_change_sequence();
+        checkpoint_link_count = local_lsdb.link_count();
+    }
+}
+
+void on_fib_reconcile(LinkStateStore& local_lsdb)
+{
+    if (in_restart_grace(local_lsdb)) {
+        return; // computed_routes is still empty, reconciling would remove every kept route
+    }
+    reconcile_fib(computed_routes);
+
+    std::cout << "Route operations this tick: " << route_operations << std::endl;
+    route_operations = 0;
+}
+
+// Tree kept between the SPF runs and repaired from the lsdb topology log, see incremental_spf in config
+bool use_incremental_spf = true;
+IncrementalSpf incremental_spf;
+
+// Equal cost multipath, see ecmp_max_paths and ecmp_weights in config
+size_t ecmp_max_paths = 4;
+bool ecmp_capacity_weights = false;
+
+// Qdiscs of every interface, dumped again at most once a second
+TcQuery tc_query;
+
+// Speed in Mbit/s of the interface on the subnet of this address : its tbf rate when it is shaped,
+// else the nominal speed from its driver, 0 if neither is known
+long long interface_speed_mbps(uint32_t address)
+{
+    int ifindex = netlink.find_ifindex_for_gateway(address);
+    auto it = netlink.get_interfaces().find(ifindex);
+    if (it == netlink.get_interfaces().end()) {
+        return 0;
+    }
+    std::ifstream speed_file("/sys/class/net/" + it->second.name + "/speed");
+    long long speed = 0;
+    if (!(speed_file >> speed) || speed < 0) {
+        speed = 0; // Virtual interfaces have no speed (EINVAL or -1)
+    }
+    uint64_t shaped_bps = tc_query.rate_bps(ifindex);
+    if (shaped_bps > 0) {
+        long long shaped = std::max<long long>(1, shaped_bps / 1000000);
+        speed = (speed == 0) ? shaped : std::min(speed, shaped);
+    }
+    return speed;
+}
+
+// Capacity of the link toward this gateway : what the neighbor advertises for its address on our subnet,
+// bounded by the speed of our own interface. Either one alone when the other is unknown
+long long gateway_capacity_mbps(const LinkStateStore& local_lsdb, const std::string& gateway)
+{
+    struct in_addr address;
+    if (inet_pton(AF_INET, gateway.c_str(), &address) != 1) {
+        return 0;
+    }
+    long long advertised = 0;
+    for (const PackedLink& link : local_lsdb.get_links()) {
+        if (link.address == ntohl(address.s_addr)) {
+            advertised = link.capacity_mbps;
+            break;
+        }
+    }
+    long long local = interface_speed_mbps(ntohl(address.s_addr));
+    if (advertised == 0 || local == 0) {
+        return std::max(advertised, local);
+    }
+    return std::min(advertised, local);
+}
+
+// Multipath next hops weighted by the capacity of their link, the slowest one gets 1.
+// Equal weights are kept when one of the capacities is unknown. speeds caches them for one SPF run
+std::string weight_next_hops(const LinkStateStore& local_lsdb, const std::string& next_hops, std::map<std::string, long long>& speeds)
+{
+    std::vector<NextHop> parsed = parse_next_hops(next_hops);
+    if (parsed.size() < 2) {
+        return next_hops;
+    }
+    long long slowest = LLONG_MAX;
+    for (const NextHop& next_hop : parsed) {
+        auto it = speeds.find(next_hop.address);
+        if (it == speeds.end()) {
+            it = speeds.emplace(next_hop.address, gateway_capacity_mbps(local_lsdb, next_hop.address)).first;
+        }
+        if (it->second <= 0) {
+            return next_hops;
+        }
+        slowest = std::min(slowest, it->second);
+    }
+    for (NextHop& next_hop : parsed) {
+        next_hop.weight = (int)std::min((long long)MAX_NEXT_HOP_WEIGHT, std::max(1LL, speeds[next_hop.address] / slowest));
+    }
+    return format_next_hops(parsed);
+}
+
+// What the SPF minimizes, see metric in config. Only the cost metric uses the incremental SPF
+MetricConfig metric_config;
+int local_link_cost = 10; // Cost we advertise on our interfaces
+long long default_capacity_mbps = 0; // Advertised when the interface has no speed, 0 = unknown
+
+// Live load of our interfaces (ip/mask -> load), its band is added to the advertised cost.
+// See bandwidth_sample_ms in config, nothing is sampled when it is 0
+long long bandwidth_sample_ms = 0;
+LoadCostConfig load_cost_config;
+std::map<std::string, LinkLoad> link_loads;
+std::map<std::string, uint32_t> advertised_capacities; // Ip/mask -> capacity in our last declaration
+bool advertise_link_capacity = false; // Only then a new capacity is worth a declaration, see advertise_capacity in config
+
+// Capacity of the interface with this ip/mask, from its driver or default_capacity_mbps
+uint32_t local_capacity_mbps(const std::string& iface)
+{
+    uint32_t address;
+    uint8_t prefix_len;
+    long long capacity = 0;
+    if (parse_ip_with_mask(iface, address, prefix_len)) {
+        capacity = interface_speed_mbps(address);
+    }
+    if (capacity <= 0) {
+        capacity = default_capacity_mbps;
+    }
+    return (uint32_t)std::min(capacity, (long long)UINT32_MAX);
+}
+
+// Our declaration of one interface, with the capacity read from its driver and the cost of its load
+RouterDeclaration create_local_declaration(const std::string& LOCAL_ROUTER_ID, const std::string& iface)
+{
+    int cost = local_link_cost;
+    auto load = link_loads.find(iface);
+    if (load != link_loads.end()) {
+        cost += load->second.extra_cost();
+    }
+    RouterDeclaration declaration = create_router_definition(LOCAL_ROUTER_ID, iface, cost);
+    declaration.capacity_mbps = local_capacity_mbps(iface);
+    advertised_capacities[iface] = declaration.capacity_mbps;
+    return declaration;
+}
+
+// Partial run : only the prefixes it touched change, in computed_routes and in the kernel
+void apply_partial_routes(const std::vector<PrefixRoute>& prefix_routes)
+{
+    // computed_routes first, which next hops are still used is only known once every prefix is in
+    for (const PrefixRoute& route : prefix_routes) {
+        auto computed = std::find_if(computed_routes.begin(), computed_routes.end(),
+                                     [&route](const auto& entry) { return entry.second == route.destination; });
+        if (computed != computed_routes.end() && route.next_hop.empty()) {
+            computed_routes.erase(computed);
+        }
+        else if (computed != computed_routes.end()) {
+            computed->first = route.next_hop;
+        }
+        else if (!route.next_hop.empty()) {
+            computed_routes.push_back({route.next_hop, route.destination});
+        }
+    }
+    std::set<std::string> wanted_next_hops = get_wanted_next_hops(computed_routes);
+
+    std::set<std::string> previous_neighbors; // Of the routes moved or removed, their nexthop may not be used anymore
+    for (const PrefixRoute& route : prefix_routes) {
+        auto installed = current_system_routes.find(route.destination);
+        if (installed != current_system_routes.end() && installed->second != route.next_hop) {
+            for (const NextHop& next_hop : parse_next_hops(installed->second)) {
+                previous_neighbors.insert(next_hop.address);
+            }
+        }
+
+        if (route.next_hop.empty() && installed != current_system_routes.end()) {
+            netlink.queue_route_operation({ROUTE_DELETE, route.destination, installed->second});
+            current_system_routes.erase(installed);
+            route_operations++;
+        }
+        else if (!route.next_hop.empty() && (installed == current_system_routes.end() || installed->second != route.next_hop)) {
+            netlink.queue_route_operation({ROUTE_ADD, route.destination, route.next_hop});
+            current_system_routes[route.destination] = route.next_hop;
+            route_operations++;
+        }
+    }
+    netlink.flush_route_operations();
+
+    // Like reconcile_fib, the nexthops only go once the routes using them were replaced or removed
+    for (const std::string& neighbor : previous_neighbors) {
+        if (wanted_next_hops.count(neighbor) == 0 && netlink.remove_nexthop(neighbor)) {
+            std::cout << "[INFO] Releasing nexthop " << neighbor << ", no route uses it anymore" << std::endl;
+        }
+    }
+    netlink.remove_unused_nexthop_groups(wanted_next_hops);
+}
+
+void on_spf(LinkStateStore& local_lsdb, const std::string& LOCAL_ROUTER_ID)
+{
+    if (in_restart_grace(local_lsdb)) {
+        return;
+    }
+    std::map<std::string, long long> speeds;
+    if (metric_config.mode != METRIC_COST) {
+        computed_routes = compute_all_routes(LOCAL_ROUTER_ID, local_lsdb, ecmp_max_paths, metric_config);
+    }
+    else if (use_incremental_spf) {
+        bool repaired = incremental_spf.update(local_lsdb, LOCAL_ROUTER_ID);
+        if (incremental_spf.last_partial) {
+            std::cout << "SPF partial: " << incremental_spf.last_changes << " change(s) on stub subnets, tree unchanged" << std::endl;
+            std::vector<PrefixRoute> prefix_routes = incremental_spf.partial_routes(ecmp_max_paths);
+            for (PrefixRoute& route : prefix_routes) {
+                if (ecmp_capacity_weights) {
+                    route.next_hop = weight_next_hops(local_lsdb, route.next_hop, speeds);
+                }
+            }
+            apply_partial_routes(prefix_routes);
+            std::cout << "Routes computed." << std::endl;
+            return;
+        }
+        computed_routes = incremental_spf.routes(ecmp_max_paths);
+        std::cout << "SPF " << (repaired ? "repaired" : "computed again") << ": " << incremental_spf.last_changes
+                  << " topology change(s), " << incremental_spf.last_affected_nodes << " node(s) moved" << std::endl;
+    }
+    else {
+        computed_routes = compute_all_routes(LOCAL_ROUTER_ID, local_lsdb, ecmp_max_paths);
+    }
+    if (ecmp_capacity_weights) {
+        for (auto& route : computed_routes) {
+            route.first = weight_next_hops(local_lsdb, route.first, speeds);
+        }
+    }
+    on_fib_reconcile(local_lsdb);
+
+    std::cout << "Routes computed." << std::endl;
     debug_known_router(local_lsdb);
 }
 
+// Configured interfaces that can be used right now (up, with a carrier and their address), kept
+// up to date from the netlink link and address notifications
+std::vector<std::string> active_interfaces; // Ip only, for the flooding
+std::vector<std::string> active_interfaces_with_mask; // For the hellos
+std::set<std::string> down_interfaces; // Ip/mask of the configured interfaces whose declaration is withdrawn
 
+// Hello subsystem, a neighbor is declared down after dead_multiplier hellos missed
+// instead of waiting for its declarations to age out (declaration_max_age_ms)
+NeighborTable neighbor_table;
+uint32_t hello_interval_ms = 250; // 0 turns the hellos off
+uint32_t dead_multiplier = 4;
 
-// Corrected on_update function:
-void on_update(std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb, const std::string& LOCAL_ROUTER_ID, std::vector<std::string>& interfaces)
+// Hellos come on their own port so the declaration socket is not slowed down by them
+int create_hello_socket()
 {
-    update_lsdb(local_lsdb, LOCAL_ROUTER_ID);
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        perror("socket hello");
+        return -1;
+    }
 
-    send_all_router_declarations_to_all(local_lsdb, interfaces);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(WIRE_HELLO_PORT);
+    addr.sin_addr.s_addr = INADDR_ANY;
+    if (bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("bind hello");
+        close(sock);
+        return -1;
+    }
 
-    std::vector<std::pair<std::string, std::string>> computed_routes = compute_all_routes(LOCAL_ROUTER_ID, local_lsdb);
+    join_multicast_all_interfaces(sock, "239.0.0.1");
+    return sock;
+}
 
-    cleanup_stale_system_routes(computed_routes);
+// Our interface on the subnet of this address, empty if we don't share one
+std::string find_interface_on_subnet(const std::vector<std::string>& interfaces_with_mask, uint32_t address)
+{
+    for (const std::string& iface : interfaces_with_mask) {
+        uint32_t local_address;
+        uint8_t prefix_len;
+        if (!parse_ip_with_mask(iface, local_address, prefix_len)) {
+            continue;
+        }
+        uint32_t mask = (prefix_len == 0) ? 0 : (0xFFFFFFFF << (32 - prefix_len));
+        if ((local_address & mask) == (address & mask) && local_address != address) {
+            return iface.substr(0, iface.find('/'));
+        }
+    }
+    return "";
+}
 
-    for(const auto& route : computed_routes)
+void on_hello_receive(int hello_sock, const std::vector<std::string>& interfaces_with_mask, const std::string& LOCAL_ROUTER_ID)
+{
+    uint8_t buffer[WIRE_HELLO_HEADER_SIZE + WIRE_HELLO_MAX_NAME];
+    while (true) {
+        ssize_t len = recv(hello_sock, buffer, sizeof(buffer), MSG_DONTWAIT | MSG_TRUNC);
+        if (len < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("recv hello");
+            }
+            return;
+        }
+        if ((size_t)len > sizeof(buffer)) {
+            continue; // Longer than any hello, MSG_TRUNC gave its real length
+        }
+
+        WireHello hello;
+        if (!decode_wire_hello(buffer, len, hello) || hello.router_name == LOCAL_ROUTER_ID) {
+            continue; // Our own hellos come back through the multicast loop
+        }
+        std::string interface_ip = find_interface_on_subnet(interfaces_with_mask, hello.address);
+        if (interface_ip.empty()) {
+            continue;
+        }
+
+        if (neighbor_table.on_hello(hello, interface_ip, monotonic_time_ms())) {
+            std::cout << "[HELLO] Neighbor " << hello.router_name << " (" << uint_to_ip(hello.address)
+                      << ") up on " << interface_ip << ", dead interval " << hello.dead_interval_ms << " ms" << std::endl;
+        }
+    }
+}
+
+// Links of the neighbors that stopped talking leave the lsdb, the SPF scheduler sees the change.
+// Only with flood_withdrawals=on the withdrawals are flooded at once, else the other routers still
+// wait for the link to age out
+void on_neighbor_dead_check(LinkStateStore& local_lsdb)
+{
+    std::vector<Neighbor> went_down = neighbor_table.expire(monotonic_time_ms());
+    if (went_down.empty()) {
+        return;
+    }
+
+    for (const Neighbor& neighbor : went_down) {
+        bool withdrawn = local_lsdb.withdraw_link(neighbor.router_name, neighbor.address, neighbor.prefix_len);
+        std::cout << "[HELLO] Neighbor " << neighbor.router_name << " (" << uint_to_ip(neighbor.address) << ") down on "
+                  << neighbor.interface_ip << ", detected in " << neighbor_table.get_stats().last_detection_ms << " ms"
+                  << (withdrawn ? ", link withdrawn" : "") << std::endl;
+    }
+    on_flood(local_lsdb, active_interfaces);
+}
+
+// Membership is tied to the interface index, an interface created again needs it again
+void join_multicast_on_interface(int sock, const std::string& multicast_ip, const std::string& interface_ip)
+{
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr.s_addr = inet_addr(multicast_ip.c_str());
+    mreq.imr_interface.s_addr = inet_addr(interface_ip.c_str());
+    if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0 && errno != EADDRINUSE) {
+        std::cerr << "Failed to join multicast on " << interface_ip << ": " << strerror(errno) << "\n";
+    }
+}
+
+// Withdraw the declaration of an interface that went down and declare it again when it comes back,
+// returns true if one of our declarations changed
+bool update_local_interfaces(LinkStateStore& local_lsdb, const std::string& LOCAL_ROUTER_ID,
+                             const std::vector<std::string>& interfaces_with_mask, const std::vector<int>& multicast_sockets)
+{
+    bool changed = false;
+    active_interfaces.clear();
+    active_interfaces_with_mask.clear();
+    for (const std::string& iface : interfaces_with_mask) {
+        uint32_t address;
+        uint8_t prefix_len;
+        if (!parse_ip_with_mask(iface, address, prefix_len)) {
+            continue;
+        }
+        std::string iface_ip = iface.substr(0, iface.find('/'));
+        bool usable = netlink.address_usable(address);
+        bool withdrawn = down_interfaces.count(iface) > 0;
+
+        if (!usable && !withdrawn) {
+            // The withdrawal is newer than our last declaration so it replaces it everywhere it is flooded to
+            // (flood_withdrawals=on), else the other routers keep the link until it ages out
+            local_lsdb.add_router_declaration(create_router_definition(LOCAL_ROUTER_ID, iface, LINK_COST_WITHDRAWN));
+            down_interfaces.insert(iface);
+            changed = true;
+            std::cout << "[LINK] Interface " << iface << " down, its declaration is withdrawn"
+                      << (get_flood_withdrawals() ? " and flooded" : ", not flooded: flood_withdrawals=off") << std::endl;
+        } else if (usable && withdrawn) {
+            local_lsdb.add_router_declaration(create_local_declaration(LOCAL_ROUTER_ID, iface));
+            down_interfaces.erase(iface);
+            for (int sock : multicast_sockets) {
+                join_multicast_on_interface(sock, "239.0.0.1", iface_ip);
+            }
+            changed = true;
+            std::cout << "[LINK] Interface " << iface << " up, declared again" << std::endl;
+        }
+
+        if (usable) {
+            active_interfaces.push_back(iface_ip);
+            active_interfaces_with_mask.push_back(iface);
+        }
+    }
+    return changed;
+}
+
+// A local link or address changed : declarations are flooded now, not at the next tick,
+// and the SPF scheduler sees the change
+void on_local_link_event(LinkStateStore& local_lsdb, const std::string& LOCAL_ROUTER_ID,
+                         const std::vector<std::string>& interfaces_with_mask, const std::vector<int>& multicast_sockets)
+{
+    if (!update_local_interfaces(local_lsdb, LOCAL_ROUTER_ID, interfaces_with_mask, multicast_sockets)) {
+        return;
+    }
+    on_flood(local_lsdb, active_interfaces);
+}
+
+// Sample the byte counters of our interfaces, a declaration is only sent again
+// when the load of its interface moves to another band or its advertised capacity changed (new tbf rate)
+void on_bandwidth_sample(LinkStateStore& local_lsdb, const std::string& LOCAL_ROUTER_ID)
+{
+    std::map<int, LinkCounters> counters;
+    if (!netlink.read_link_counters(counters)) {
+        return;
+    }
+    long long now_ms = monotonic_time_ms();
+    bool changed = false;
+    for (const std::string& iface : active_interfaces_with_mask) {
+        uint32_t address;
+        uint8_t prefix_len;
+        if (!parse_ip_with_mask(iface, address, prefix_len)) {
+            continue;
+        }
+        auto it = counters.find(netlink.find_ifindex_for_gateway(address));
+        if (it == counters.end()) {
+            continue;
+        }
+        LinkLoad& load = link_loads.emplace(iface, LinkLoad(load_cost_config)).first->second;
+        uint32_t capacity = local_capacity_mbps(iface);
+        bool new_band = load.sample(it->second.rx_bytes, it->second.tx_bytes, now_ms, capacity);
+        if (new_band || (advertise_link_capacity && advertised_capacities[iface] != capacity)) {
+            local_lsdb.add_router_declaration(create_local_declaration(LOCAL_ROUTER_ID, iface));
+            changed = true;
+            std::cout << "[LOAD] " << iface << " at " << (int)(load.utilization() * 100) << "% of " << capacity
+                      << " Mbit/s, cost " << local_link_cost + load.extra_cost() << std::endl;
+        }
+    }
+    if (changed) {
+        on_flood(local_lsdb, active_interfaces);
+    }
+}
+
+// SPF only runs after a change of the topology, see SpfScheduler for the delays
+SpfScheduler spf_scheduler;
+uint64_t spf_topology_sequence = 0; // Topology sequence of the lsdb when SPF was last asked
+
+void note_topology_change(const LinkStateStore& local_lsdb, const std::string& reason, ProtocolTimer& spf_timer)
+{
+    if (local_lsdb.get_topology_sequence() == spf_topology_sequence) {
+        return; // Refreshes and old copies don't change the routes
+    }
+    spf_topology_sequence = local_lsdb.get_topology_sequence();
+
+    long long delay_ms = spf_scheduler.trigger(reason, monotonic_time_ms());
+    if (delay_ms >= 0) {
+        schedule_protocol_timer(spf_timer, delay_ms);
+        std::cout << "[SPF] Triggered by " << reason << ", run in " << delay_ms << " ms" << std::endl;
+    }
+}
+
+void on_spf_timer(LinkStateStore& local_lsdb, const std::string& LOCAL_ROUTER_ID, ProtocolTimer& spf_timer)
+{
+    if (restart_grace_until_ms != 0 && monotonic_time_ms() < restart_grace_until_ms) {
+        // The routes of the previous run stay until the grace period is over, run right after it
+        schedule_protocol_timer(spf_timer, restart_grace_until_ms - monotonic_time_ms());
+        return;
+    }
+
+    long long start_ms = monotonic_time_ms();
+    on_spf(local_lsdb, LOCAL_ROUTER_ID);
+    long long duration_ms = monotonic_time_ms() - start_ms;
+    spf_scheduler.ran(monotonic_time_ms(), duration_ms);
+    spf_topology_sequence = local_lsdb.get_topology_sequence(); // The stale links swept by on_spf are already in
+
+    const SpfStats& stats = spf_scheduler.get_stats();
+    std::cout << "[SPF] Run " << stats.runs << " (" << stats.last_reason << ", " << stats.triggers << " triggers so far) in "
+              << duration_ms << " ms, next hold " << spf_scheduler.current_hold() << " ms" << std::endl;
+}
+
+volatile sig_atomic_t stop_requested = 0;
+
+void on_stop_signal(int)
+{
+    stop_requested = 1;
+}
+
+void on_cli_command(const std::string& command_line, const LinkStateStore& local_lsdb, const std::string& LOCAL_ROUTER_ID, const std::vector<ProtocolTimer*>& timers)
+{
+    if(command_line == "list")
     {
-        add_route(route.second, route.first); 
+        std::cout << "====" << std::endl;
+        std::string res = display_neighbor_routers(LOCAL_ROUTER_ID, local_lsdb);
+        std::cout << res << std::endl;
     }
+    else if(command_line == "timers")
+    {
+        for (const ProtocolTimer* timer : timers)
+        {
+            if (!timer->periodic)
+            {
+                std::cout << timer->name << ": on demand, " << timer->runs << " runs, slowest " << timer->max_handler_ms << " ms" << std::endl;
+                continue;
+            }
+            std::cout << timer->name << ": every " << timer->interval_ms << " ms (jitter " << timer->jitter_percent
+                      << "%), " << timer->runs << " runs, slowest " << timer->max_handler_ms << " ms" << std::endl;
+        }
+    }
+    else if(command_line == "spf")
+    {
+        const SpfStats& stats = spf_scheduler.get_stats();
+        std::cout << stats.runs << " SPF runs for " << stats.triggers << " topology changes, last one for " << stats.last_reason
+                  << " in " << stats.last_duration_ms << " ms";
+        if (stats.runs > 0)
+        {
+            std::cout << " (average " << stats.total_duration_ms / (long long)stats.runs << " ms, max " << stats.max_duration_ms << " ms)";
+        }
+        std::cout << ", hold " << spf_scheduler.current_hold() << " ms" << (spf_scheduler.is_pending() ? ", run pending" : "") << std::endl;
+        std::cout << "Metric " << metric_mode_name(metric_config.mode) << std::endl;
+        if (use_incremental_spf && metric_config.mode == METRIC_COST)
+        {
+            std::cout << incremental_spf.incremental_runs << " incremental runs (" << incremental_spf.partial_runs
+                      << " partial), " << incremental_spf.full_runs << " full runs" << std::endl;
+        }
+    }
+    else if(command_line == "load")
+    {
+        if (link_loads.empty())
+        {
+            std::cout << "No load sampled (bandwidth_sample_ms=0 or no sample yet)" << std::endl;
+        }
+        for (const auto& [iface, load] : link_loads)
+        {
+            std::cout << iface << ": " << (int)(load.utilization() * 100) << "% (band " << load.band() << "), cost "
+                      << local_link_cost + load.extra_cost() << ", " << load.band_changes << " changes, "
+                      << load.held_changes << " held" << std::endl;
+        }
+    }
+    else if(command_line == "neighbors")
+    {
+        long long now_ms = monotonic_time_ms();
+        for (const auto& [key, neighbor] : neighbor_table.get_neighbors())
+        {
+            std::cout << neighbor.router_name << " " << uint_to_ip(neighbor.address) << " on " << neighbor.interface_ip << ": "
+                      << (neighbor.state == NEIGHBOR_UP ? "up" : "down") << ", last hello " << (now_ms - neighbor.last_hello_ms)
+                      << " ms ago, dead interval " << neighbor.dead_interval_ms << " ms" << std::endl;
+        }
+        const LivenessStats& stats = neighbor_table.get_stats();
+        std::cout << neighbor_table.up_count() << " neighbors up, " << stats.downs_detected << " failures detected";
+        if (stats.downs_detected > 0)
+        {
+            std::cout << " (detection latency last " << stats.last_detection_ms << " ms, average "
+                      << stats.total_detection_ms / (long long)stats.downs_detected << " ms, max " << stats.max_detection_ms << " ms)";
+        }
+        std::cout << std::endl;
+    }
+}
 
-    std::cout << "Periodic update task executed." << std::endl;
-    debug_known_router(local_lsdb);
+// Cli lines are read with read() and not std::cin : a line left in the std::cin buffer would never wake epoll
+std::string cli_pending; // Start of a line whose end has not been read yet
+
+// Runs every complete line, returns false once stdin is closed (end of file or error)
+bool on_cli_input(const LinkStateStore& local_lsdb, const std::string& LOCAL_ROUTER_ID, const std::vector<ProtocolTimer*>& timers)
+{
+    char buffer[4096];
+    ssize_t len = read(STDIN_FILENO, buffer, sizeof(buffer));
+    if (len < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return true;
+    }
+    if (len > 0) {
+        cli_pending.append(buffer, len);
+    }
+
+    size_t end;
+    while ((end = cli_pending.find('\n')) != std::string::npos) {
+        std::string command_line = cli_pending.substr(0, end);
+        cli_pending.erase(0, end + 1);
+        on_cli_command(command_line, local_lsdb, LOCAL_ROUTER_ID, timers);
+    }
+    if (len > 0) {
+        return true;
+    }
+
+    if (len < 0) {
+        perror("read stdin");
+    }
+    if (!cli_pending.empty()) {
+        on_cli_command(cli_pending, local_lsdb, LOCAL_ROUTER_ID, timers); // Last line without its newline
+        cli_pending.clear();
+    }
+    return false;
 }
 
 void read_config_file(const std::string& filename, std::vector<std::string>& interfaces) {
@@ -602,7 +1155,7 @@ void read_config_file(const std::string& filename, std::vector<std::string>& int
     // Assume that user will provide a file with one interface per line
     std::string line;
     while (std::getline(config_file, line)) {
-        if (!line.empty() && line[0] != '#') {
+        if (!line.empty() && line[0] != '#' && line.find('=') == std::string::npos) {
             // Test if the line is a valid ip with mask
             if(assert_ip_and_mask(line)) {
                 // Take only the ip before the slash
@@ -647,7 +1200,7 @@ void read_config_file_mask(const std::string& filename, std::vector<std::string>
     // Assume that user will provide a file with one interface per line
     std::string line;
     while (std::getline(config_file, line)) {
-        if (!line.empty() && line[0] != '#') {
+        if (!line.empty() && line[0] != '#' && line.find('=') == std::string::npos) {
             // Test if the line is a valid ip with mask
             if(assert_ip_and_mask(line)) {
                     interfaces.push_back(line);
@@ -664,27 +1217,66 @@ void read_config_file_mask(const std::string& filename, std::vector<std::string>
     }    
 }
 
-void create_server_declaration(const std::vector<std::string>& interfaces, std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb, const std::string& LOCAL_ROUTER_ID) {
+// Options are the "name=value" lines of the configuration file (interfaces are the other lines)
+void read_config_options(const std::string& filename, std::map<std::string, std::string>& options) {
+    std::ifstream config_file(filename);
+    if (!config_file.is_open())
+    {
+        throw std::runtime_error("Could not open configuration file:");
+    }
+
+    std::string line;
+    while (std::getline(config_file, line)) {
+        size_t equal_pos = line.find('=');
+        if (line.empty() || line[0] == '#' || equal_pos == std::string::npos) {
+            continue;
+        }
+        options[line.substr(0, equal_pos)] = line.substr(equal_pos + 1);
+    }
+}
+
+std::string get_option(const std::map<std::string, std::string>& options, const std::string& name, const std::string& default_value) {
+    auto it = options.find(name);
+    if (it == options.end()) {
+        return default_value;
+    }
+    return it->second;
+}
+
+long long get_option_int(const std::map<std::string, std::string>& options, const std::string& name, long long default_value) {
+    auto it = options.find(name);
+    if (it == options.end()) {
+        return default_value;
+    }
+    try {
+        return std::stoll(it->second);
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid value for option " << name << ": " << it->second << "\n";
+        return default_value;
+    }
+}
+
+void create_server_declaration(const std::vector<std::string>& interfaces, LinkStateStore& local_lsdb, const std::string& LOCAL_ROUTER_ID) {
     for(const auto& iface : interfaces)
     {
-        RouterDeclaration router_declaration = create_router_definition(LOCAL_ROUTER_ID, iface , 10);
-        add_router_declaration(local_lsdb, router_declaration);
+        RouterDeclaration router_declaration = create_local_declaration(LOCAL_ROUTER_ID, iface);
+        local_lsdb.add_router_declaration(router_declaration);
     }    
 }
 
 int main() {
 
     // Running variables
-    std::map<std::string, std::map<std::string, RouterDeclaration>> local_lsdb;
+    LinkStateStore local_lsdb;
     std::vector<std::string> interfaces;
     std::string LOCAL_ROUTER_ID = get_local_hostname();
     std::vector<std::string> interfaces_with_mask;
 
-    // Initial cleanup of indirect routes from previous runs or other sources
-    std::cout << "Performing initial cleanup of indirect routes..." << std::endl;
-    delete_indirect_routes(); 
-    current_system_routes.clear(); 
-
+    // Netlink socket and interface caches for the whole run
+    if (!netlink.open()) {
+        return 1;
+    }
+    netlink.set_route_completion(on_route_programmed);
 
     // Read configuration file to get interfaces and debug output
     try {
@@ -705,6 +1297,102 @@ int main() {
 
 
 
+    std::map<std::string, std::string> options;
+    try {
+        read_config_options("config", options);
+    } catch (const std::exception& ex) {
+        std::cerr << "Error reading configuration file: " << ex.what() << std::endl;
+        return 1;
+    }
+
+    // Our routes are tagged with this protocol so only they are found and removed
+    netlink.set_route_protocol(std::min(255LL, std::max(1LL, get_option_int(options, "route_protocol", 200))));
+    netlink.set_route_table(std::max(1LL, get_option_int(options, "route_table", 254)));
+
+    // Binary declarations are only sent once all the routers are able to read them
+    if (get_option(options, "wire_format", "text") == "binary") {
+        set_wire_format(WIRE_FORMAT_BINARY);
+        std::cout << "Sending declarations with the binary format" << std::endl;
+    }
+    // Same for the batched datagrams, the default keeps one declaration per datagram
+    set_flood_datagram_size(std::max(0LL, get_option_int(options, "flood_datagram_size", 0)));
+    // And for the withdrawals, an older router would take one for a link with a negative cost
+    set_flood_withdrawals(get_option(options, "flood_withdrawals", "off") == "on");
+    // And for the capacities, an older router would stop reading at the first declaration that has one
+    advertise_link_capacity = (get_option(options, "advertise_capacity", "off") == "on");
+    set_advertise_capacity(advertise_link_capacity);
+
+    // Routes share one kernel nexthop per neighbor when the kernel has them
+    netlink.set_use_nexthop_objects(get_option(options, "nexthop_objects", "on") != "off");
+
+    // Full mode sends the whole lsdb every tick like before, delta only what changed
+    delta_flooding = (get_option(options, "flood_mode", "delta") != "full");
+    self_refresh_interval_ms = get_option_int(options, "self_refresh_interval_ms", self_refresh_interval_ms);
+    if (self_refresh_interval_ms <= 0 || self_refresh_interval_ms >= declaration_max_age_ms) {
+        std::cerr << "self_refresh_interval_ms must be between 0 and 30000 (declaration max age), using 10000\n";
+        self_refresh_interval_ms = 10000;
+    }
+
+    // Every periodic task has its own timer so a busy socket can't delay the others
+    int jitter_percent = std::min(50LL, std::max(0LL, get_option_int(options, "timer_jitter_percent", 10)));
+    ProtocolTimer flood_timer{"flood", std::max(1LL, get_option_int(options, "flood_interval_ms", 5000)), jitter_percent};
+    ProtocolTimer refresh_timer{"self_refresh", self_refresh_interval_ms, jitter_percent};
+    ProtocolTimer aging_timer{"lsdb_aging", std::max(1LL, get_option_int(options, "aging_interval_ms", 1000)), 0};
+    ProtocolTimer spf_timer{"spf", 0, 0};
+    spf_timer.periodic = false; // Armed by note_topology_change
+    spf_scheduler = SpfScheduler(get_option_int(options, "spf_initial_delay_ms", 50), get_option_int(options, "spf_hold_ms", 200),
+                                 get_option_int(options, "spf_max_wait_ms", 5000));
+    use_incremental_spf = (get_option(options, "incremental_spf", "on") != "off");
+    ecmp_max_paths = std::min(64LL, std::max(1LL, get_option_int(options, "ecmp_max_paths", ecmp_max_paths)));
+    ecmp_capacity_weights = (get_option(options, "ecmp_weights", "off") == "capacity");
+    if (!parse_metric_mode(get_option(options, "metric", "cost"), metric_config.mode)) {
+        std::cerr << "Unknown metric " << get_option(options, "metric", "cost") << ", using cost\n";
+    }
+    metric_config.hop_weight = std::min(65535LL, std::max(0LL, get_option_int(options, "metric_hop_weight", metric_config.hop_weight)));
+    metric_config.capacity_weight = std::min(65535LL, std::max(0LL, get_option_int(options, "metric_capacity_weight", metric_config.capacity_weight)));
+    metric_config.reference_mbps = std::min((long long)UINT32_MAX, std::max(1LL, get_option_int(options, "metric_reference_mbps", metric_config.reference_mbps)));
+    local_link_cost = std::min(65535LL, std::max(1LL, get_option_int(options, "link_cost", local_link_cost)));
+    default_capacity_mbps = std::min((long long)UINT32_MAX, std::max(0LL, get_option_int(options, "default_capacity_mbps", default_capacity_mbps)));
+    bandwidth_sample_ms = std::max(0LL, get_option_int(options, "bandwidth_sample_ms", bandwidth_sample_ms));
+    load_cost_config.ewma_percent = get_option_int(options, "bandwidth_ewma_percent", load_cost_config.ewma_percent);
+    load_cost_config.bands = std::min(100LL, std::max(1LL, get_option_int(options, "bandwidth_bands", load_cost_config.bands)));
+    load_cost_config.hysteresis_percent = std::min(50LL, std::max(0LL, get_option_int(options, "bandwidth_hysteresis_percent", load_cost_config.hysteresis_percent)));
+    load_cost_config.band_cost = std::min(65535LL, std::max(0LL, get_option_int(options, "bandwidth_band_cost", load_cost_config.band_cost)));
+    load_cost_config.hold_ms = std::max(0LL, get_option_int(options, "bandwidth_hold_ms", load_cost_config.hold_ms));
+    ProtocolTimer bandwidth_timer{"bandwidth_sample", std::max(1LL, bandwidth_sample_ms), 0};
+    ProtocolTimer fib_timer{"fib_reconcile", std::max(1LL, get_option_int(options, "fib_interval_ms", 30000)), jitter_percent};
+    ProtocolTimer route_retry_timer{"route_retry", 500, 0}; // Failed route operations waiting for their backoff
+    if (!delta_flooding) {
+        refresh_timer.interval_ms = flood_timer.interval_ms; // Full mode refreshes before every flood like before
+    }
+
+    // Neighbor liveness, the dead check runs 4 times per hello so a failure is seen soon after the dead interval
+    hello_interval_ms = std::max(0LL, get_option_int(options, "hello_interval_ms", hello_interval_ms));
+    dead_multiplier = std::max(2LL, get_option_int(options, "dead_multiplier", dead_multiplier));
+    ProtocolTimer hello_timer{"hello", std::max(1U, hello_interval_ms), jitter_percent};
+    ProtocolTimer dead_check_timer{"neighbor_dead_check", std::max(1U, hello_interval_ms / 4), 0};
+
+    graceful_restart = (get_option(options, "graceful_restart", "off") == "on");
+    checkpoint_file = get_option(options, "checkpoint_file", checkpoint_file);
+    ProtocolTimer checkpoint_timer{"checkpoint", std::max(1LL, get_option_int(options, "checkpoint_interval_ms", 1000)), 0};
+    current_system_routes.clear(); 
+    if (graceful_restart) {
+        // Start from the last known lsdb and leave the routes of the previous run in place,
+        // the stale entries are only dropped once every router had the time to refresh its own
+        int loaded = load_lsdb_checkpoint(local_lsdb, checkpoint_file);
+        local_lsdb.mark_all_stale();
+        set_last_flooded_sequence(local_lsdb.get_change_sequence()); // The others already have them
+        netlink.read_own_routes(current_system_routes);
+        restart_grace_until_ms = monotonic_time_ms() + refresh_timer.interval_ms + flood_timer.interval_ms;
+        std::cout << "Graceful restart: " << std::max(0, loaded) << " declarations from " << checkpoint_file << ", "
+                  << current_system_routes.size() << " routes kept in the kernel until the first refresh round is over ("
+                  << restart_grace_until_ms - monotonic_time_ms() << " ms)" << std::endl;
+    } else {
+        // Initial cleanup of the routes left by a previous run, the ones of other sources are kept
+        std::cout << "Performing initial cleanup of our routes..." << std::endl;
+        netlink.flush_own_routes();
+    }
+
     // Create default lsdb with is own declaration
     create_server_declaration(interfaces_with_mask, local_lsdb, LOCAL_ROUTER_ID);
     debug_known_router(local_lsdb); // Fror debug purpose Note: Remove in production
@@ -726,51 +1414,174 @@ int main() {
         return 1;
     }
 
+    // 0 keeps the kernel default (net.core.rmem_default), the kernel doubles the value so it has to stay under INT_MAX / 2
+    configure_receive_socket(sock, std::min((long long)INT_MAX / 2, std::max(0LL, get_option_int(options, "receive_buffer_size", 0))));
+    setup_receive_batch(std::min(1024LL, std::max(1LL, get_option_int(options, "receive_batch_size", 64))));
+
     std::string multicast_ip = "239.0.0.1";
     join_multicast_all_interfaces(sock, multicast_ip);
 
     std::cout << "Server listening on UDP port 8080...\n";
 
-    fd_set read_fds;
-    struct timeval timeout;
+    int epoll_fd = create_reactor();
+    if (epoll_fd < 0 || !reactor_add_fd(epoll_fd, sock) ||
+        !reactor_add_fd(epoll_fd, netlink.event_fd()) || !reactor_add_fd(epoll_fd, netlink.batch_fd())) {
+        close(sock);
+        return 1;
+    }
 
-    while (true) {
-        FD_ZERO(&read_fds);
-        FD_SET(sock, &read_fds);
-        FD_SET(STDIN_FILENO, &read_fds); // to add cli listening
+    int hello_sock = -1;
+    if (hello_interval_ms > 0) {
+        hello_sock = create_hello_socket();
+        if (hello_sock < 0 || !reactor_add_fd(epoll_fd, hello_sock)) {
+            close(sock);
+            return 1;
+        }
+        std::cout << "Hellos every " << hello_interval_ms << " ms, dead interval " << hello_interval_ms * dead_multiplier << " ms" << std::endl;
+        if (!get_flood_withdrawals()) {
+            std::cout << "Dead neighbors are only withdrawn here, the other routers wait for their links to age out"
+                      << " (flood_withdrawals=off)" << std::endl;
+        }
+    }
 
-        // Timeout de 5 secondes pour appeler onUpdate périodiquement
-        timeout.tv_sec = 5;
-        timeout.tv_usec = 0;
+    // Interfaces already down at startup are withdrawn before the first flood
+    std::vector<int> multicast_sockets = {sock};
+    if (hello_sock >= 0) {
+        multicast_sockets.push_back(hello_sock);
+    }
+    update_local_interfaces(local_lsdb, LOCAL_ROUTER_ID, interfaces_with_mask, multicast_sockets);
+
+    // Stdin can be a file or /dev/null when started as a service, epoll refuses those and there is no cli then
+    int cli_fd = STDIN_FILENO;
+    if (!reactor_add_fd(epoll_fd, cli_fd)) {
+        std::cout << "No cli on this stdin" << std::endl;
+        cli_fd = -1;
+    }
 
-        int ret = select(sock + 1, &read_fds, nullptr, nullptr, &timeout);
+    std::vector<ProtocolTimer*> timers = {&refresh_timer, &flood_timer, &aging_timer, &spf_timer, &fib_timer, &route_retry_timer};
+    if (graceful_restart) {
+        timers.push_back(&checkpoint_timer);
+    }
+    if (bandwidth_sample_ms > 0) {
+        timers.push_back(&bandwidth_timer);
+    }
+    if (hello_sock >= 0) {
+        timers.push_back(&hello_timer);
+        timers.push_back(&dead_check_timer);
+    }
+    for (ProtocolTimer* timer : timers) {
+        if (!create_protocol_timer(*timer, epoll_fd)) {
+            std::cerr << "Could not create the " << timer->name << " timer\n";
+            close(sock);
+            return 1;
+        }
+    }
+    note_topology_change(local_lsdb, "startup", spf_timer); // First routes, after the grace period on a warm restart
+
+    // SIGINT / SIGTERM stop the loop so the exit below can keep or remove our routes
+    struct sigaction stop_action{};
+    stop_action.sa_handler = on_stop_signal;
+    sigaction(SIGINT, &stop_action, nullptr);
+    sigaction(SIGTERM, &stop_action, nullptr);
+
+    std::vector<int> ready_fds;
+    while (!stop_requested) {
+        // Each handler does a bounded amount of work (one receive batch, one flood...)
+        // so the timers ready in the same wakeup are always served
+        int ret = reactor_wait(epoll_fd, ready_fds, 16, -1);
         if (ret < 0) {
-            perror("select");
             break;
-        } else if (ret == 0) {
-            // Timeout expiré, on fait la mise à jour périodique
-            on_update(local_lsdb, LOCAL_ROUTER_ID, interfaces);
-        } else {
-            if (FD_ISSET(sock, &read_fds))
+        }
+
+        for (int fd : ready_fds) {
+            if (fd == sock)
+            {
+                on_receive(sock, local_lsdb, active_interfaces);
+                note_topology_change(local_lsdb, "received declarations", spf_timer);
+                continue;
+            }
+            if (fd == hello_sock)
             {
-                on_receive(sock, local_lsdb, LOCAL_ROUTER_ID);
+                on_hello_receive(hello_sock, interfaces_with_mask, LOCAL_ROUTER_ID);
+                continue;
             }
-            if(FD_ISSET(STDIN_FILENO, &read_fds))
+            if (fd == netlink.event_fd())
             {
-                std::string command_line;
-                if (std::getline(std::cin, command_line))
+                if (netlink.process_events()) { // Link and address changes
+                    on_local_link_event(local_lsdb, LOCAL_ROUTER_ID, interfaces_with_mask, multicast_sockets);
+                    note_topology_change(local_lsdb, "local link change", spf_timer);
+                }
+                continue;
+            }
+            if (fd == netlink.batch_fd())
+            {
+                netlink.process_route_acks();
+                continue;
+            }
+            if (fd == cli_fd)
+            {
+                // Level triggered : a closed stdin stays readable, so it leaves the reactor or the loop would spin
+                if (!on_cli_input(local_lsdb, LOCAL_ROUTER_ID, timers))
                 {
-                    if(command_line == "list")
-                    {
-                        std::cout << "====" << std::endl;
-                        std::string res = display_neighbor_routers(LOCAL_ROUTER_ID, local_lsdb);
-                        std::cout << res << std::endl;
-                    }
-                }   
+                    reactor_remove_fd(epoll_fd, cli_fd);
+                    cli_fd = -1;
+                    std::cout << "Stdin closed, no more cli commands" << std::endl;
+                }
+                continue;
+            }
+
+            for (ProtocolTimer* timer : timers) {
+                if (fd != timer->fd || !acknowledge_protocol_timer(*timer)) {
+                    continue;
+                }
+
+                long long handler_start = monotonic_time_ms();
+                if (timer == &refresh_timer) {
+                    on_self_refresh(local_lsdb, LOCAL_ROUTER_ID);
+                } else if (timer == &flood_timer) {
+                    on_flood(local_lsdb, active_interfaces);
+                } else if (timer == &aging_timer) {
+                    on_lsdb_aging(local_lsdb);
+                } else if (timer == &spf_timer) {
+                    on_spf_timer(local_lsdb, LOCAL_ROUTER_ID, spf_timer);
+                } else if (timer == &fib_timer) {
+                    on_fib_reconcile(local_lsdb);
+                } else if (timer == &checkpoint_timer) {
+                    on_checkpoint(local_lsdb);
+                } else if (timer == &hello_timer) {
+                    send_hello_to_all(LOCAL_ROUTER_ID, active_interfaces_with_mask, hello_interval_ms, hello_interval_ms * dead_multiplier);
+                } else if (timer == &dead_check_timer) {
+                    on_neighbor_dead_check(local_lsdb);
+                } else if (timer == &bandwidth_timer) {
+                    on_bandwidth_sample(local_lsdb, LOCAL_ROUTER_ID);
+                } else if (timer == &route_retry_timer) {
+                    netlink.flush_route_operations();
+                }
+
+                timer->runs++;
+                timer->max_handler_ms = std::max(timer->max_handler_ms, monotonic_time_ms() - handler_start);
+                note_topology_change(local_lsdb, timer->name, spf_timer); // Aging, dead neighbors...
             }
         }
     }
 
+    if (graceful_restart) {
+        // The routes stay in the kernel, the next start takes them back with the checkpoint
+        save_lsdb_checkpoint(local_lsdb, checkpoint_file);
+        std::cout << "Leaving " << current_system_routes.size() << " routes installed for the restart" << std::endl;
+    } else {
+        netlink.flush_own_routes();
+    }
+
+    for (ProtocolTimer* timer : timers) {
+        close_protocol_timer(*timer);
+    }
+    close(epoll_fd);
+    netlink.close();
+    close_interface_sockets();
+    if (hello_sock >= 0) {
+        close(hello_sock);
+    }
     close(sock);
     return 0;
 }
@@ -0,0 +1,267 @@
+#include <iostream>
+#include <string>
+#include <map>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <net/if.h>
+#include <linux/rtnetlink.h>
+#include <linux/pkt_sched.h>
+#include <netlink/netlink.h>
+#include <netlink/socket.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+#include <netlink/utils.h>
+#include <netlink/route/tc.h>
+#include <netlink/route/qdisc.h>
+#include <netlink/route/qdisc/tbf.h>
+#include <netlink/route/qdisc/netem.h>
+#include "tc_query.h"
+
+static long long steady_time_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+TcQuery::TcQuery(long long max_age_ms)
+    : max_age_ms(max_age_ms)
+{
+}
+
+TcQuery::~TcQuery()
+{
+    if (sock) {
+        nl_close(sock);
+        nl_socket_free(sock);
+    }
+}
+
+bool TcQuery::open()
+{
+    if (sock) return true;
+    sock = nl_socket_alloc();
+    if (!sock) {
+        std::cerr << "Failed to allocate the tc netlink socket" << std::endl;
+        return false;
+    }
+    if (nl_connect(sock, NETLINK_ROUTE) < 0) {
+        std::cerr << "Failed to connect the tc netlink socket" << std::endl;
+        nl_socket_free(sock);
+        sock = nullptr;
+        return false;
+    }
+    return true;
+}
+
+// Tbf that is not the root qdisc of its interface
+struct ChildTbf {
+    int ifindex;
+    uint32_t parent;
+    uint64_t rate_bps;
+};
+
+// What the qdisc dump gives before the tbf rates are matched to their interface
+struct QdiscDump {
+    std::map<int, TcInterface> interfaces;
+    std::map<int, uint32_t> root_handles; // Ifindex -> handle of the root qdisc
+    std::vector<ChildTbf> child_tbfs;
+};
+
+// One qdisc of the dump, the rate of a root tbf goes to its interface
+static int collect_qdisc(struct nl_msg* msg, void* arg)
+{
+    auto* dump = (QdiscDump*)arg;
+    struct nlmsghdr* header = nlmsg_hdr(msg);
+    if (header->nlmsg_type != RTM_NEWQDISC) return NL_OK;
+
+    const struct tcmsg* qdisc = (const struct tcmsg*)nlmsg_data(header);
+    struct nlattr* attributes[TCA_MAX + 1];
+    if (nlmsg_parse(header, sizeof(struct tcmsg), attributes, TCA_MAX, nullptr) < 0 || !attributes[TCA_KIND]) {
+        return NL_OK;
+    }
+    std::string kind = nla_get_string(attributes[TCA_KIND]);
+
+    TcInterface& interface = dump->interfaces[qdisc->tcm_ifindex];
+    if (interface.name.empty()) {
+        char name[IF_NAMESIZE] = {0};
+        interface.ifindex = qdisc->tcm_ifindex;
+        interface.name = if_indextoname(qdisc->tcm_ifindex, name) ? name : std::to_string(qdisc->tcm_ifindex);
+    }
+    if (qdisc->tcm_parent == TC_H_ROOT) {
+        interface.root_kind = kind;
+        dump->root_handles[qdisc->tcm_ifindex] = qdisc->tcm_handle;
+    }
+
+    if (kind != "tbf" || !attributes[TCA_OPTIONS]) {
+        return NL_OK;
+    }
+    struct nlattr* options[TCA_TBF_MAX + 1];
+    if (nla_parse_nested(options, TCA_TBF_MAX, attributes[TCA_OPTIONS], nullptr) < 0) {
+        return NL_OK;
+    }
+    uint64_t bytes_per_second = 0;
+    if (options[TCA_TBF_RATE64]) {
+        bytes_per_second = nla_get_u64(options[TCA_TBF_RATE64]); // Only sent above 4 GB/s
+    } else if (options[TCA_TBF_PARMS] && nla_len(options[TCA_TBF_PARMS]) >= (int)sizeof(struct tc_tbf_qopt)) {
+        bytes_per_second = ((const struct tc_tbf_qopt*)nla_data(options[TCA_TBF_PARMS]))->rate.rate;
+    }
+    if (qdisc->tcm_parent == TC_H_ROOT) {
+        interface.rate_bps = bytes_per_second * 8;
+    } else {
+        // Only counted under the root netem (see set_netem), the root may come later in the dump
+        dump->child_tbfs.push_back({qdisc->tcm_ifindex, qdisc->tcm_parent, bytes_per_second * 8});
+    }
+    return NL_OK;
+}
+
+bool TcQuery::refresh()
+{
+    if (!open()) {
+        refreshed_at_ms = steady_time_ms(); // Not tried again before max_age_ms
+        return false;
+    }
+
+    QdiscDump dumped;
+    struct tcmsg header{};
+    header.tcm_family = AF_UNSPEC;
+    nl_socket_modify_cb(sock, NL_CB_VALID, NL_CB_CUSTOM, collect_qdisc, &dumped);
+    int err = nl_send_simple(sock, RTM_GETQDISC, NLM_F_DUMP, &header, sizeof(header));
+    if (err >= 0) {
+        err = nl_recvmsgs_default(sock);
+    }
+    nl_socket_modify_cb(sock, NL_CB_VALID, NL_CB_DEFAULT, nullptr, nullptr);
+    if (err < 0) {
+        std::cerr << "Failed to dump the qdiscs: " << nl_geterror(err) << std::endl;
+        refreshed_at_ms = steady_time_ms(); // Not dumped again before max_age_ms
+        return false;
+    }
+
+    // A tbf deeper in a hierarchy of classes says nothing of the rate of the interface
+    for (const ChildTbf& tbf : dumped.child_tbfs) {
+        TcInterface& interface = dumped.interfaces[tbf.ifindex];
+        if (interface.root_kind == "netem" && TC_H_MAJ(tbf.parent) == TC_H_MAJ(dumped.root_handles[tbf.ifindex])) {
+            interface.rate_bps = tbf.rate_bps;
+        }
+    }
+    interfaces.swap(dumped.interfaces);
+    refreshed_at_ms = steady_time_ms();
+    dumps++;
+    return true;
+}
+
+const std::map<int, TcInterface>& TcQuery::get_interfaces()
+{
+    if (refreshed_at_ms < 0 || steady_time_ms() - refreshed_at_ms >= max_age_ms) {
+        refresh();
+    }
+    return interfaces;
+}
+
+uint64_t TcQuery::rate_bps(int ifindex)
+{
+    const std::map<int, TcInterface>& all = get_interfaces();
+    auto it = all.find(ifindex);
+    return it == all.end() ? 0 : it->second.rate_bps;
+}
+
+uint64_t TcQuery::rate_bps(const std::string& name)
+{
+    for (const auto& [ifindex, interface] : get_interfaces()) {
+        if (interface.name == name) {
+            return interface.rate_bps;
+        }
+    }
+    return 0;
+}
+
+// Tbf under parent (TC_H_ROOT or the class of another qdisc), created or replaced
+static int add_tbf(struct nl_sock* sock, int ifindex, uint32_t parent, uint32_t handle, uint64_t rate_bps, uint32_t burst_bytes, uint32_t latency_us)
+{
+    if (rate_bps / 8 > INT32_MAX) return -NLE_RANGE; // libnl takes the rate as an int in bytes/s
+
+    struct rtnl_qdisc* qdisc = rtnl_qdisc_alloc();
+    if (!qdisc) return -NLE_NOMEM;
+    rtnl_tc_set_ifindex(TC_CAST(qdisc), ifindex);
+    rtnl_tc_set_parent(TC_CAST(qdisc), parent);
+    if (handle != 0) {
+        rtnl_tc_set_handle(TC_CAST(qdisc), handle);
+    }
+    int err = rtnl_tc_set_kind(TC_CAST(qdisc), "tbf");
+    if (err >= 0) {
+        rtnl_qdisc_tbf_set_rate(qdisc, rate_bps / 8, burst_bytes, 0);
+        err = rtnl_qdisc_tbf_set_limit_by_latency(qdisc, latency_us); // Needs the rate first
+    }
+    if (err >= 0) {
+        err = rtnl_qdisc_add(sock, qdisc, NLM_F_CREATE | NLM_F_REPLACE);
+    }
+    rtnl_qdisc_put(qdisc);
+    return err;
+}
+
+int TcQuery::set_tbf(int ifindex, uint64_t rate_bps, uint32_t burst_bytes, uint32_t latency_us)
+{
+    if (!open()) return -NLE_NOMEM;
+    // Replaces whatever root qdisc is there, like "tc qdisc del" then "tc qdisc add" but in one request
+    int err = add_tbf(sock, ifindex, TC_H_ROOT, 0, rate_bps, burst_bytes, latency_us);
+    invalidate();
+    return err < 0 ? err : 0;
+}
+
+int TcQuery::set_netem(int ifindex, uint32_t delay_us, double loss_percent, uint64_t rate_bps, uint32_t burst_bytes, uint32_t latency_us)
+{
+    if (!open()) return -NLE_NOMEM;
+
+    // Replaced in one request like set_tbf, the interface never goes without its root. A netem already
+    // there is changed in place and keeps its child, which is replaced or removed below
+    struct rtnl_qdisc* qdisc = rtnl_qdisc_alloc();
+    if (!qdisc) return -NLE_NOMEM;
+    rtnl_tc_set_ifindex(TC_CAST(qdisc), ifindex);
+    rtnl_tc_set_parent(TC_CAST(qdisc), TC_H_ROOT);
+    rtnl_tc_set_handle(TC_CAST(qdisc), TC_HANDLE(1, 0));
+    int err = rtnl_tc_set_kind(TC_CAST(qdisc), "netem");
+    if (err >= 0) {
+        rtnl_netem_set_delay(qdisc, delay_us);
+        double probability = std::min(100.0, std::max(0.0, loss_percent)) / 100;
+        rtnl_netem_set_loss(qdisc, (int)(uint32_t)(probability * NL_PROB_MAX)); // Scaled to the u32 range
+        err = rtnl_qdisc_add(sock, qdisc, NLM_F_CREATE | NLM_F_REPLACE);
+    }
+    rtnl_qdisc_put(qdisc);
+
+    if (err >= 0 && rate_bps > 0) {
+        err = add_tbf(sock, ifindex, TC_HANDLE(1, 1), TC_HANDLE(10, 0), rate_bps, burst_bytes, latency_us);
+    } else if (err >= 0) {
+        // The tbf of a previous rate, without it netem queues the packets itself
+        struct rtnl_qdisc* child = rtnl_qdisc_alloc();
+        err = -NLE_NOMEM;
+        if (child) {
+            rtnl_tc_set_ifindex(TC_CAST(child), ifindex);
+            rtnl_tc_set_parent(TC_CAST(child), TC_HANDLE(1, 1));
+            err = rtnl_qdisc_delete(sock, child);
+            rtnl_qdisc_put(child);
+        }
+        if (err == -NLE_OBJ_NOTFOUND || err == -NLE_NOATTR || err == -NLE_INVAL) {
+            err = 0; // There was none
+        }
+    }
+    invalidate();
+    return err < 0 ? err : 0;
+}
+
+int TcQuery::delete_root_qdisc(int ifindex)
+{
+    if (!open()) return -NLE_NOMEM;
+
+    struct rtnl_qdisc* qdisc = rtnl_qdisc_alloc();
+    if (!qdisc) return -NLE_NOMEM;
+    rtnl_tc_set_ifindex(TC_CAST(qdisc), ifindex);
+    rtnl_tc_set_parent(TC_CAST(qdisc), TC_H_ROOT);
+    int err = rtnl_qdisc_delete(sock, qdisc);
+    rtnl_qdisc_put(qdisc);
+    invalidate();
+    if (err == -NLE_OBJ_NOTFOUND || err == -NLE_NOATTR || err == -NLE_INVAL) {
+        return 0; // Only the default qdisc, which can't be removed
+    }
+    return err < 0 ? err : 0;
+}
@@ -0,0 +1,50 @@
+#ifndef TC_QUERY_H
+#define TC_QUERY_H
+
+#include <string>
+#include <map>
+#include <cstdint>
+
+struct nl_sock;
+
+// Traffic control state of one interface, from its qdiscs
+struct TcInterface {
+    int ifindex = 0;
+    std::string name;
+    std::string root_kind; // Kind of the root qdisc : "tbf", "fq_codel", "noqueue"...
+    uint64_t rate_bps = 0; // Rate of the root tbf, or of the tbf under a root netem, in bit/s. 0 if it is not shaped
+};
+
+// Qdiscs and tbf rates of every interface read with one RTM_GETQDISC dump on a socket kept open,
+// instead of running "tc qdisc show" for each interface. The result is kept max_age_ms before the
+// next dump, so the rates can be asked for as often as needed
+class TcQuery {
+public:
+    explicit TcQuery(long long max_age_ms = 1000);
+    ~TcQuery();
+
+    bool refresh(); // Dump now, false on error (the previous result is kept max_age_ms more)
+    void invalidate() { refreshed_at_ms = -1; } // Next read dumps again
+    const std::map<int, TcInterface>& get_interfaces(); // Ifindex -> interface, dumps when too old
+    uint64_t rate_bps(int ifindex); // 0 if unshaped or unknown
+    uint64_t rate_bps(const std::string& name);
+
+    // Replace the root qdisc of the interface by a tbf, returns a libnl error code (0 on success)
+    int set_tbf(int ifindex, uint64_t rate_bps, uint32_t burst_bytes, uint32_t latency_us);
+    // Root netem with this delay and loss, and a tbf under it when rate_bps is not 0 (replaced in place)
+    int set_netem(int ifindex, uint32_t delay_us, double loss_percent, uint64_t rate_bps, uint32_t burst_bytes, uint32_t latency_us);
+    // Back to the default qdisc of the interface, 0 if there was nothing to remove
+    int delete_root_qdisc(int ifindex);
+
+    size_t dumps = 0; // Dumps done since start
+
+private:
+    bool open();
+
+    long long max_age_ms;
+    long long refreshed_at_ms = -1;
+    struct nl_sock* sock = nullptr;
+    std::map<int, TcInterface> interfaces;
+};
+
+#endif // TC_QUERY_H
@@ -5,82 +5,204 @@
 #include <vector>
 #include <set>
 #include <sstream>
-#include <array>
 #include <random>
+#include <fstream>
+#include <map>
+#include <cstdint>
+#include <ctime>
+#include <cerrno>
+#include <net/if.h>
+#include <netlink/errno.h>
+#include <netlink/socket.h>
+#include <netlink/route/link.h>
+#include "../communication/tc_query.h"
+#include "scenario.h"
 
-// Execute une commande et récupère la sortie
-std::string execCommand(const char* cmd) {
-    std::array<char, 256> buffer;
-    std::string result;
-    FILE* pipe = popen(cmd, "r");
-    if (!pipe) throw std::runtime_error("popen() a échoué !");
-    while (fgets(buffer.data(), buffer.size(), pipe) != nullptr) {
-        result += buffer.data();
-    }
-    pclose(pipe);
-    return result;
-}
+// Paramètres du tbf, comme avec tc avant : burst 32kbit, latency 400ms
+const uint32_t TBF_BURST_BYTES = 4000;
+const uint32_t TBF_LATENCY_US = 400000;
 
-// Liste toutes les interfaces sauf "lo"
-std::vector<std::string> getNetworkInterfaces() {
-    std::string ipOutput = execCommand("ip -o link show | awk -F': ' '{print $2}'");
-    std::istringstream stream(ipOutput);
-    std::string line;
-    std::vector<std::string> interfaces;
+// Liste toutes les interfaces sauf "lo" avec un dump RTM_GETLINK : une interface down n'a que la qdisc
+// noop, absente du dump des qdiscs. Celui-ci ne donne que la qdisc racine et le débit de chacune
+bool getNetworkInterfaces(struct nl_sock* sock, TcQuery& tc, std::vector<TcInterface>& interfaces) {
     std::set<std::string> ignored = {"lo"};
 
-    while (std::getline(stream, line)) {
-        if (!line.empty() && ignored.find(line) == ignored.end()) {
-            interfaces.push_back(line);
+    struct nl_cache* links = nullptr;
+    if (rtnl_link_alloc_cache(sock, AF_UNSPEC, &links) < 0) {
+        return false;
+    }
+    const std::map<int, TcInterface>& qdiscs = tc.get_interfaces();
+    for (struct nl_object* object = nl_cache_get_first(links); object; object = nl_cache_get_next(object)) {
+        struct rtnl_link* link = (struct rtnl_link*)object;
+        TcInterface iface;
+        iface.ifindex = rtnl_link_get_ifindex(link);
+        iface.name = rtnl_link_get_name(link) ? rtnl_link_get_name(link) : std::to_string(iface.ifindex);
+        auto qdisc = qdiscs.find(iface.ifindex);
+        if (qdisc != qdiscs.end()) {
+            iface.root_kind = qdisc->second.root_kind;
+            iface.rate_bps = qdisc->second.rate_bps;
+        }
+        if (ignored.find(iface.name) == ignored.end()) {
+            interfaces.push_back(iface);
         }
     }
-    return interfaces;
+    nl_cache_free(links);
+    return true;
 }
 
-// Applique la limitation tc avec débit aléatoire
-void setRandomRate(const std::string& iface) {
-    // Valeurs de débit possibles
-    const std::vector<std::string> rates = {"1mbit", "5mbit", "10mbit", "50mbit"};
+// Applique la limitation tbf avec débit aléatoire
+void setRandomRate(TcQuery& tc, const TcInterface& iface) {
+    // Valeurs de débit possibles en bit/s
+    const std::vector<uint64_t> rates = {1000000, 5000000, 10000000, 50000000};
 
     // Générateur aléatoire
     static std::random_device rd;
     static std::mt19937 gen(rd());
     std::uniform_int_distribution<> dis(0, rates.size() - 1);
 
-    std::string rate = rates[dis(gen)];
-    std::string burst = "32kbit";
-    std::string latency = "400ms";
+    uint64_t rate = rates[dis(gen)];
 
-    try {
-        // Supprime la qdisc existante (ignore erreur)
-        std::string cmdDel = "sudo tc qdisc del dev " + iface + " root || true";
-        system(cmdDel.c_str());
+    // Remplace la qdisc racine existante en une seule requête (il faut CAP_NET_ADMIN)
+    int err = tc.set_tbf(iface.ifindex, rate, TBF_BURST_BYTES, TBF_LATENCY_US);
+    if (err == 0) {
+        std::cout << "[OK] Interface " << iface.name << " limitée à " << rate / 1000000 << "mbit" << std::endl;
+    } else {
+        std::cerr << "[Erreur] " << nl_geterror(err) << " pour " << iface.name << std::endl;
+    }
+}
 
-        // Ajoute la nouvelle limitation
-        std::string cmdAdd = "sudo tc qdisc add dev " + iface + " root tbf rate " + rate + " burst " + burst + " latency " + latency;
-        int ret = system(cmdAdd.c_str());
+// Met l'interface up ou down (IFF_UP), retourne un code d'erreur libnl
+int setLinkUp(struct nl_sock* sock, int ifindex, bool up) {
+    struct rtnl_link* link = rtnl_link_alloc();
+    struct rtnl_link* change = rtnl_link_alloc();
+    if (!link || !change) {
+        rtnl_link_put(link);
+        rtnl_link_put(change);
+        return -NLE_NOMEM;
+    }
+    rtnl_link_set_ifindex(link, ifindex);
+    if (up) {
+        rtnl_link_set_flags(change, IFF_UP);
+    } else {
+        rtnl_link_unset_flags(change, IFF_UP);
+    }
+    int err = rtnl_link_change(sock, link, change, 0);
+    rtnl_link_put(link);
+    rtnl_link_put(change);
+    return err;
+}
 
-        if (ret == 0) {
-            std::cout << "[OK] Interface " << iface << " limitée à " << rate << std::endl;
-        } else {
-            std::cerr << "[Erreur] Commande échouée pour " << iface << std::endl;
+// Applique un évènement : les conditions cumulées de l'interface donnent une seule qdisc racine,
+// tbf pour un débit seul, netem (avec un tbf dessous si besoin) dès qu'il y a délai ou pertes
+int applyEvent(TcQuery& tc, struct nl_sock* link_sock, const ScenarioEvent& event, int ifindex, LinkCondition& condition) {
+    if (event.action == SCENARIO_DOWN || event.action == SCENARIO_UP) {
+        return setLinkUp(link_sock, ifindex, event.action == SCENARIO_UP);
+    }
+    apply_to_condition(event, condition);
+    if (condition.delay_us == 0 && condition.loss_percent == 0) {
+        if (condition.rate_bps == 0) {
+            return tc.delete_root_qdisc(ifindex);
         }
-    } catch (const std::exception& e) {
-        std::cerr << "[Exception] " << e.what() << " sur interface " << iface << std::endl;
+        return tc.set_tbf(ifindex, condition.rate_bps, TBF_BURST_BYTES, TBF_LATENCY_US);
     }
+    return tc.set_netem(ifindex, condition.delay_us, condition.loss_percent, condition.rate_bps, TBF_BURST_BYTES, TBF_LATENCY_US);
+}
+
+long long clockMicroseconds(clockid_t clock) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
 }
 
-int main() {
-    std::vector<std::string> interfaces;
-    try {
-        interfaces = getNetworkInterfaces();
-    } catch (const std::exception& e) {
-        std::cerr << "Erreur récupération interfaces : " << e.what() << std::endl;
+// Joue le scénario : chaque évènement est appliqué à son heure (horloge monotone, attente absolue
+// pour ne pas accumuler de retard) et journalisé avec l'heure exacte d'application. L'heure murale
+// (epoch_us) sert à retrouver l'évènement dans les journaux des routeurs pour mesurer la reconvergence
+int runScenario(const std::string& scenarioFile, std::ostream& log) {
+    std::ifstream input(scenarioFile);
+    if (!input) {
+        std::cerr << "Impossible d'ouvrir " << scenarioFile << std::endl;
+        return 1;
+    }
+    std::vector<ScenarioEvent> events;
+    std::string error;
+    if (!parse_scenario(input, events, error)) {
+        std::cerr << scenarioFile << " : " << error << std::endl;
+        return 1;
+    }
+
+    // Les interfaces sont résolues avant de commencer pour ne pas fausser les temps
+    std::map<std::string, int> ifindexes;
+    for (const ScenarioEvent& event : events) {
+        int ifindex = if_nametoindex(event.interface.c_str());
+        if (ifindex == 0) {
+            std::cerr << "Interface inconnue " << event.interface << " (ligne " << event.line << ")" << std::endl;
+            return 1;
+        }
+        ifindexes[event.interface] = ifindex;
+    }
+
+    TcQuery tc;
+    struct nl_sock* link_sock = nl_socket_alloc();
+    if (!link_sock || nl_connect(link_sock, NETLINK_ROUTE) < 0) {
+        std::cerr << "Erreur socket netlink" << std::endl;
+        nl_socket_free(link_sock);
+        return 1;
+    }
+
+    std::map<std::string, LinkCondition> conditions;
+    int failures = 0;
+    log << "planned_ms\tapplied_ms\tlate_us\ttook_us\tepoch_us\tevent\tresult" << std::endl;
+    long long start_us = clockMicroseconds(CLOCK_MONOTONIC);
+    for (const ScenarioEvent& event : events) {
+        long long due_us = start_us + event.at_us;
+        struct timespec due = {(time_t)(due_us / 1000000), (long)(due_us % 1000000) * 1000};
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, nullptr) == EINTR) {
+        }
+
+        long long applied_us = clockMicroseconds(CLOCK_MONOTONIC);
+        long long epoch_us = clockMicroseconds(CLOCK_REALTIME);
+        int err = applyEvent(tc, link_sock, event, ifindexes[event.interface], conditions[event.interface]);
+        long long took_us = clockMicroseconds(CLOCK_MONOTONIC) - applied_us;
+
+        failures += (err < 0) ? 1 : 0;
+        log << event.at_us / 1000.0 << "\t" << (applied_us - start_us) / 1000.0 << "\t" << applied_us - due_us << "\t" << took_us
+            << "\t" << epoch_us << "\t" << describe_event(event) << "\t" << (err < 0 ? nl_geterror(err) : "ok") << std::endl;
+    }
+
+    nl_close(link_sock);
+    nl_socket_free(link_sock);
+    std::cerr << events.size() << " évènements, " << failures << " en erreur" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
+
+// Sans argument : un débit aléatoire par interface, comme avant
+// Avec un scénario : debitGenerator <scénario> [journal], le journal va sur la sortie standard par défaut
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        if (argc > 2) {
+            std::ofstream log(argv[2]);
+            if (!log) {
+                std::cerr << "Impossible d'écrire " << argv[2] << std::endl;
+                return 1;
+            }
+            return runScenario(argv[1], log);
+        }
+        return runScenario(argv[1], std::cout);
+    }
+
+    TcQuery tc;
+    std::vector<TcInterface> interfaces;
+    struct nl_sock* link_sock = nl_socket_alloc();
+    if (!link_sock || nl_connect(link_sock, NETLINK_ROUTE) < 0 || !getNetworkInterfaces(link_sock, tc, interfaces)) {
+        std::cerr << "Erreur récupération interfaces" << std::endl;
+        nl_socket_free(link_sock);
         return 1;
     }
+    nl_close(link_sock);
+    nl_socket_free(link_sock);
 
     for (const auto& iface : interfaces) {
-        setRandomRate(iface);
+        setRandomRate(tc, iface);
     }
 
     return 0;
@@ -0,0 +1,154 @@
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include "scenario.h"
+
+// Nombre suivi d'un suffixe connu, la valeur est multipliée par celui du suffixe
+static bool parse_with_unit(const std::string& text, const std::vector<std::pair<std::string, double>>& units, double& value)
+{
+    size_t number_end = 0;
+    while (number_end < text.size() && (std::isdigit((unsigned char)text[number_end]) || text[number_end] == '.')) {
+        number_end++;
+    }
+    if (number_end == 0) return false;
+
+    std::string unit = text.substr(number_end);
+    std::transform(unit.begin(), unit.end(), unit.begin(), [](unsigned char c) { return std::tolower(c); });
+    for (const auto& [name, factor] : units) {
+        if (unit == name) {
+            try {
+                size_t used = 0;
+                value = std::stod(text.substr(0, number_end), &used) * factor;
+                return used == number_end; // "1.5.3" would stop at 1.5
+            } catch (const std::exception&) {
+                return false;
+            }
+        }
+    }
+    return false;
+}
+
+bool parse_rate(const std::string& text, uint64_t& rate_bps)
+{
+    double value;
+    if (!parse_with_unit(text, {{"bit", 1}, {"kbit", 1e3}, {"mbit", 1e6}, {"gbit", 1e9}}, value)) {
+        return false;
+    }
+    rate_bps = (uint64_t)value;
+    return true;
+}
+
+bool parse_duration_us(const std::string& text, uint64_t& duration_us)
+{
+    double value;
+    if (!parse_with_unit(text, {{"", 1e3}, {"us", 1}, {"ms", 1e3}, {"s", 1e6}}, value)) {
+        return false;
+    }
+    duration_us = (uint64_t)value;
+    return true;
+}
+
+const char* scenario_action_name(ScenarioAction action)
+{
+    switch (action) {
+        case SCENARIO_RATE: return "rate";
+        case SCENARIO_DELAY: return "delay";
+        case SCENARIO_LOSS: return "loss";
+        case SCENARIO_CLEAR: return "clear";
+        case SCENARIO_DOWN: return "down";
+        default: return "up";
+    }
+}
+
+std::string describe_event(const ScenarioEvent& event)
+{
+    std::string text = event.interface + " " + scenario_action_name(event.action);
+    if (event.action == SCENARIO_RATE) {
+        text += " " + std::to_string(event.rate_bps) + "bit";
+    } else if (event.action == SCENARIO_DELAY) {
+        text += " " + std::to_string(event.delay_us) + "us";
+    } else if (event.action == SCENARIO_LOSS) {
+        std::ostringstream loss;
+        loss << event.loss_percent;
+        text += " " + loss.str() + "%";
+    }
+    return text;
+}
+
+bool parse_scenario(std::istream& input, std::vector<ScenarioEvent>& events, std::string& error)
+{
+    std::string line;
+    int line_number = 0;
+    while (std::getline(input, line)) {
+        line_number++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+        std::istringstream fields(line);
+        std::string time, interface, action, value, extra;
+        if (!(fields >> time)) {
+            continue; // Ligne vide
+        }
+        fields >> interface >> action >> value >> extra;
+
+        ScenarioEvent event;
+        event.line = line_number;
+        event.interface = interface;
+        uint64_t at_us;
+        bool ok = !interface.empty() && parse_duration_us(time, at_us) && at_us <= (uint64_t)LLONG_MAX && extra.empty();
+        event.at_us = ok ? (long long)at_us : 0;
+
+        if (ok && action == "rate") {
+            event.action = SCENARIO_RATE;
+            ok = parse_rate(value, event.rate_bps) || value == "0";
+        } else if (ok && action == "delay") {
+            event.action = SCENARIO_DELAY;
+            uint64_t delay_us;
+            ok = parse_duration_us(value, delay_us) && delay_us <= UINT32_MAX;
+            event.delay_us = (uint32_t)delay_us;
+        } else if (ok && action == "loss") {
+            event.action = SCENARIO_LOSS;
+            if (!value.empty() && value.back() == '%') {
+                value.pop_back();
+            }
+            try {
+                size_t used = 0;
+                event.loss_percent = std::stod(value, &used);
+                ok = used == value.size() && event.loss_percent >= 0 && event.loss_percent <= 100;
+            } catch (const std::exception&) {
+                ok = false;
+            }
+        } else if (ok && (action == "clear" || action == "down" || action == "up")) {
+            event.action = (action == "clear") ? SCENARIO_CLEAR : (action == "down") ? SCENARIO_DOWN : SCENARIO_UP;
+            ok = value.empty();
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            error = "ligne " + std::to_string(line_number) + " illisible : \"" + line + "\"";
+            return false;
+        }
+        events.push_back(event);
+    }
+
+    std::stable_sort(events.begin(), events.end(), [](const ScenarioEvent& a, const ScenarioEvent& b) {
+        return a.at_us < b.at_us;
+    });
+    return true;
+}
+
+void apply_to_condition(const ScenarioEvent& event, LinkCondition& condition)
+{
+    switch (event.action) {
+        case SCENARIO_RATE: condition.rate_bps = event.rate_bps; break;
+        case SCENARIO_DELAY: condition.delay_us = event.delay_us; break;
+        case SCENARIO_LOSS: condition.loss_percent = event.loss_percent; break;
+        case SCENARIO_CLEAR: condition = LinkCondition(); break;
+        default: break;
+    }
+}
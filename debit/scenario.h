@@ -0,0 +1,52 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <cstdint>
+
+// Actions possibles d'une ligne de scénario
+enum ScenarioAction {
+    SCENARIO_RATE, // Débit max (tbf), 0 l'enlève
+    SCENARIO_DELAY, // Délai ajouté (netem)
+    SCENARIO_LOSS, // Pourcentage de paquets perdus (netem)
+    SCENARIO_CLEAR, // Enlève débit, délai et pertes
+    SCENARIO_DOWN, // Interface administrativement down
+    SCENARIO_UP
+};
+
+// Un évènement daté du scénario, at_us est compté depuis le début du scénario (les temps en us sont gardés)
+struct ScenarioEvent {
+    long long at_us;
+    std::string interface;
+    ScenarioAction action;
+    uint64_t rate_bps = 0;
+    uint32_t delay_us = 0;
+    double loss_percent = 0;
+    int line = 0; // Ligne du fichier, pour les messages
+};
+
+// Conditions appliquées à une interface, cumulées au fil des évènements
+struct LinkCondition {
+    uint64_t rate_bps = 0;
+    uint32_t delay_us = 0;
+    double loss_percent = 0;
+};
+
+// Une ligne par évènement : "<temps> <interface> <action> [valeur]", # commence un commentaire
+//   5s    eth0  rate 10mbit
+//   5s    eth1  delay 50ms
+//   6500  eth1  loss 2%
+//   10s   eth0  down
+// Le temps est en ms sans unité, ou en us, ms ou s. Les évènements sont triés par temps, dans l'ordre du fichier à temps égal
+bool parse_scenario(std::istream& input, std::vector<ScenarioEvent>& events, std::string& error);
+bool parse_rate(const std::string& text, uint64_t& rate_bps); // "10mbit", "500kbit", "1gbit", "64000bit"
+bool parse_duration_us(const std::string& text, uint64_t& duration_us); // "250us", "50ms", "2s", "1500" (ms)
+const char* scenario_action_name(ScenarioAction action);
+std::string describe_event(const ScenarioEvent& event);
+
+// Conditions de l'interface après l'évènement (down et up ne les changent pas)
+void apply_to_condition(const ScenarioEvent& event, LinkCondition& condition);
+
+#endif // SCENARIO_H
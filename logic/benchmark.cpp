@@ -0,0 +1,354 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include "logic.h"
+#include "graph.h"
+#include "lsdb_store.h"
+#include "wire.h"
+#include "incremental_spf.h"
+
+// Synthetic lsdb with about node_count nodes (routers + subnets)
+// Routers are linked by a random tree of /24 transit subnets, half of them also get a stub subnet
+std::map<std::string, std::map<std::string, RouterDeclaration>> make_synthetic_lsdb(int node_count, unsigned int seed)
+{
+    std::map<std::string, std::map<std::string, RouterDeclaration>> lsdb;
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<> cost_dis(1, 20);
+
+    int router_count = std::max(2, node_count * 2 / 5); // routers + (routers - 1) transit + routers / 2 stubs
+    int subnet_id = 0;
+
+    auto subnet_ip = [](int id, int host) {
+        return "10." + std::to_string(id / 256) + "." + std::to_string(id % 256) + "." + std::to_string(host) + "/24";
+    };
+
+    for (int i = 1; i < router_count; ++i)
+    {
+        std::uniform_int_distribution<> parent_dis(std::max(0, i - 50), i - 1); // Keep the tree not too deep
+        int j = parent_dis(gen);
+        int cost = cost_dis(gen);
+        add_router_declaration(lsdb, create_router_definition("R" + std::to_string(i), subnet_ip(subnet_id, 1), cost));
+        add_router_declaration(lsdb, create_router_definition("R" + std::to_string(j), subnet_ip(subnet_id, 2), cost));
+        subnet_id++;
+    }
+
+    for (int i = 0; i < router_count; i += 2)
+    {
+        add_router_declaration(lsdb, create_router_definition("R" + std::to_string(i), subnet_ip(subnet_id, 1), cost_dis(gen)));
+        subnet_id++;
+    }
+
+    return lsdb;
+}
+
+// Rough size of the std::map lsdb : map nodes (about 4 pointers + color) and strings out of the SSO buffer
+size_t lsdb_map_memory(const std::map<std::string, std::map<std::string, RouterDeclaration>>& lsdb)
+{
+    auto string_heap = [](const std::string& str) { return str.capacity() > 15 ? str.capacity() + 1 : 0; };
+    const size_t node_overhead = 4 * sizeof(void*);
+
+    size_t bytes = sizeof(lsdb);
+    for (const auto& [router_name, router_links] : lsdb)
+    {
+        bytes += node_overhead + sizeof(std::pair<const std::string, std::map<std::string, RouterDeclaration>>) + string_heap(router_name);
+        for (const auto& [ip_mask, declaration] : router_links)
+        {
+            bytes += node_overhead + sizeof(std::pair<const std::string, RouterDeclaration>) + string_heap(ip_mask);
+            bytes += string_heap(declaration.router_name) + string_heap(declaration.ip_with_mask);
+        }
+    }
+    return bytes;
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Legacy path timed on a sample of destinations only, the full run is far too long on big lsdbs
+double time_per_subnet_sampled(std::map<std::string, std::map<std::string, RouterDeclaration>>& lsdb, int sample_size)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::string> all_nodes = get_all_nodes(lsdb);
+    std::vector<std::string> all_subnets = get_all_subnets(lsdb);
+    std::vector<std::vector<int>> matrix = create_n_by_n_matrix(all_nodes.size());
+    build_matrix_from_lsbd(matrix, lsdb, all_nodes);
+    double setup_ms = elapsed_ms(start);
+
+    int router_count = all_nodes.size() - all_subnets.size();
+    int source = std::find(all_nodes.begin(), all_nodes.end(), "R0") - all_nodes.begin();
+    int step = std::max<int>(1, all_subnets.size() / sample_size);
+
+    start = std::chrono::steady_clock::now();
+    int sampled = 0;
+    for (size_t i = 0; i < all_subnets.size(); i += step)
+    {
+        dijkstraNextHop(matrix, source, router_count + i);
+        sampled++;
+    }
+    double per_dijkstra_ms = elapsed_ms(start) / sampled;
+
+    return setup_ms + per_dijkstra_ms * all_subnets.size();
+}
+
+int main()
+{
+    std::cout << "=== compute_all_routes : single shortest-path tree vs one Dijkstra per subnet ===" << std::endl;
+    std::cout << "nodes\trouters\tsubnets\tper_subnet_ms\tsingle_tree_ms\tspeedup" << std::endl;
+
+    // compute_all_routes prints every route, we only want the timings
+    std::cout.flush();
+    std::streambuf* cout_buf = std::cout.rdbuf();
+
+    for (int node_count : {100, 1000, 10000})
+    {
+        auto lsdb = make_synthetic_lsdb(node_count, 42);
+        size_t routers = get_all_routers(lsdb).size();
+        size_t subnets = get_all_subnets(lsdb).size();
+
+        std::cout.rdbuf(nullptr);
+        double legacy_ms;
+        bool extrapolated = node_count > 1000;
+        if (!extrapolated)
+        {
+            auto start = std::chrono::steady_clock::now();
+            compute_all_routes_per_subnet("R0", lsdb);
+            legacy_ms = elapsed_ms(start);
+        }
+        else
+        {
+            legacy_ms = time_per_subnet_sampled(lsdb, 20);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        compute_all_routes("R0", lsdb);
+        double tree_ms = elapsed_ms(start);
+        std::cout.rdbuf(cout_buf);
+        std::cout.clear();
+
+        std::cout << routers + subnets << "\t" << routers << "\t" << subnets << "\t"
+                  << legacy_ms << (extrapolated ? " (extrapolated)" : "") << "\t"
+                  << tree_ms << "\t" << legacy_ms / tree_ms << "x" << std::endl;
+    }
+
+    std::cout << "\n=== Topology : dense adjacency matrix vs sparse CSR graph ===" << std::endl;
+    std::cout << "nodes\tmatrix_KB\tcsr_KB\tmatrix_build_ms\tcsr_build_ms\tmatrix_spf_ms\tcsr_spf_ms" << std::endl;
+
+    for (int node_count : {100, 1000, 5000})
+    {
+        auto lsdb = make_synthetic_lsdb(node_count, 42);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> all_nodes = get_all_nodes(lsdb);
+        std::vector<std::vector<int>> matrix = create_n_by_n_matrix(all_nodes.size());
+        build_matrix_from_lsbd(matrix, lsdb, all_nodes);
+        double matrix_build_ms = elapsed_ms(start);
+
+        start = std::chrono::steady_clock::now();
+        TopologyGraph graph = build_topology_graph(lsdb);
+        double csr_build_ms = elapsed_ms(start);
+
+        int source = find_node(graph, "R0");
+        std::vector<int> dist;
+        std::vector<int> parent;
+        start = std::chrono::steady_clock::now();
+        dijkstraShortestPathTree(matrix, source, dist, parent);
+        double matrix_spf_ms = elapsed_ms(start);
+
+        SpfWorkspace workspace;
+        csrShortestPathTree(graph, source, workspace); // Warm up the workspace, later runs reuse it
+        start = std::chrono::steady_clock::now();
+        csrShortestPathTree(graph, source, workspace);
+        double csr_spf_ms = elapsed_ms(start);
+
+        std::cout << all_nodes.size() << "\t" << adjacency_matrix_memory(matrix) / 1024 << "\t"
+                  << topology_graph_memory(graph) / 1024 << "\t" << matrix_build_ms << "\t"
+                  << csr_build_ms << "\t" << matrix_spf_ms << "\t" << csr_spf_ms << std::endl;
+    }
+
+    std::cout << "\n=== Lsdb : std::map of RouterDeclaration vs interned LinkStateStore ===" << std::endl;
+    std::cout << "links\tmap_bytes_per_link\tstore_bytes_per_link\tmap_subnet_scan_ms\tstore_subnet_scan_ms\tmap_graph_ms\tstore_graph_ms" << std::endl;
+
+    for (int node_count : {1000, 10000, 50000})
+    {
+        auto lsdb = make_synthetic_lsdb(node_count, 42);
+        LinkStateStore store;
+        size_t link_count = 0;
+        for (const auto& [router_name, router_links] : lsdb)
+        {
+            for (const auto& [ip_mask, declaration] : router_links)
+            {
+                store.add_router_declaration(declaration);
+                link_count++;
+            }
+        }
+
+        // Same work as get_all_subnets : find every unique network
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> map_subnets = get_all_subnets(lsdb);
+        double map_scan_ms = elapsed_ms(start);
+
+        start = std::chrono::steady_clock::now();
+        std::vector<uint64_t> store_subnets;
+        store_subnets.reserve(store.link_count());
+        for (const PackedLink& link : store.get_links())
+        {
+            store_subnets.push_back(((uint64_t)link.network() << 8) | link.prefix_len);
+        }
+        std::sort(store_subnets.begin(), store_subnets.end());
+        store_subnets.erase(std::unique(store_subnets.begin(), store_subnets.end()), store_subnets.end());
+        double store_scan_ms = elapsed_ms(start);
+
+        start = std::chrono::steady_clock::now();
+        build_topology_graph(lsdb);
+        double map_graph_ms = elapsed_ms(start);
+
+        start = std::chrono::steady_clock::now();
+        build_topology_graph(store);
+        double store_graph_ms = elapsed_ms(start);
+
+        std::cout << link_count << "\t" << lsdb_map_memory(lsdb) / link_count << "\t"
+                  << store.memory_usage() / link_count << "\t" << map_scan_ms << "\t" << store_scan_ms << "\t"
+                  << map_graph_ms << "\t" << store_graph_ms
+                  << (map_subnets.size() == store_subnets.size() ? "" : "\t(subnet count mismatch!)") << std::endl;
+    }
+
+    std::cout << "\n=== SPF after one link change : full computation vs incremental repair ===" << std::endl;
+    std::cout << "nodes\tchanges\tfull_ms\tincremental_ms\tincremental_with_routes_ms\tfull_runs\taffected_nodes_avg" << std::endl;
+
+    for (int node_count : {1000, 10000})
+    {
+        auto lsdb = make_synthetic_lsdb(node_count, 42);
+        LinkStateStore store;
+        for (const auto& [router_name, router_links] : lsdb)
+        {
+            for (const auto& [ip_mask, declaration] : router_links)
+            {
+                store.add_router_declaration(declaration);
+            }
+        }
+
+        IncrementalSpf incremental;
+        incremental.update(store, "R0");
+
+        // Cost changes, removals and the same links coming back, on random links
+        std::mt19937 gen(1);
+        std::uniform_int_distribution<> cost_dis(1, 20);
+        const int change_count = 200;
+        std::vector<RouterDeclaration> removed;
+        double incremental_ms = 0;
+        double incremental_with_routes_ms = 0;
+        size_t affected_nodes = 0;
+        size_t full_runs_before = incremental.full_runs;
+        for (int i = 0; i < change_count; ++i)
+        {
+            std::uniform_int_distribution<size_t> link_dis(0, store.link_count() - 1);
+            RouterDeclaration declaration = store.to_declaration(store.get_links()[link_dis(gen)]);
+            declaration.timestamp += 1;
+            if (i % 4 == 1)
+            {
+                declaration.link_cost = LINK_COST_WITHDRAWN;
+                removed.push_back(declaration);
+            }
+            else if (i % 4 == 3 && !removed.empty())
+            {
+                declaration = removed.back();
+                declaration.link_cost = cost_dis(gen);
+                declaration.timestamp += 1;
+                removed.pop_back();
+            }
+            else
+            {
+                declaration.link_cost = cost_dis(gen);
+            }
+            store.add_router_declaration(declaration);
+
+            auto start = std::chrono::steady_clock::now();
+            incremental.update(store, "R0");
+            incremental_ms += elapsed_ms(start);
+            incremental.routes();
+            incremental_with_routes_ms += elapsed_ms(start);
+            affected_nodes += incremental.last_affected_nodes;
+        }
+
+        // Full run : graph built again from the store, then one tree (what on_spf did before)
+        std::cout.rdbuf(nullptr);
+        const int full_count = 10;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < full_count; ++i)
+        {
+            compute_all_routes("R0", store);
+        }
+        double full_ms = elapsed_ms(start) / full_count;
+        std::cout.rdbuf(cout_buf);
+        std::cout.clear();
+
+        std::cout << node_count << "\t" << change_count << "\t" << full_ms << "\t" << incremental_ms / change_count << "\t"
+                  << incremental_with_routes_ms / change_count << "\t" << incremental.full_runs - full_runs_before << "\t"
+                  << affected_nodes / change_count << std::endl;
+    }
+
+    std::cout << "\n=== Wire format : text vs binary (ns per message) ===" << std::endl;
+    {
+        const int iterations = 200000;
+        RouterDeclaration declaration = create_router_definition("R123456", "192.168.100.254/24", 1500);
+        std::string text = serialize_router_definition(declaration);
+        WireDeclaration wire;
+        to_wire_declaration(declaration, wire);
+        uint8_t buffer[WIRE_DECLARATION_SIZE];
+        size_t checksum = 0; // Used so the compiler can't remove the loops
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            checksum += serialize_router_definition(declaration).size();
+        }
+        double text_encode_ns = elapsed_ms(start) * 1e6 / iterations;
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            checksum += deserialize_router_definition(text).link_cost;
+        }
+        double text_decode_ns = elapsed_ms(start) * 1e6 / iterations;
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            wire.sequence = i;
+            checksum += encode_wire_declaration(wire, buffer, sizeof(buffer)) + buffer[23];
+        }
+        double binary_encode_ns = elapsed_ms(start) * 1e6 / iterations;
+
+        WireDeclaration decoded;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            buffer[23] = i;
+            checksum += decode_wire_declaration(buffer, sizeof(buffer), decoded) + decoded.sequence;
+        }
+        double binary_decode_ns = elapsed_ms(start) * 1e6 / iterations;
+
+        // The binary message still has to become a RouterDeclaration for the lsdb
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            decode_wire_declaration(buffer, sizeof(buffer), decoded);
+            checksum += from_wire_declaration(decoded).link_cost;
+        }
+        double binary_to_declaration_ns = elapsed_ms(start) * 1e6 / iterations;
+
+        std::cout << "format\tbytes\tencode_ns\tdecode_ns" << std::endl;
+        std::cout << "text\t" << text.size() << "\t" << text_encode_ns << "\t" << text_decode_ns << std::endl;
+        std::cout << "binary\t" << WIRE_DECLARATION_SIZE << "\t" << binary_encode_ns << "\t" << binary_decode_ns
+                  << " (" << binary_to_declaration_ns << " with RouterDeclaration)" << std::endl;
+        std::cout << "(checksum " << checksum % 10 << ")" << std::endl;
+    }
+
+    return 0;
+}
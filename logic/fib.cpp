@@ -0,0 +1,107 @@
+#include <string>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include "fib.h"
+
+std::string format_next_hops(const std::vector<NextHop>& next_hops)
+{
+    std::string res;
+    for (const NextHop& next_hop : next_hops)
+    {
+        if (!res.empty())
+        {
+            res += ",";
+        }
+        res += next_hop.address;
+        if (next_hop.weight != 1)
+        {
+            res += "*" + std::to_string(next_hop.weight);
+        }
+    }
+    return res;
+}
+
+std::vector<NextHop> parse_next_hops(const std::string& next_hops)
+{
+    std::vector<NextHop> res;
+    size_t start = 0;
+    while (start < next_hops.size())
+    {
+        size_t end = next_hops.find(',', start);
+        if (end == std::string::npos)
+        {
+            end = next_hops.size();
+        }
+        std::string item = next_hops.substr(start, end - start);
+        NextHop next_hop;
+        size_t star = item.find('*');
+        next_hop.address = item.substr(0, star);
+        if (star != std::string::npos)
+        {
+            next_hop.weight = std::min(MAX_NEXT_HOP_WEIGHT, std::max(1, atoi(item.c_str() + star + 1)));
+        }
+        if (!next_hop.address.empty())
+        {
+            res.push_back(next_hop);
+        }
+        start = end + 1;
+    }
+    return res;
+}
+
+// The address is one of the next hops of the route
+bool uses_next_hop(const std::string& next_hops, const std::string& address)
+{
+    for (const NextHop& next_hop : parse_next_hops(next_hops))
+    {
+        if (next_hop.address == address)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+RouteTable routes_to_table(const std::vector<std::pair<std::string, std::string>>& computed_routes)
+{
+    RouteTable table;
+    for (const auto& [next_hop, destination] : computed_routes)
+    {
+        table[destination] = next_hop;
+    }
+    return table;
+}
+
+// Both tables are sorted by destination so one merge pass is enough
+FibDelta compute_fib_delta(const RouteTable& installed, const RouteTable& desired)
+{
+    FibDelta delta;
+    auto installed_it = installed.begin();
+    auto desired_it = desired.begin();
+
+    while (installed_it != installed.end() || desired_it != desired.end())
+    {
+        if (desired_it == desired.end() || (installed_it != installed.end() && installed_it->first < desired_it->first))
+        {
+            delta.deleted.push_back(*installed_it);
+            ++installed_it;
+        }
+        else if (installed_it == installed.end() || desired_it->first < installed_it->first)
+        {
+            delta.added.push_back(*desired_it);
+            ++desired_it;
+        }
+        else
+        {
+            if (installed_it->second != desired_it->second)
+            {
+                delta.replaced.push_back(*desired_it);
+            }
+            ++installed_it;
+            ++desired_it;
+        }
+    }
+    return delta;
+}
@@ -0,0 +1,38 @@
+#ifndef FIB_H
+#define FIB_H
+
+#include <string>
+#include <map>
+#include <vector>
+
+// Routes keyed by destination prefix ("10.0.3.0/24") -> next hop ip
+typedef std::map<std::string, std::string> RouteTable;
+
+// What has to change in the kernel so that the installed routes become the desired ones
+struct FibDelta {
+    std::vector<std::pair<std::string, std::string>> added; // (destination, next hop) not installed yet
+    std::vector<std::pair<std::string, std::string>> replaced; // (destination, new next hop) installed with another next hop
+    std::vector<std::pair<std::string, std::string>> deleted; // (destination, old next hop) not wanted anymore
+
+    size_t size() const { return added.size() + replaced.size() + deleted.size(); }
+};
+
+// With equal cost multipath the next hop of a route is a list "10.0.1.2,10.0.2.3", sorted by address,
+// and "*weight" follows an address whose weight is not 1 ("10.0.1.2*10,10.0.2.3"). The tables and the
+// delta compare the whole string, so a route is replaced as soon as one of its next hops changes
+struct NextHop {
+    std::string address;
+    int weight = 1; // 1 to MAX_NEXT_HOP_WEIGHT, share of the flows sent to this next hop
+};
+
+const int MAX_NEXT_HOP_WEIGHT = 256; // What the kernel can hold (rtnh_hops + 1)
+
+std::string format_next_hops(const std::vector<NextHop>& next_hops);
+std::vector<NextHop> parse_next_hops(const std::string& next_hops);
+bool uses_next_hop(const std::string& next_hops, const std::string& address);
+
+// compute_all_routes gives (next hop, destination) pairs
+RouteTable routes_to_table(const std::vector<std::pair<std::string, std::string>>& computed_routes);
+FibDelta compute_fib_delta(const RouteTable& installed, const RouteTable& desired);
+
+#endif // FIB_H
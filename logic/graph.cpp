@@ -0,0 +1,266 @@
+#include <iostream>
+#include <string>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <tuple>
+#include <unordered_map>
+#include "graph.h"
+
+// One link of the graph before being put in the CSR arrays
+struct GraphLink {
+    int router; // Node id of the router
+    int subnet; // Node id of the subnet
+    int cost;
+    uint32_t address; // Router ip on this subnet
+    uint32_t capacity_mbps;
+};
+
+// Fill node_ids and the CSR arrays once node_names and router_count are set
+static void fill_graph_edges(TopologyGraph& graph, const std::vector<GraphLink>& graph_links)
+{
+    graph.node_ids.reserve(graph.node_names.size());
+    for (size_t i = 0; i < graph.node_names.size(); ++i)
+    {
+        graph.node_ids[graph.node_names[i]] = i;
+    }
+
+    // Not oriented graph so each link is stored in both directions
+    struct Edge {
+        int from;
+        int to;
+        int cost;
+        uint32_t address;
+        uint32_t capacity_mbps;
+    };
+    std::vector<Edge> edges;
+    edges.reserve(graph_links.size() * 2);
+    for (const GraphLink& link : graph_links)
+    {
+        edges.push_back({link.router, link.subnet, link.cost, link.address, link.capacity_mbps});
+        edges.push_back({link.subnet, link.router, link.cost, link.address, link.capacity_mbps});
+    }
+
+    // Stable sort so that for a duplicated link the last declaration wins, like in the matrix
+    std::stable_sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) {
+        return std::tie(a.from, a.to) < std::tie(b.from, b.to);
+    });
+
+    int n = graph.node_names.size();
+    graph.offsets.assign(n + 1, 0);
+    graph.targets.reserve(edges.size());
+    graph.weights.reserve(edges.size());
+    graph.addresses.reserve(edges.size());
+    graph.capacities.reserve(edges.size());
+
+    for (size_t i = 0; i < edges.size(); ++i)
+    {
+        bool last_of_pair = (i + 1 == edges.size() ||
+                             edges[i + 1].from != edges[i].from ||
+                             edges[i + 1].to != edges[i].to);
+        if (!last_of_pair) continue;
+
+        graph.targets.push_back(edges[i].to);
+        graph.weights.push_back(edges[i].cost);
+        graph.addresses.push_back(edges[i].address);
+        graph.capacities.push_back(edges[i].capacity_mbps);
+        graph.offsets[edges[i].from + 1]++;
+    }
+
+    for (int u = 0; u < n; ++u)
+    {
+        graph.offsets[u + 1] += graph.offsets[u];
+    }
+}
+
+TopologyGraph build_topology_graph(const std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb)
+{
+    TopologyGraph graph;
+
+    // One entry per declaration, the ip is only parsed once here
+    struct RawLink {
+        int router;
+        std::string subnet;
+        int cost;
+        uint32_t address;
+        uint32_t capacity_mbps;
+    };
+    std::vector<RawLink> raw_links;
+    std::vector<std::string> subnets;
+
+    for (const auto& router_entry : local_lsdb)
+    {
+        int router_id = graph.node_names.size();
+        graph.node_names.push_back(router_entry.first); // std::map keys are already sorted
+
+        for (const auto& declaration_entry : router_entry.second)
+        {
+            uint32_t address;
+            uint8_t prefix_len;
+            if (!parse_ip_with_mask(declaration_entry.second.ip_with_mask, address, prefix_len))
+            {
+                std::cerr << "Warning: Could not get network address for "
+                          << declaration_entry.second.ip_with_mask << std::endl;
+                continue;
+            }
+
+            uint32_t mask = (prefix_len == 0) ? 0 : (0xFFFFFFFF << (32 - prefix_len));
+            std::string network_address = uint_to_ip(address & mask) + "/" + std::to_string(prefix_len);
+            raw_links.push_back({router_id, network_address, declaration_entry.second.link_cost, address, declaration_entry.second.capacity_mbps});
+            subnets.push_back(network_address);
+        }
+    }
+    graph.router_count = graph.node_names.size();
+
+    std::sort(subnets.begin(), subnets.end());
+    subnets.erase(std::unique(subnets.begin(), subnets.end()), subnets.end());
+    graph.node_names.insert(graph.node_names.end(), subnets.begin(), subnets.end());
+
+    std::vector<GraphLink> graph_links;
+    graph_links.reserve(raw_links.size());
+    for (const RawLink& link : raw_links)
+    {
+        int subnet_id = graph.router_count + (std::lower_bound(subnets.begin(), subnets.end(), link.subnet) - subnets.begin());
+        graph_links.push_back({link.router, subnet_id, link.cost, link.address, link.capacity_mbps});
+    }
+
+    fill_graph_edges(graph, graph_links);
+    return graph;
+}
+
+TopologyGraph build_topology_graph(const LinkStateStore& local_lsdb)
+{
+    TopologyGraph graph;
+
+    // Routers sorted by name, like the std::map version, so both graphs give the same routes
+    std::vector<uint32_t> router_ids = local_lsdb.get_router_ids();
+    std::vector<int> router_node(local_lsdb.interned_router_count(), -1);
+    for (uint32_t router_id : router_ids)
+    {
+        router_node[router_id] = graph.node_names.size();
+        graph.node_names.push_back(local_lsdb.router_name(router_id));
+    }
+    graph.router_count = graph.node_names.size();
+
+    // Prefixes are already parsed, only the unique subnets are turned into strings
+    const std::vector<PackedLink>& links = local_lsdb.get_links();
+    std::unordered_map<uint64_t, int> subnet_slot; // (network, mask) -> position in subnets
+    std::vector<std::pair<std::string, int>> subnets; // (network address, slot)
+    std::vector<int> link_slot(links.size());
+
+    for (size_t i = 0; i < links.size(); ++i)
+    {
+        uint64_t key = ((uint64_t)links[i].network() << 8) | links[i].prefix_len;
+        auto it = subnet_slot.find(key);
+        if (it == subnet_slot.end())
+        {
+            int slot = subnets.size();
+            subnet_slot[key] = slot;
+            subnets.emplace_back(uint_to_ip(links[i].network()) + "/" + std::to_string(links[i].prefix_len), slot);
+            link_slot[i] = slot;
+        }
+        else
+        {
+            link_slot[i] = it->second;
+        }
+    }
+
+    std::sort(subnets.begin(), subnets.end());
+    std::vector<int> slot_node(subnets.size());
+    for (const auto& [network_address, slot] : subnets)
+    {
+        slot_node[slot] = graph.node_names.size();
+        graph.node_names.push_back(network_address);
+    }
+
+    std::vector<GraphLink> graph_links;
+    graph_links.reserve(links.size());
+    for (size_t i = 0; i < links.size(); ++i)
+    {
+        graph_links.push_back({router_node[links[i].router_id], slot_node[link_slot[i]], links[i].link_cost, links[i].address, links[i].capacity_mbps});
+    }
+
+    fill_graph_edges(graph, graph_links);
+    return graph;
+}
+
+int find_node(const TopologyGraph& graph, const std::string& name)
+{
+    auto it = graph.node_ids.find(name);
+    if (it == graph.node_ids.end())
+    {
+        return -1;
+    }
+    return it->second;
+}
+
+std::vector<int> get_neighbor_nodes(const TopologyGraph& graph, int node)
+{
+    if (node < 0 || node + 1 >= (int)graph.offsets.size())
+    {
+        return {};
+    }
+    return std::vector<int>(graph.targets.begin() + graph.offsets[node], graph.targets.begin() + graph.offsets[node + 1]);
+}
+
+// Position of the edge from -> to in the CSR arrays, -1 if there's no link
+int find_edge(const TopologyGraph& graph, int from, int to)
+{
+    if (from < 0 || from + 1 >= (int)graph.offsets.size())
+    {
+        return -1;
+    }
+    auto first = graph.targets.begin() + graph.offsets[from];
+    auto last = graph.targets.begin() + graph.offsets[from + 1];
+    auto it = std::lower_bound(first, last, to); // Targets are sorted for each node
+    if (it == last || *it != to)
+    {
+        return -1;
+    }
+    return it - graph.targets.begin();
+}
+
+// Union of two sorted address lists, only the max_paths lowest are kept
+void merge_first_hops(std::vector<uint32_t>& into, const std::vector<uint32_t>& from, size_t max_paths)
+{
+    std::vector<uint32_t> merged;
+    std::set_union(into.begin(), into.end(), from.begin(), from.end(), std::back_inserter(merged));
+    if (merged.size() > max_paths)
+    {
+        merged.resize(max_paths);
+    }
+    into.swap(merged);
+}
+
+// dijkstraNextHop on the CSR graph : (transit subnet, next router) to reach target from start
+std::pair<int, int> csrNextHop(const TopologyGraph& graph, SpfWorkspace& workspace, int start, int target)
+{
+    csrShortestPathTree(graph, start, workspace, target);
+    return nextHopFromTree(workspace.parent, start, target);
+}
+
+size_t topology_graph_memory(const TopologyGraph& graph)
+{
+    size_t bytes = sizeof(graph);
+    bytes += graph.offsets.capacity() * sizeof(int);
+    bytes += graph.targets.capacity() * sizeof(int);
+    bytes += graph.weights.capacity() * sizeof(int);
+    bytes += graph.addresses.capacity() * sizeof(uint32_t);
+    bytes += graph.capacities.capacity() * sizeof(uint32_t);
+    // Names are also kept by the matrix version (all_nodes) so we only count the index
+    bytes += graph.node_ids.bucket_count() * sizeof(void*);
+    bytes += graph.node_ids.size() * (sizeof(std::pair<const std::string, int>) + sizeof(void*));
+    return bytes;
+}
+
+size_t adjacency_matrix_memory(const std::vector<std::vector<int>>& matrix)
+{
+    size_t bytes = sizeof(matrix);
+    for (const auto& row : matrix)
+    {
+        bytes += sizeof(row) + row.capacity() * sizeof(int);
+    }
+    return bytes;
+}
@@ -0,0 +1,147 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <string>
+#include <map>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+#include "logic.h" // For RouterDeclaration
+#include "lsdb_store.h" // For LinkStateStore
+
+// Sparse (CSR) version of the adjacency matrix built from the lsdb
+// Node ids use the same layout as get_all_nodes : routers first then subnets, both sorted
+struct TopologyGraph {
+    std::vector<std::string> node_names; // Id -> router name or network address
+    std::unordered_map<std::string, int> node_ids; // Router name or network address -> id
+    int router_count = 0; // Ids [0, router_count) are routers, the others are subnets
+    std::vector<int> offsets; // Edges of node u are in [offsets[u], offsets[u + 1])
+    std::vector<int> targets; // Neighbor node of each edge, sorted for each node
+    std::vector<int> weights; // Link cost of each edge
+    std::vector<uint32_t> addresses; // Ip of the router end of each edge (the next hop when going to it)
+    std::vector<uint32_t> capacities; // Advertised capacity of each edge in Mbit/s, 0 if unknown
+};
+
+// How the SPF extends a path by one edge, paths are compared with operator < and == of Cost.
+// The plain int cost adds the link costs, the other metrics specialize it (see metric.h)
+template <typename Cost> struct PathCost;
+
+template <> struct PathCost<int> {
+    static int zero() { return 0; }
+    static int infinity() { return std::numeric_limits<int>::max(); }
+    static int extend(int cost, int weight, uint32_t /*capacity_mbps*/) { return cost + weight; }
+};
+
+// Buffers reused between two SPF runs to avoid reallocating them each time
+template <typename Cost>
+struct BasicSpfWorkspace {
+    std::vector<Cost> dist;
+    std::vector<int> parent;
+    std::vector<char> visited;
+    std::vector<std::pair<Cost, int>> heap; // (distance, node) min-heap
+    std::vector<int> order; // Nodes in the order they were settled
+};
+typedef BasicSpfWorkspace<int> SpfWorkspace;
+
+TopologyGraph build_topology_graph(const std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb);
+TopologyGraph build_topology_graph(const LinkStateStore& local_lsdb);
+int find_node(const TopologyGraph& graph, const std::string& name);
+std::vector<int> get_neighbor_nodes(const TopologyGraph& graph, int node);
+int find_edge(const TopologyGraph& graph, int from, int to);
+void merge_first_hops(std::vector<uint32_t>& into, const std::vector<uint32_t>& from, size_t max_paths);
+std::pair<int, int> csrNextHop(const TopologyGraph& graph, SpfWorkspace& workspace, int start, int target);
+size_t topology_graph_memory(const TopologyGraph& graph);
+size_t adjacency_matrix_memory(const std::vector<std::vector<int>>& matrix);
+
+// Same algorithm as dijkstraShortestPathTree but only the real edges are scanned
+// If target is not -1 we stop as soon as it is reached (like dijkstraNextHop)
+template <typename Cost>
+void csrShortestPathTree(const TopologyGraph& graph, int start, BasicSpfWorkspace<Cost>& workspace, int target = -1)
+{
+    const Cost INF = PathCost<Cost>::infinity();
+    int n = graph.node_names.size();
+
+    workspace.dist.assign(n, INF);
+    workspace.parent.assign(n, -1);
+    workspace.visited.assign(n, 0);
+    workspace.heap.clear();
+    workspace.order.clear();
+
+    if (start < 0 || start >= n) return;
+
+    std::vector<Cost>& dist = workspace.dist;
+    std::vector<int>& parent = workspace.parent;
+    std::vector<std::pair<Cost, int>>& heap = workspace.heap;
+
+    dist[start] = PathCost<Cost>::zero();
+    heap.emplace_back(dist[start], start);
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+        int u = heap.back().second;
+        heap.pop_back();
+
+        if (workspace.visited[u]) continue;
+        workspace.visited[u] = 1;
+        workspace.order.push_back(u);
+
+        if (u == target) break;
+
+        for (int e = graph.offsets[u]; e < graph.offsets[u + 1]; ++e) {
+            int v = graph.targets[e];
+            if (workspace.visited[v]) continue;
+            Cost candidate = PathCost<Cost>::extend(dist[u], graph.weights[e], graph.capacities[e]);
+            if (candidate < dist[v]) {
+                dist[v] = candidate;
+                parent[v] = u;
+                heap.emplace_back(candidate, v);
+                std::push_heap(heap.begin(), heap.end(), std::greater<>());
+            }
+        }
+    }
+}
+
+// First hop addresses of every node over all the equal cost paths from start, at most max_paths of them
+// (the lowest ones), from the full tree csrShortestPathTree left in workspace. Empty for start,
+// the unreachable nodes and the subnets directly connected to start
+template <typename Cost>
+std::vector<std::vector<uint32_t>> csrFirstHops(const TopologyGraph& graph, const BasicSpfWorkspace<Cost>& workspace, int start, size_t max_paths)
+{
+    const Cost INF = PathCost<Cost>::infinity();
+    const std::vector<Cost>& dist = workspace.dist;
+    std::vector<std::vector<uint32_t>> hops(graph.node_names.size());
+    std::vector<char> direct(graph.node_names.size(), 0); // Subnet of start
+
+    // In settle order every predecessor on a shortest path is done before the node
+    for (int v : workspace.order)
+    {
+        if (v == start) continue;
+        for (int e = graph.offsets[v]; e < graph.offsets[v + 1]; ++e)
+        {
+            int u = graph.targets[e];
+            if (dist[u] == INF || !(PathCost<Cost>::extend(dist[u], graph.weights[e], graph.capacities[e]) == dist[v])) continue;
+
+            if (u == start)
+            {
+                direct[v] = 1; // Our own subnet, no route even if a router is as close
+                hops[v].clear();
+                break;
+            }
+            if (direct[u])
+            {
+                merge_first_hops(hops[v], {graph.addresses[e]}, max_paths); // Router v itself, on our subnet u
+            }
+            else
+            {
+                merge_first_hops(hops[v], hops[u], max_paths);
+            }
+        }
+    }
+    return hops;
+}
+
+#endif // GRAPH_H
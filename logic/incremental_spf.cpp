@@ -0,0 +1,686 @@
+#include <string>
+#include <vector>
+#include <queue>
+#include <limits>
+#include <functional>
+#include <algorithm>
+#include "incremental_spf.h"
+#include "graph.h" // For merge_first_hops
+#include "fib.h" // For format_next_hops
+
+static const int INF = std::numeric_limits<int>::max();
+
+// Min-heap of (distance, node), old entries are skipped when their distance is not the current one
+typedef std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<std::pair<int, int>>> DistanceHeap;
+
+int IncrementalSpf::get_router_node(uint32_t router_id, const LinkStateStore& local_lsdb)
+{
+    if (router_id >= router_nodes.size())
+    {
+        router_nodes.resize(router_id + 1, -1);
+    }
+    if (router_nodes[router_id] >= 0)
+    {
+        return router_nodes[router_id];
+    }
+
+    int node = names.size();
+    router_nodes[router_id] = node;
+    names.push_back(local_lsdb.router_name(router_id));
+    is_subnet.push_back(0);
+    adjacency.emplace_back();
+    dist.push_back(INF);
+    parent.push_back(-1);
+    first_child.push_back(-1);
+    next_sibling.push_back(-1);
+    prev_sibling.push_back(-1);
+    mark.push_back(0);
+    return node;
+}
+
+int IncrementalSpf::get_subnet_node(uint32_t network, uint8_t prefix_len)
+{
+    uint64_t key = ((uint64_t)network << 8) | prefix_len;
+    auto it = subnet_nodes.find(key);
+    if (it != subnet_nodes.end())
+    {
+        return it->second;
+    }
+
+    int node = names.size();
+    subnet_nodes[key] = node;
+    names.push_back(uint_to_ip(network) + "/" + std::to_string(prefix_len));
+    is_subnet.push_back(1);
+    adjacency.emplace_back();
+    dist.push_back(INF);
+    parent.push_back(-1);
+    first_child.push_back(-1);
+    next_sibling.push_back(-1);
+    prev_sibling.push_back(-1);
+    mark.push_back(0);
+    return node;
+}
+
+// Graph node order : routers first then subnets, both sorted by name
+bool IncrementalSpf::node_before(int a, int b) const
+{
+    if (is_subnet[a] != is_subnet[b])
+    {
+        return is_subnet[a] < is_subnet[b];
+    }
+    return names[a] < names[b];
+}
+
+// Candidate gives the same distance as the current parent, keep the one Dijkstra would have settled first
+bool IncrementalSpf::better_parent(int candidate, int node) const
+{
+    int current = parent[node];
+    if (current < 0)
+    {
+        return true;
+    }
+    if (dist[candidate] != dist[current])
+    {
+        return dist[candidate] < dist[current];
+    }
+    return node_before(candidate, current);
+}
+
+void IncrementalSpf::set_parent(int node, int new_parent)
+{
+    int old_parent = parent[node];
+    if (old_parent == new_parent)
+    {
+        return;
+    }
+
+    // Out of the children of the old parent
+    if (prev_sibling[node] >= 0)
+    {
+        next_sibling[prev_sibling[node]] = next_sibling[node];
+    }
+    else if (old_parent >= 0)
+    {
+        first_child[old_parent] = next_sibling[node];
+    }
+    if (next_sibling[node] >= 0)
+    {
+        prev_sibling[next_sibling[node]] = prev_sibling[node];
+    }
+
+    // In front of the children of the new one
+    parent[node] = new_parent;
+    prev_sibling[node] = -1;
+    next_sibling[node] = -1;
+    if (new_parent >= 0)
+    {
+        next_sibling[node] = first_child[new_parent];
+        if (first_child[new_parent] >= 0)
+        {
+            prev_sibling[first_child[new_parent]] = node;
+        }
+        first_child[new_parent] = node;
+    }
+}
+
+void IncrementalSpf::rebuild(const LinkStateStore& local_lsdb, int root_router_id)
+{
+    adjacency.clear();
+    names.clear();
+    is_subnet.clear();
+    router_nodes.clear();
+    subnet_nodes.clear();
+    dist.clear();
+    parent.clear();
+    first_child.clear();
+    next_sibling.clear();
+    prev_sibling.clear();
+    mark.clear();
+    zero_cost_links = 0;
+
+    for (const PackedLink& link : local_lsdb.get_links())
+    {
+        int router = get_router_node(link.router_id, local_lsdb);
+        int subnet = get_subnet_node(link.network(), link.prefix_len);
+        adjacency[router].push_back({subnet, link.link_cost, link.address});
+        adjacency[subnet].push_back({router, link.link_cost, link.address});
+        zero_cost_links += (link.link_cost == 0) ? 1 : 0;
+    }
+    root = get_router_node(root_router_id, local_lsdb);
+    full_run();
+}
+
+// Settles the nodes in the order of csrShortestPathTree, the parent of a node is the first one settled
+// that gives its distance, so it is always settled before it (even through a link of cost 0)
+void IncrementalSpf::full_run()
+{
+    size_t n = names.size();
+    dist.assign(n, INF);
+    parent.assign(n, -1);
+    first_child.assign(n, -1);
+    next_sibling.assign(n, -1);
+    prev_sibling.assign(n, -1);
+    settle_order.clear();
+    std::vector<char> settled(n, 0);
+
+    auto later = [this](const std::pair<int, int>& a, const std::pair<int, int>& b) {
+        return a.first != b.first ? a.first > b.first : node_before(b.second, a.second);
+    };
+    std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, decltype(later)> heap(later);
+    dist[root] = 0;
+    heap.push({0, root});
+    while (!heap.empty())
+    {
+        auto [d, x] = heap.top();
+        heap.pop();
+        if (settled[x]) continue;
+        settled[x] = 1;
+        settle_order.push_back(x);
+
+        for (const Edge& edge : adjacency[x])
+        {
+            if (settled[edge.to]) continue;
+            int candidate = d + edge.cost;
+            if (candidate < dist[edge.to])
+            {
+                dist[edge.to] = candidate;
+                set_parent(edge.to, x);
+                heap.push({candidate, edge.to});
+            }
+        }
+    }
+    last_affected_nodes = n;
+}
+
+// New link or lower cost : only the nodes that get closer move, from the link outwards
+void IncrementalSpf::spread_decrease(int from, int to, int cost)
+{
+    DistanceHeap heap;
+    for (auto [a, b] : {std::make_pair(from, to), std::make_pair(to, from)})
+    {
+        if (dist[a] == INF || b == root) continue;
+        int candidate = dist[a] + cost;
+        if (candidate < dist[b])
+        {
+            dist[b] = candidate;
+            set_parent(b, a);
+            heap.push({candidate, b});
+            last_affected_nodes++;
+        }
+        else if (candidate == dist[b] && better_parent(a, b))
+        {
+            set_parent(b, a);
+            last_affected_nodes++;
+        }
+    }
+
+    while (!heap.empty())
+    {
+        auto [d, x] = heap.top();
+        heap.pop();
+        if (d != dist[x]) continue;
+
+        for (const Edge& edge : adjacency[x])
+        {
+            if (edge.to == root) continue;
+            int candidate = d + edge.cost;
+            if (candidate < dist[edge.to])
+            {
+                dist[edge.to] = candidate;
+                set_parent(edge.to, x);
+                heap.push({candidate, edge.to});
+                last_affected_nodes++;
+            }
+            else if (candidate == dist[edge.to] && better_parent(x, edge.to))
+            {
+                set_parent(edge.to, x);
+                last_affected_nodes++;
+            }
+        }
+    }
+}
+
+// Removed link or higher cost on the tree : everything under it has to find its way again,
+// first from the nodes around the subtree then inside it. False if the subtree is too big for that
+bool IncrementalSpf::repair_subtree(int top)
+{
+    std::vector<int> subtree;
+    mark_stamp++;
+    subtree.push_back(top);
+    mark[top] = mark_stamp;
+    for (size_t i = 0; i < subtree.size(); ++i)
+    {
+        for (int child = first_child[subtree[i]]; child >= 0; child = next_sibling[child])
+        {
+            mark[child] = mark_stamp;
+            subtree.push_back(child);
+        }
+    }
+    if (subtree.size() * 4 > names.size())
+    {
+        return false; // A full run is about the same work
+    }
+    last_affected_nodes += subtree.size();
+
+    set_parent(top, -1);
+    for (int node : subtree)
+    {
+        dist[node] = INF;
+        parent[node] = -1;
+        first_child[node] = -1;
+        next_sibling[node] = -1;
+        prev_sibling[node] = -1;
+    }
+
+    DistanceHeap heap;
+    for (int node : subtree)
+    {
+        for (const Edge& edge : adjacency[node])
+        {
+            if (mark[edge.to] == mark_stamp || dist[edge.to] == INF) continue;
+            int candidate = dist[edge.to] + edge.cost;
+            if (candidate < dist[node] || (candidate == dist[node] && better_parent(edge.to, node)))
+            {
+                dist[node] = candidate;
+                set_parent(node, edge.to);
+            }
+        }
+        if (dist[node] != INF)
+        {
+            heap.push({dist[node], node});
+        }
+    }
+
+    while (!heap.empty())
+    {
+        auto [d, x] = heap.top();
+        heap.pop();
+        if (d != dist[x]) continue;
+
+        for (const Edge& edge : adjacency[x])
+        {
+            if (mark[edge.to] != mark_stamp) continue; // The nodes outside the subtree can't get closer
+            int candidate = d + edge.cost;
+            if (candidate < dist[edge.to])
+            {
+                dist[edge.to] = candidate;
+                set_parent(edge.to, x);
+                heap.push({candidate, edge.to});
+            }
+            else if (candidate == dist[edge.to] && better_parent(x, edge.to))
+            {
+                set_parent(edge.to, x);
+            }
+        }
+    }
+    return true;
+}
+
+// A change is on a stub subnet when every link of the subnet is from the router of the change,
+// fills partial_subnets with them
+bool IncrementalSpf::only_stub_changes(const std::vector<TopologyChange>& changes, const LinkStateStore& local_lsdb)
+{
+    partial_subnets.clear();
+    std::unordered_map<int, int> subnet_router;
+    for (const TopologyChange& change : changes)
+    {
+        uint32_t mask = (change.prefix_len == 0) ? 0 : (0xFFFFFFFF << (32 - change.prefix_len));
+        int router = get_router_node(change.router_id, local_lsdb);
+        int subnet = get_subnet_node(change.address & mask, change.prefix_len);
+
+        auto [it, inserted] = subnet_router.insert({subnet, router});
+        if (!inserted)
+        {
+            if (it->second != router) return false; // Two routers in the same run
+            continue;
+        }
+        for (const Edge& edge : adjacency[subnet])
+        {
+            if (edge.to != router) return false;
+        }
+        partial_subnets.push_back(subnet);
+    }
+    return true;
+}
+
+// Nothing can be under a stub subnet, it only hangs under its router with the cheapest of its links
+void IncrementalSpf::attach_stub(int subnet)
+{
+    int best_parent = -1;
+    int best = INF;
+    for (const Edge& edge : adjacency[subnet])
+    {
+        if (dist[edge.to] != INF && dist[edge.to] + edge.cost < best)
+        {
+            best = dist[edge.to] + edge.cost;
+            best_parent = edge.to;
+        }
+    }
+    dist[subnet] = best;
+    set_parent(subnet, best_parent);
+}
+
+bool IncrementalSpf::apply_change(const TopologyChange& change, const LinkStateStore& local_lsdb, bool repair)
+{
+    uint32_t mask = (change.prefix_len == 0) ? 0 : (0xFFFFFFFF << (32 - change.prefix_len));
+    int router = get_router_node(change.router_id, local_lsdb);
+    int subnet = get_subnet_node(change.address & mask, change.prefix_len);
+
+    // One link of the store is one edge in each direction, found by its address
+    auto find = [this](int from, int to, uint32_t address) {
+        std::vector<Edge>& edges = adjacency[from];
+        for (size_t i = 0; i < edges.size(); ++i)
+        {
+            if (edges[i].to == to && edges[i].address == address) return (int)i;
+        }
+        return -1;
+    };
+    int router_edge = find(router, subnet, change.address);
+    int subnet_edge = find(subnet, router, change.address);
+
+    int old_cost = (router_edge >= 0) ? adjacency[router][router_edge].cost : INF;
+    int new_cost = (change.link_cost == LINK_COST_WITHDRAWN) ? INF : change.link_cost;
+    if (old_cost == 0) zero_cost_links--;
+    if (new_cost == 0) zero_cost_links++;
+    if (new_cost == INF && router_edge >= 0)
+    {
+        adjacency[router][router_edge] = adjacency[router].back();
+        adjacency[router].pop_back();
+        adjacency[subnet][subnet_edge] = adjacency[subnet].back();
+        adjacency[subnet].pop_back();
+    }
+    else if (new_cost != INF && router_edge >= 0)
+    {
+        adjacency[router][router_edge].cost = new_cost;
+        adjacency[subnet][subnet_edge].cost = new_cost;
+    }
+    else if (new_cost != INF)
+    {
+        adjacency[router].push_back({subnet, new_cost, change.address});
+        adjacency[subnet].push_back({router, new_cost, change.address});
+    }
+
+    if (!repair || new_cost == old_cost)
+    {
+        return true;
+    }
+    if (new_cost < old_cost)
+    {
+        spread_decrease(router, subnet, new_cost);
+        return true;
+    }
+
+    // Higher cost : nothing moves unless the link is on the tree
+    if (parent[subnet] == router)
+    {
+        return repair_subtree(subnet);
+    }
+    if (parent[router] == subnet)
+    {
+        return repair_subtree(router);
+    }
+    return true;
+}
+
+bool IncrementalSpf::update(const LinkStateStore& local_lsdb, const std::string& actual_router)
+{
+    last_partial = false;
+    int root_router_id = local_lsdb.find_router(actual_router);
+    if (root_router_id < 0 || local_lsdb.router_link_count(root_router_id) == 0)
+    {
+        built = false; // Not in the lsdb yet, no routes
+        root = -1;
+        return false;
+    }
+
+    std::vector<TopologyChange> changes;
+    if (!built || actual_router != root_name ||
+        !local_lsdb.get_topology_changes_since(applied_sequence, changes) || changes.size() > MAX_CHANGES)
+    {
+        rebuild(local_lsdb, root_router_id);
+        built = true;
+        root_name = actual_router;
+        applied_sequence = local_lsdb.get_topology_sequence();
+        last_changes = 0;
+        full_runs++;
+        return false;
+    }
+
+    last_changes = changes.size();
+    last_affected_nodes = 0;
+    bool zero_cost = zero_cost_links > 0 || std::any_of(changes.begin(), changes.end(), [](const TopologyChange& change) {
+        return change.link_cost == 0;
+    });
+    if (zero_cost)
+    {
+        // The repairs keep the closest parent at equal distance, which a link of cost 0 can turn into a loop
+        for (const TopologyChange& change : changes)
+        {
+            apply_change(change, local_lsdb, false);
+        }
+        applied_sequence = local_lsdb.get_topology_sequence();
+        full_run();
+        full_runs++;
+        return false;
+    }
+    if (only_stub_changes(changes, local_lsdb))
+    {
+        for (const TopologyChange& change : changes)
+        {
+            apply_change(change, local_lsdb, false);
+        }
+        for (int subnet : partial_subnets)
+        {
+            attach_stub(subnet);
+        }
+        applied_sequence = local_lsdb.get_topology_sequence();
+        last_affected_nodes = partial_subnets.size();
+        last_partial = true;
+        partial_runs++;
+        incremental_runs++;
+        return true;
+    }
+
+    bool repaired = true;
+    for (const TopologyChange& change : changes)
+    {
+        // Once a full run is needed the other changes only update the links
+        repaired = apply_change(change, local_lsdb, repaired) && repaired;
+    }
+    applied_sequence = local_lsdb.get_topology_sequence();
+
+    if (!repaired)
+    {
+        full_run();
+        full_runs++;
+        return false;
+    }
+    incremental_runs++;
+    return true;
+}
+
+// Ip of the router on the subnet, the cheapest link if it has several addresses there
+uint32_t IncrementalSpf::edge_address(int subnet, int router) const
+{
+    uint32_t address = 0;
+    int best_cost = INF;
+    for (const Edge& edge : adjacency[router])
+    {
+        if (edge.to == subnet && edge.cost < best_cost)
+        {
+            best_cost = edge.cost;
+            address = edge.address;
+        }
+    }
+    return address;
+}
+
+int64_t IncrementalSpf::next_hop_of(int node) const
+{
+    while (true)
+    {
+        int up = (node == root) ? -1 : parent[node];
+        if (up < 0 || up == root)
+        {
+            return -1;
+        }
+        if (parent[up] == root)
+        {
+            return edge_address(up, node);
+        }
+        node = up;
+    }
+}
+
+std::vector<std::vector<uint32_t>> IncrementalSpf::first_hops(const std::vector<int>& nodes, size_t max_paths) const
+{
+    std::vector<std::vector<uint32_t>> hops(names.size());
+    std::vector<char> direct(names.size(), 0);
+    for (int v : nodes)
+    {
+        if (v == root) continue;
+        for (const Edge& edge : adjacency[v])
+        {
+            int u = edge.to;
+            if (dist[u] == INF || dist[u] + edge.cost != dist[v]) continue;
+
+            if (u == root)
+            {
+                direct[v] = 1;
+                hops[v].clear();
+                break;
+            }
+            if (direct[u])
+            {
+                merge_first_hops(hops[v], {edge.address}, max_paths);
+            }
+            else
+            {
+                merge_first_hops(hops[v], hops[u], max_paths);
+            }
+        }
+    }
+    return hops;
+}
+
+static std::string format_first_hops(const std::vector<uint32_t>& addresses)
+{
+    std::vector<NextHop> next_hops;
+    for (uint32_t address : addresses)
+    {
+        next_hops.push_back({uint_to_ip(address), 1});
+    }
+    return format_next_hops(next_hops);
+}
+
+std::vector<PrefixRoute> IncrementalSpf::partial_routes(size_t max_paths) const
+{
+    std::vector<PrefixRoute> res;
+    if (!last_partial)
+    {
+        return res;
+    }
+    for (int subnet : partial_subnets)
+    {
+        if (max_paths > 1)
+        {
+            // Only the nodes above the subnet on its shortest paths
+            std::vector<int> nodes;
+            std::vector<char> seen(names.size(), 0);
+            nodes.push_back(subnet);
+            seen[subnet] = 1;
+            for (size_t i = 0; i < nodes.size(); ++i)
+            {
+                int v = nodes[i];
+                if (v == root || dist[v] == INF) continue;
+                for (const Edge& edge : adjacency[v])
+                {
+                    if (!seen[edge.to] && dist[edge.to] != INF && dist[edge.to] + edge.cost == dist[v])
+                    {
+                        seen[edge.to] = 1;
+                        nodes.push_back(edge.to);
+                    }
+                }
+            }
+            std::sort(nodes.begin(), nodes.end(), [this](int a, int b) { return dist[a] < dist[b]; });
+            res.push_back({names[subnet], format_first_hops(first_hops(nodes, max_paths)[subnet])});
+            continue;
+        }
+
+        int64_t next_hop = (root < 0) ? -1 : next_hop_of(subnet);
+        res.push_back({names[subnet], next_hop >= 0 ? uint_to_ip((uint32_t)next_hop) : ""});
+    }
+    return res;
+}
+
+std::vector<std::pair<std::string, std::string>> IncrementalSpf::routes(size_t max_paths) const
+{
+    std::vector<std::pair<std::string, std::string>> res;
+    if (root < 0)
+    {
+        return res;
+    }
+
+    if (max_paths > 1)
+    {
+        // With a link of cost 0 the distance alone can put a node before its predecessor, the tree is then
+        // from a full run and its settle order has them first like csrFirstHops
+        std::vector<int> nodes = settle_order;
+        if (zero_cost_links == 0)
+        {
+            nodes.clear();
+            for (size_t node = 0; node < names.size(); ++node)
+            {
+                if (dist[node] != INF) nodes.push_back(node);
+            }
+            std::sort(nodes.begin(), nodes.end(), [this](int a, int b) { return dist[a] < dist[b]; });
+        }
+        std::vector<std::vector<uint32_t>> hops = first_hops(nodes, max_paths);
+        for (size_t subnet = 0; subnet < names.size(); ++subnet)
+        {
+            if (is_subnet[subnet] && !hops[subnet].empty())
+            {
+                res.push_back({format_first_hops(hops[subnet]), names[subnet]});
+            }
+        }
+        return res;
+    }
+
+    // Next hop of every node, filled from the top of the tree : -1 for none (unreachable or directly connected)
+    const int64_t UNKNOWN = -2;
+    std::vector<int64_t> next_hop(names.size(), UNKNOWN);
+    std::vector<int> path;
+    for (size_t subnet = 0; subnet < names.size(); ++subnet)
+    {
+        if (!is_subnet[subnet]) continue;
+
+        int node = subnet;
+        path.clear();
+        while (next_hop[node] == UNKNOWN)
+        {
+            int up = (node == root) ? -1 : parent[node];
+            if (up < 0 || up == root)
+            {
+                next_hop[node] = -1; // Root, unreachable or one of our own subnets
+                break;
+            }
+            if (parent[up] == root)
+            {
+                next_hop[node] = edge_address(up, node); // First router after our subnet
+                break;
+            }
+            path.push_back(node);
+            node = up;
+        }
+        for (int below : path)
+        {
+            next_hop[below] = next_hop[node];
+        }
+
+        if (next_hop[subnet] >= 0)
+        {
+            res.push_back({uint_to_ip((uint32_t)next_hop[subnet]), names[subnet]});
+        }
+    }
+    return res;
+}
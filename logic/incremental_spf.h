@@ -0,0 +1,94 @@
+#ifndef INCREMENTAL_SPF_H
+#define INCREMENTAL_SPF_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+#include "lsdb_store.h" // For LinkStateStore and TopologyChange
+
+// Route of one prefix after a partial run, next_hop is empty when the prefix has no route anymore
+struct PrefixRoute {
+    std::string destination;
+    std::string next_hop;
+};
+
+// Shortest-path tree kept between two SPF runs, repaired from the topology log of the store
+// instead of rebuilding the graph and running Dijkstra on everything :
+//  - a new link or a lower cost only spreads the nodes that get closer
+//  - a removed link or a higher cost on the tree only recomputes the subtree under it
+// Same graph as build_topology_graph (routers and subnets) and same routes as compute_all_routes :
+// among equal cost paths the parent is the closest node, then routers before subnets, then by name,
+// which is the order csrShortestPathTree settles the nodes in. A link of cost 0 can put a node under another
+// one at the same distance, so while there is one every update is a full run that settles like csrShortestPathTree
+// When every change is on a stub subnet (a single router attached) the run is partial : the tree
+// doesn't move, the subnet hangs under its router and only its own route has to be updated
+class IncrementalSpf {
+public:
+    // Bring the tree up to date with the store, returns true if it was repaired and false if it was computed again
+    bool update(const LinkStateStore& local_lsdb, const std::string& actual_router);
+    // Same pairs as compute_all_routes : (next hop ip, destination subnet), not in the same order
+    std::vector<std::pair<std::string, std::string>> routes(size_t max_paths = 1) const;
+    // After a partial run : the route of each prefix it touched, the others are the same as before
+    std::vector<PrefixRoute> partial_routes(size_t max_paths = 1) const;
+
+    size_t full_runs = 0;
+    size_t incremental_runs = 0;
+    size_t partial_runs = 0; // Counted in incremental_runs too
+    bool last_partial = false;
+    size_t last_changes = 0; // Topology changes applied by the last update
+    size_t last_affected_nodes = 0; // Nodes whose distance or parent moved during the last update
+
+    static const size_t MAX_CHANGES = 256; // More changes at once and a full run is cheaper
+
+private:
+    struct Edge {
+        int to;
+        int cost;
+        uint32_t address; // Router ip on the subnet
+    };
+
+    int get_router_node(uint32_t router_id, const LinkStateStore& local_lsdb);
+    int get_subnet_node(uint32_t network, uint8_t prefix_len);
+    bool node_before(int a, int b) const; // Tie break between two nodes at the same distance
+    bool better_parent(int candidate, int node) const;
+    void set_parent(int node, int new_parent);
+    void rebuild(const LinkStateStore& local_lsdb, int root_router_id);
+    void full_run();
+    // Updates the links, and the tree when repair is set. False if the tree needs a full run
+    bool apply_change(const TopologyChange& change, const LinkStateStore& local_lsdb, bool repair);
+    void spread_decrease(int from, int to, int cost);
+    bool repair_subtree(int top);
+    bool only_stub_changes(const std::vector<TopologyChange>& changes, const LinkStateStore& local_lsdb);
+    void attach_stub(int subnet);
+    int64_t next_hop_of(int node) const; // Next hop ip to reach the node, -1 for none
+    // Same as csrFirstHops for the given nodes, sorted by distance and with all their predecessors
+    std::vector<std::vector<uint32_t>> first_hops(const std::vector<int>& nodes, size_t max_paths) const;
+    uint32_t edge_address(int subnet, int router) const;
+
+    std::vector<std::vector<Edge>> adjacency;
+    std::vector<std::string> names; // Router name or network address, like the graph node names
+    std::vector<char> is_subnet;
+    std::vector<int> router_nodes; // Store router id -> node, -1 if not seen yet
+    std::unordered_map<uint64_t, int> subnet_nodes; // (network, mask) -> node
+
+    // The tree, with the children kept as linked lists to find a subtree without scanning everything
+    std::vector<int> dist;
+    std::vector<int> parent;
+    std::vector<int> first_child;
+    std::vector<int> next_sibling;
+    std::vector<int> prev_sibling;
+    std::vector<uint32_t> mark; // Stamp of the last subtree a node was part of
+    uint32_t mark_stamp = 0;
+    std::vector<int> partial_subnets; // Subnets touched by the last partial run
+    std::vector<int> settle_order; // Of the last full run, predecessors first even at the same distance
+    size_t zero_cost_links = 0;
+
+    int root = -1;
+    std::string root_name;
+    uint64_t applied_sequence = 0;
+    bool built = false;
+};
+
+#endif // INCREMENTAL_SPF_H
@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <cmath>
+#include "link_load.h"
+
+LinkLoad::LinkLoad(const LoadCostConfig& config)
+    : config(config)
+{
+    this->config.bands = std::max(1, config.bands);
+    this->config.ewma_percent = std::min(100, std::max(1, config.ewma_percent));
+}
+
+bool LinkLoad::sample(uint64_t rx_bytes, uint64_t tx_bytes, long long now_ms, uint64_t nominal_mbps)
+{
+    bool counters_reset = has_counters && (rx_bytes < last_rx_bytes || tx_bytes < last_tx_bytes);
+    if (!has_counters || counters_reset || now_ms <= last_sample_ms)
+    {
+        // First sample, or the interface was created again : only a new starting point
+        has_counters = true;
+        last_rx_bytes = rx_bytes;
+        last_tx_bytes = tx_bytes;
+        last_sample_ms = now_ms;
+        return false;
+    }
+
+    double bytes = std::max(rx_bytes - last_rx_bytes, tx_bytes - last_tx_bytes);
+    double elapsed_s = (now_ms - last_sample_ms) / 1000.0;
+    last_rx_bytes = rx_bytes;
+    last_tx_bytes = tx_bytes;
+    last_sample_ms = now_ms;
+
+    double utilization = 0;
+    if (nominal_mbps > 0)
+    {
+        utilization = std::min(1.0, bytes * 8 / elapsed_s / (nominal_mbps * 1e6));
+    }
+    double alpha = config.ewma_percent / 100.0;
+    ewma = alpha * utilization + (1 - alpha) * ewma;
+
+    int wanted = wanted_band();
+    if (wanted == current_band)
+    {
+        return false;
+    }
+    if (last_change_ms >= 0 && now_ms - last_change_ms < config.hold_ms)
+    {
+        held_changes++; // Taken at a later sample if the load stays there
+        return false;
+    }
+    current_band = wanted;
+    last_change_ms = now_ms;
+    band_changes++;
+    return true;
+}
+
+// Band of the average, only left when the load is hysteresis_percent past one of its edges
+int LinkLoad::wanted_band() const
+{
+    double width = 1.0 / config.bands;
+    double margin = config.hysteresis_percent / 100.0;
+    int up = (int)std::floor((ewma - margin) / width);
+    int down = (int)std::floor((ewma + margin) / width);
+    int band = current_band;
+    if (up > current_band)
+    {
+        band = up;
+    }
+    else if (down < current_band)
+    {
+        band = down;
+    }
+    return std::min(config.bands - 1, std::max(0, band));
+}
@@ -0,0 +1,48 @@
+#ifndef LINK_LOAD_H
+#define LINK_LOAD_H
+
+#include <cstdint>
+#include <cstddef>
+
+// How the measured load of a link turns into the cost we advertise for it
+struct LoadCostConfig {
+    int ewma_percent = 30; // Weight of the newest sample in the average
+    int bands = 4; // Utilization is cut in this many bands, 0-25 %, 25-50 %... with 4
+    int hysteresis_percent = 5; // The load must go this far past a band edge before the band changes
+    int band_cost = 10; // Added to the link cost for each band above the first
+    long long hold_ms = 10000; // Min time between two cost changes of one link
+};
+
+// Smoothed utilization of one link from its byte counters, sampled periodically.
+// The advertised cost only follows the band the utilization is in, with hysteresis around
+// the band edges and a hold time between changes, so small fluctuations and flapping
+// loads don't make the whole network compute its routes again
+class LinkLoad {
+public:
+    explicit LinkLoad(const LoadCostConfig& config = LoadCostConfig());
+
+    // Counters of the interface at now_ms (monotonic), nominal_mbps is what the link can carry (0 = unknown).
+    // Returns true when the band, so the advertised cost, changed
+    bool sample(uint64_t rx_bytes, uint64_t tx_bytes, long long now_ms, uint64_t nominal_mbps);
+
+    double utilization() const { return ewma; } // 0 to 1, the busiest direction
+    int band() const { return current_band; }
+    int extra_cost() const { return current_band * config.band_cost; }
+
+    size_t band_changes = 0;
+    size_t held_changes = 0; // Samples whose band change waited for the hold time
+
+private:
+    int wanted_band() const;
+
+    LoadCostConfig config;
+    bool has_counters = false;
+    uint64_t last_rx_bytes = 0;
+    uint64_t last_tx_bytes = 0;
+    long long last_sample_ms = 0;
+    double ewma = 0;
+    int current_band = 0;
+    long long last_change_ms = -1;
+};
+
+#endif // LINK_LOAD_H
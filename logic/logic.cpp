@@ -12,22 +12,10 @@
 #include <bits/stdc++.h>
 #include <queue>
 #include <limits>
-
-
-// Defining routerDecllaration struc
-struct RouterDeclaration {
-    std::string router_name; // Name of the router
-    std::string ip_with_mask; // IP address with subnet mask
-    int link_cost; // Cost of the link to this router
-    long long timestamp; // Timestamp of the declaration
-
-    bool operator==(const RouterDeclaration& other) const 
-    {
-        return (router_name == other.router_name &&
-                ip_with_mask == other.ip_with_mask &&
-                link_cost == other.link_cost); // Timestamp is not included in the comparison, as it is expected to change with each declaration
-    }
-};
+#include "logic.h"
+#include "graph.h"
+#include "fib.h" // For format_next_hops
+#include "metric.h"
 
 bool isValidRouterName(const std::string& router_name) 
 {
@@ -257,12 +245,22 @@ RouterDeclaration create_router_definition(std::string router_name, std::string
     return routerDeclaration;
 }
 
+bool is_valid_link_cost(int link_cost)
+{
+    return link_cost >= 0 || link_cost == LINK_COST_WITHDRAWN;
+}
+
 // Corrected serialize_router_definition
 std::string serialize_router_definition(const RouterDeclaration& router_declaration)
 {
     std::string definition;
     definition += "{1," + router_declaration.router_name + "," + router_declaration.ip_with_mask + "," +
-                  std::to_string(router_declaration.link_cost) + "," + std::to_string(router_declaration.timestamp) + "}";
+                  std::to_string(router_declaration.link_cost) + "," + std::to_string(router_declaration.timestamp);
+    if (router_declaration.capacity_mbps != 0)
+    {
+        definition += "," + std::to_string(router_declaration.capacity_mbps); // Older routers only read 5 segments
+    }
+    definition += "}";
     return definition;
 }
 
@@ -271,7 +269,7 @@ RouterDeclaration deserialize_router_definition(const std::string& definition)
 {
     RouterDeclaration declaration;
 
-    // Example definition: {1,R123,10.0.1.1/24,5,1700000000000}
+    // Example definition: {1,R123,10.0.1.1/24,5,1700000000000}, the capacity in Mbit/s can follow: {1,R123,10.0.1.1/24,5,1700000000000,1000}
 
     // Assert expression is not empty and starts with '{' and ends with '}'
     if(definition.empty() || definition.front() != '{' || definition.back() != '}')
@@ -291,9 +289,9 @@ RouterDeclaration deserialize_router_definition(const std::string& definition)
         segments.push_back(segment);
     }
 
-    if(segments.size() != 5) 
+    if(segments.size() != 5 && segments.size() != 6) 
     {
-        throw std::invalid_argument("Invalid router definition format. Expected 5 segments.");
+        throw std::invalid_argument("Invalid router definition format. Expected 5 or 6 segments.");
     }
 
     // Convert each segment to the appropriate type and fill the declaration struct
@@ -307,7 +305,20 @@ RouterDeclaration deserialize_router_definition(const std::string& definition)
         declaration.router_name = segments[1]; // Router name
         declaration.ip_with_mask = segments[2]; // IP with mask
         declaration.link_cost = std::stoi(segments[3]); // Link cost
+        if (!is_valid_link_cost(declaration.link_cost))
+        {
+            throw std::invalid_argument("Invalid router definition format. Negative link cost.");
+        }
         declaration.timestamp = std::stoll(segments[4]); // Timestamp
+        if (segments.size() == 6)
+        {
+            long long capacity = std::stoll(segments[5]); // Capacity in Mbit/s
+            if (capacity < 0 || capacity > UINT32_MAX)
+            {
+                throw std::out_of_range("capacity");
+            }
+            declaration.capacity_mbps = capacity;
+        }
     }
     catch (const std::invalid_argument& e) 
     {
@@ -562,6 +573,58 @@ std::string get_network_address(const std::string& ip_with_mask)
     return network_ip_str + "/" + mask_bits_str;
 }
 
+// Parse "x.x.x.x/m" in one pass without any stringstream or exception
+// Accepts the same strings as assert_ip_and_mask, returns false for the others
+bool parse_ip_with_mask(const std::string& ip_with_mask, uint32_t& address, uint8_t& prefix_len)
+{
+    uint32_t ip_int = 0;
+    size_t pos = 0;
+    size_t length = ip_with_mask.length();
+
+    for (int i = 0; i < 4; ++i)
+    {
+        int octet = 0;
+        size_t digits = 0;
+        while (pos < length && ::isdigit(ip_with_mask[pos]))
+        {
+            octet = octet * 10 + (ip_with_mask[pos] - '0');
+            pos++;
+            digits++;
+        }
+        if (digits == 0 || digits > 3 || octet > 255)
+        {
+            return false;
+        }
+        ip_int = (ip_int << 8) | octet;
+
+        // 3 dots then the slash
+        char expected = (i < 3) ? '.' : '/';
+        if (pos >= length || ip_with_mask[pos] != expected)
+        {
+            return false;
+        }
+        pos++;
+    }
+
+    int mask_bits = 0;
+    size_t mask_digits = 0;
+    while (pos < length && ::isdigit(ip_with_mask[pos]))
+    {
+        mask_bits = mask_bits * 10 + (ip_with_mask[pos] - '0');
+        pos++;
+        mask_digits++;
+        if (mask_bits > 32) return false; // Also avoid overflow on long masks
+    }
+    if (mask_digits == 0 || pos != length)
+    {
+        return false;
+    }
+
+    address = ip_int;
+    prefix_len = mask_bits;
+    return true;
+}
+
 std::vector<std::string> get_all_subnets(std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb)
 {
     std::set<std::string> unique_subnets; // This ensure that subnet is only added one time
@@ -748,6 +811,65 @@ std::pair<int, int> dijkstraNextHop(const std::vector<std::vector<int>>& adjMatr
         return std::make_pair(-1, -1);; // start == target
 }
 
+// Run Dijkstra only once from start and keep the whole shortest-path tree
+// dist[v] is the cost to reach v (INF if unreachable) and parent[v] the previous node on the path
+void dijkstraShortestPathTree(const std::vector<std::vector<int>>& adjMatrix, int start,
+                              std::vector<int>& dist, std::vector<int>& parent)
+{
+    int n = adjMatrix.size();
+    dist.assign(n, INF);
+    parent.assign(n, -1);
+    std::vector<bool> visited(n, false);
+
+    std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<>> pq;
+
+    dist[start] = 0;
+    pq.emplace(0, start);
+
+    while (!pq.empty()) {
+        auto [currentDist, u] = pq.top();
+        pq.pop();
+
+        if (visited[u]) continue;
+        visited[u] = true;
+
+        // Same relaxation as dijkstraNextHop so both give the same tree, but we don't stop on a target
+        for (int v = 0; v < n; ++v) {
+            int weight = adjMatrix[u][v];
+            if (weight != -1 && !visited[v]) {
+                if (dist[u] + weight < dist[v]) {
+                    dist[v] = dist[u] + weight;
+                    parent[v] = u;
+                    pq.emplace(dist[v], v);
+                }
+            }
+        }
+    }
+}
+
+// Read the (transit subnet, next router) pair for target from a tree built by dijkstraShortestPathTree
+// Same result as dijkstraNextHop(adjMatrix, start, target) but without running Dijkstra again
+std::pair<int, int> nextHopFromTree(const std::vector<int>& parent, int start, int target)
+{
+    if (target < 0 || target >= (int)parent.size() || target == start || parent[target] == -1)
+        return std::make_pair(-1, -1); // Unreachable or start == target
+
+    // Walk back up to the two nodes right after start
+    int second = target;
+    int first = parent[target];
+    while (first != start && parent[first] != start) {
+        second = first;
+        first = parent[first];
+        if (first == -1) return std::make_pair(-1, -1);
+    }
+
+    // If first is start, target is directly connected to start (path has only 2 nodes)
+    if (first == start)
+        return std::make_pair(-1, -1);
+
+    return std::make_pair(first, second);
+}
+
 // Used at the end diskstra because only subnets are used so information is losts
 std::string get_router_ip_on_network(std::string& router_name, std::string& network_address, std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb)
 {
@@ -773,7 +895,100 @@ std::string get_router_ip_on_network(std::string& router_name, std::string& netw
 }
 
 
+// Compute the next hop to every subnet with a single shortest-path tree from actual_router
+// With max_paths > 1 every equal cost path is kept and the next hop is a list (see fib.h)
+// Cost is the path cost the SPF compares (see PathCost in graph.h)
+template <typename Cost>
+static std::vector<std::pair<std::string, std::string>> compute_routes_on_graph(const std::string& actual_router, const TopologyGraph& graph, size_t max_paths = 1)
+{
+    std::vector<std::pair<std::string, std::string>> res;
+
+    int routeur_id = find_node(graph, actual_router);
+    if (routeur_id < 0 || routeur_id >= graph.router_count)
+    {
+        return res; // This router is not in the lsdb yet
+    }
+
+    static BasicSpfWorkspace<Cost> workspace; // Kept between calls so dist/parent/visited are not reallocated each tick
+    csrShortestPathTree(graph, routeur_id, workspace);
+
+    if (max_paths > 1)
+    {
+        std::vector<std::vector<uint32_t>> first_hops = csrFirstHops(graph, workspace, routeur_id, max_paths);
+        for (int subnet_id = graph.router_count; subnet_id < (int)graph.node_names.size(); ++subnet_id)
+        {
+            if (first_hops[subnet_id].empty())
+            {
+                continue; // Directly connected or unreachable
+            }
+            std::vector<NextHop> next_hops;
+            for (uint32_t address : first_hops[subnet_id])
+            {
+                next_hops.push_back({uint_to_ip(address), 1});
+            }
+            std::string next_router_ips = format_next_hops(next_hops);
+            std::cout << "To reach : " << graph.node_names[subnet_id] << " use " << next_router_ips << std::endl;
+            res.push_back({next_router_ips, graph.node_names[subnet_id]});
+        }
+        return res;
+    }
+
+    // Subnets are right after the routers
+    for(int subnet_id = graph.router_count; subnet_id < (int)graph.node_names.size(); ++subnet_id)
+    {
+        const std::string& destination_subnet = graph.node_names[subnet_id];
+
+        std::pair<int, int> dijkstra_res = nextHopFromTree(workspace.parent, routeur_id, subnet_id);
+
+        if(dijkstra_res.first != -1)
+        {
+            // The edge transit subnet -> next router holds the ip of the router on this subnet
+            int edge = find_edge(graph, dijkstra_res.first, dijkstra_res.second);
+            std::string next_router_ip = uint_to_ip(graph.addresses[edge]);
+
+            std::cout << "To reach : " << destination_subnet << " use " << next_router_ip << std::endl;            
+            res.push_back({next_router_ip, destination_subnet});
+
+        }
+        else
+        {
+            std::cout << "To reach : " << destination_subnet << " it's directly connected ! " << std::endl; 
+        }        
+    }
+
+    return res;
+}
+
 std::vector<std::pair<std::string, std::string>> compute_all_routes(std::string actual_router, std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb)
+{
+    return compute_routes_on_graph<int>(actual_router, build_topology_graph(local_lsdb));
+}
+
+std::vector<std::pair<std::string, std::string>> compute_all_routes(std::string actual_router, const LinkStateStore& local_lsdb, size_t max_paths)
+{
+    return compute_routes_on_graph<int>(actual_router, build_topology_graph(local_lsdb), max_paths);
+}
+
+std::vector<std::pair<std::string, std::string>> compute_all_routes(std::string actual_router, const LinkStateStore& local_lsdb, size_t max_paths, const MetricConfig& metric)
+{
+    TopologyGraph graph = build_topology_graph(local_lsdb);
+    if (metric.mode == METRIC_HOPS_CAPACITY)
+    {
+        return compute_routes_on_graph<HopCapacityCost>(actual_router, graph, max_paths);
+    }
+    if (metric.mode == METRIC_WEIGHTED)
+    {
+        // The advertised costs are replaced, the graph is only used for this run
+        for (size_t e = 0; e < graph.weights.size(); ++e)
+        {
+            graph.weights[e] = weighted_link_cost(graph.capacities[e], metric);
+        }
+    }
+    return compute_routes_on_graph<int>(actual_router, graph, max_paths);
+}
+
+// Old way: one Dijkstra per subnet, kept to compare with compute_all_routes (see benchmark.cpp)
+std::vector<std::pair<std::string, std::string>> compute_all_routes_per_subnet(std::string actual_router, std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb)
 {
     std::vector<std::string> all_nodes = get_all_nodes(local_lsdb);
     std::vector<std::string> all_subnets = get_all_subnets(local_lsdb);
@@ -784,6 +999,10 @@ std::vector<std::pair<std::string, std::string>> compute_all_routes(std::string
     build_matrix_from_lsbd(matrix, local_lsdb, all_nodes);
 
     auto it_1 = std::find(all_nodes.begin(), all_nodes.end(), actual_router);
+    if (it_1 == all_nodes.end())
+    {
+        return res; // This router is not in the lsdb yet
+    }
     int routeur_id = std::distance(all_nodes.begin(), it_1);
 
     
@@ -817,28 +1036,22 @@ std::vector<std::pair<std::string, std::string>> compute_all_routes(std::string
     return res;
 }
 
-std::string display_neighbor_routers(const std::string& actual_router_name,
-                                     const std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb) {
+static std::string display_neighbor_routers_on_graph(const std::string& actual_router_name, const TopologyGraph& graph) {
     
     std::stringstream ss; // Create the string stream
 
     ss << "\n--- Router neightbors '" << actual_router_name << "' ---" << std::endl;
 
-    // Get all the subnets connecter to this routeur
-    std::set<std::string> actual_router_connected_subnets;
-    auto it_actual_router_lsas = local_lsdb.find(actual_router_name);
+    int actual_router_id = find_node(graph, actual_router_name);
 
-    if (it_actual_router_lsas == local_lsdb.end()) {
+    if (actual_router_id < 0 || actual_router_id >= graph.router_count) {
         ss << "This router '" << actual_router_name << "' doesn't exists in lsdb !!!!" << std::endl;
         ss << "------------------------------------------" << std::endl;
         return ss.str(); // Quick return to avoid bugs
     }
 
-    // Iterate all router definition to extract subnets
-    for (const auto& ip_decl_pair : it_actual_router_lsas->second) {
-        const RouterDeclaration& declaration = ip_decl_pair.second;
-        actual_router_connected_subnets.insert(get_network_address(declaration.ip_with_mask));
-    }
+    // Neighbors of a router are the subnets it is connected to
+    std::vector<int> actual_router_connected_subnets = get_neighbor_nodes(graph, actual_router_id);
 
     if (actual_router_connected_subnets.empty()) {
         ss << "This router '" << actual_router_name << "' isn't connected to any subnets !." << std::endl;
@@ -846,26 +1059,14 @@ std::string display_neighbor_routers(const std::string& actual_router_name,
         return ss.str(); // This is the end
     }
 
-    // Iterate all other routeurs to see if they have common subnets
-    std::set<std::string> neighbor_routers; // Using it to avoid duplicates
+    // And the neighbors of those subnets are the routers sharing at least one subnet with us
+    std::set<std::string> neighbor_routers; // Using it to avoid duplicates (and keep them sorted)
 
-    for (const auto& router_entry : local_lsdb) {
-        const std::string& current_lsdb_router_name = router_entry.first;
-
-        // Avoiding the to test itself !
-        if (current_lsdb_router_name == actual_router_name) {
-            continue;
-        }
-
-        // Iterate informations 
-        for (const auto& ip_decl_pair : router_entry.second) {
-            const RouterDeclaration& declaration = ip_decl_pair.second;
-            std::string declared_network_address = get_network_address(declaration.ip_with_mask);
-
-            // test if they have at leat one subnet in common
-            if (actual_router_connected_subnets.count(declared_network_address)) {
-                neighbor_routers.insert(current_lsdb_router_name);
-                break; // No need to test more for this router
+    for (int subnet_id : actual_router_connected_subnets) {
+        for (int router_id : get_neighbor_nodes(graph, subnet_id)) {
+            // Avoiding the to test itself !
+            if (router_id != actual_router_id) {
+                neighbor_routers.insert(graph.node_names[router_id]);
             }
         }
     }
@@ -882,4 +1083,13 @@ std::string display_neighbor_routers(const std::string& actual_router_name,
     ss << "------------------------------------------" << std::endl;
 
     return ss.str(); // Good case return
+}
+
+std::string display_neighbor_routers(const std::string& actual_router_name,
+                                     const std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb) {
+    return display_neighbor_routers_on_graph(actual_router_name, build_topology_graph(local_lsdb));
+}
+
+std::string display_neighbor_routers(const std::string& actual_router_name, const LinkStateStore& local_lsdb) {
+    return display_neighbor_routers_on_graph(actual_router_name, build_topology_graph(local_lsdb));
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <cstdint>
 
 // Defining routerDecllaration struc
 struct RouterDeclaration {
@@ -11,6 +12,7 @@ struct RouterDeclaration {
     std::string ip_with_mask; // IP address with subnet mask
     int link_cost; // Cost of the link to this router
     long long timestamp; // Timestamp of the declaration
+    uint32_t capacity_mbps = 0; // Nominal capacity of the link in Mbit/s, 0 if unknown (optional in the formats)
 
     bool operator==(const RouterDeclaration& other) const
     {
@@ -21,6 +23,12 @@ struct RouterDeclaration {
     }
 };
 
+// Link cost of a declaration that removes the link : its router lost the interface (see LinkStateStore)
+const int LINK_COST_WITHDRAWN = -1;
+// Costs a received declaration can have : 0 and up, or LINK_COST_WITHDRAWN. Any other negative cost
+// would give Dijkstra a negative weight
+bool is_valid_link_cost(int link_cost);
+
 bool isValidRouterName(const std::string& router_name);
 bool assert_ip_and_mask(const std::string& ip_with_mask) ;
 RouterDeclaration create_router_definition(std::string router_name, std::string ip_with_mask, int link_cost);
@@ -32,6 +40,8 @@ bool add_router_declaration(std::map<std::string, std::map<std::string, RouterDe
 bool cleanup_old_declarations(std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb, long long threshold_ms);
 void update_lsdb(std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb, const std::string& ROUTER_ID);
 std::string get_network_address(const std::string& ip_with_mask);
+std::string uint_to_ip(uint32_t ip_int);
+bool parse_ip_with_mask(const std::string& ip_with_mask, uint32_t& address, uint8_t& prefix_len);
 std::vector<std::string> get_all_subnets(std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb);
 std::vector<std::string> get_all_routers(std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb);
 std::vector<std::string> get_all_nodes(std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb);
@@ -40,7 +50,19 @@ std::vector<std::vector<int>> create_n_by_n_matrix(int n);
 void add_router_declaration_to_matrix(RouterDeclaration& declaration, std::vector<std::vector<int>>& matrix, std::vector<std::string>& all_nodes );
 void build_matrix_from_lsbd(std::vector<std::vector<int>>& matrix, std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb, std::vector<std::string>& all_nodes);
 std::pair<int, int> dijkstraNextHop(const std::vector<std::vector<int>>& adjMatrix, int start, int target);
+void dijkstraShortestPathTree(const std::vector<std::vector<int>>& adjMatrix, int start, std::vector<int>& dist, std::vector<int>& parent);
+std::pair<int, int> nextHopFromTree(const std::vector<int>& parent, int start, int target);
 std::string get_router_ip_on_network(std::string& router_name, std::string& network_address, std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb);
 std::vector<std::pair<std::string, std::string>> compute_all_routes(std::string actual_router, std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb);
+std::vector<std::pair<std::string, std::string>> compute_all_routes_per_subnet(std::string actual_router, std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb);
 std::string display_neighbor_routers(const std::string& actual_router_name, const std::map<std::string, std::map<std::string, RouterDeclaration>>& local_lsdb);
+
+// Same functions on the interned lsdb (see lsdb_store.h)
+class LinkStateStore;
+struct MetricConfig;
+// max_paths > 1 keeps the equal cost paths : the next hop is then a list of up to max_paths addresses (see fib.h)
+// The metric says what the paths minimize, the advertised link costs when not given (see metric.h)
+std::vector<std::pair<std::string, std::string>> compute_all_routes(std::string actual_router, const LinkStateStore& local_lsdb, size_t max_paths = 1);
+std::vector<std::pair<std::string, std::string>> compute_all_routes(std::string actual_router, const LinkStateStore& local_lsdb, size_t max_paths, const MetricConfig& metric);
+std::string display_neighbor_routers(const std::string& actual_router_name, const LinkStateStore& local_lsdb);
 #endif // LOGIC_H
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lsdb_checkpoint.h"
+
+static const char CHECKPOINT_MAGIC[8] = {'L', 'S', 'D', 'B', 'C', 'K', 'P', 'T'};
+
+static uint64_t checkpoint_checksum(const uint8_t* data, size_t length)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Failure after path.tmp was created : nothing is left behind
+static bool discard_checkpoint_tmp(int fd, const std::string& tmp_path, const char* what)
+{
+    perror(what);
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    unlink(tmp_path.c_str());
+    return false;
+}
+
+// The rename is only durable once the directory holding the file is on disk too
+static bool sync_parent_directory(const std::string& path)
+{
+    size_t slash = path.rfind('/');
+    std::string directory = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+}
+
+bool save_lsdb_checkpoint(const LinkStateStore& local_lsdb, const std::string& path)
+{
+    const std::vector<PackedLink>& links = local_lsdb.get_links();
+    size_t record_count = 0;
+    for (const PackedLink& link : links)
+    {
+        if (local_lsdb.router_name(link.router_id).size() < sizeof(CheckpointRecord::router_name))
+        {
+            record_count++;
+        }
+    }
+    size_t size = sizeof(CheckpointHeader) + record_count * sizeof(CheckpointRecord);
+
+    std::string tmp_path = path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        perror("open checkpoint");
+        return false;
+    }
+    if (ftruncate(fd, size) < 0)
+    {
+        return discard_checkpoint_tmp(fd, tmp_path, "ftruncate checkpoint");
+    }
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        return discard_checkpoint_tmp(fd, tmp_path, "mmap checkpoint");
+    }
+
+    CheckpointHeader* header = (CheckpointHeader*)mapping;
+    CheckpointRecord* records = (CheckpointRecord*)(header + 1);
+    size_t i = 0;
+    for (const PackedLink& link : links)
+    {
+        const std::string& name = local_lsdb.router_name(link.router_id);
+        if (name.size() >= sizeof(CheckpointRecord::router_name))
+        {
+            continue;
+        }
+        CheckpointRecord& record = records[i++];
+        memset(&record, 0, sizeof(record));
+        memcpy(record.router_name, name.c_str(), name.size());
+        record.address = link.address;
+        record.link_cost = link.link_cost;
+        record.timestamp = link.timestamp;
+        record.prefix_len = link.prefix_len;
+        record.capacity_mbps = link.capacity_mbps;
+    }
+
+    memcpy(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic));
+    header->version = CHECKPOINT_VERSION;
+    header->record_count = record_count;
+    header->checksum = checkpoint_checksum((const uint8_t*)records, record_count * sizeof(CheckpointRecord));
+
+    // The records have to be on disk before the rename, else a power loss can leave an empty file
+    // under the final name. fsync also writes the size set by ftruncate
+    bool synced = msync(mapping, size, MS_SYNC) == 0;
+    munmap(mapping, size);
+    if (!synced || fsync(fd) < 0)
+    {
+        return discard_checkpoint_tmp(fd, tmp_path, "sync checkpoint");
+    }
+    close(fd);
+
+    if (rename(tmp_path.c_str(), path.c_str()) < 0)
+    {
+        return discard_checkpoint_tmp(-1, tmp_path, "rename checkpoint");
+    }
+    if (!sync_parent_directory(path))
+    {
+        perror("sync checkpoint directory"); // The new file is complete, only its name may go back to the old one
+    }
+    return true;
+}
+
+int load_lsdb_checkpoint(LinkStateStore& local_lsdb, const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return -1; // No checkpoint, first start
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0 || (size_t)file_stat.st_size < sizeof(CheckpointHeader))
+    {
+        close(fd);
+        return -1;
+    }
+    size_t size = file_stat.st_size;
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        perror("mmap checkpoint");
+        return -1;
+    }
+
+    const CheckpointHeader* header = (const CheckpointHeader*)mapping;
+    const CheckpointRecord* records = (const CheckpointRecord*)(header + 1);
+    bool valid = memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->version == CHECKPOINT_VERSION &&
+                 size == sizeof(CheckpointHeader) + (size_t)header->record_count * sizeof(CheckpointRecord) &&
+                 header->checksum == checkpoint_checksum((const uint8_t*)records, header->record_count * sizeof(CheckpointRecord));
+    if (!valid)
+    {
+        std::cerr << "Ignoring invalid lsdb checkpoint " << path << std::endl;
+        munmap(mapping, size);
+        return -1;
+    }
+
+    int loaded = 0;
+    for (uint32_t i = 0; i < header->record_count; ++i)
+    {
+        const CheckpointRecord& record = records[i];
+        RouterDeclaration declaration;
+        declaration.router_name = std::string(record.router_name, strnlen(record.router_name, sizeof(record.router_name)));
+        declaration.ip_with_mask = uint_to_ip(record.address) + "/" + std::to_string(record.prefix_len);
+        declaration.link_cost = record.link_cost;
+        declaration.timestamp = record.timestamp;
+        declaration.capacity_mbps = record.capacity_mbps;
+        if (local_lsdb.add_router_declaration(declaration))
+        {
+            loaded++;
+        }
+    }
+    munmap(mapping, size);
+    return loaded;
+}
@@ -0,0 +1,36 @@
+#ifndef LSDB_CHECKPOINT_H
+#define LSDB_CHECKPOINT_H
+
+#include <string>
+#include <cstdint>
+#include "lsdb_store.h"
+
+// Copy of the lsdb on disk so a restarted server doesn't start from an empty database
+// File layout (host byte order, the file never leaves the machine) :
+//  CheckpointHeader then record_count CheckpointRecord
+struct CheckpointHeader {
+    char magic[8]; // "LSDBCKPT"
+    uint32_t version;
+    uint32_t record_count;
+    uint64_t checksum; // FNV-1a of the records
+};
+
+struct CheckpointRecord {
+    char router_name[64]; // Nul terminated, longer names are not saved
+    uint32_t address;
+    int32_t link_cost;
+    int64_t timestamp;
+    uint8_t prefix_len;
+    uint8_t reserved[3];
+    uint32_t capacity_mbps; // Was reserved, 0 (unknown) in the files written before
+};
+
+const uint32_t CHECKPOINT_VERSION = 1;
+
+// Written in path.tmp through a shared mapping, synced to disk then renamed : neither a crash
+// nor a power loss leaves a half written file (at worst the previous checkpoint is found)
+bool save_lsdb_checkpoint(const LinkStateStore& local_lsdb, const std::string& path);
+// Adds the saved declarations to local_lsdb, returns how many or -1 if the file is missing or invalid
+int load_lsdb_checkpoint(LinkStateStore& local_lsdb, const std::string& path);
+
+#endif // LSDB_CHECKPOINT_H
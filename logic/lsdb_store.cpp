@@ -0,0 +1,404 @@
+#include <iostream>
+#include <string>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include "lsdb_store.h"
+
+uint32_t LinkStateStore::intern_router(const std::string& router_name)
+{
+    auto it = router_ids.find(router_name);
+    if (it != router_ids.end())
+    {
+        return it->second;
+    }
+
+    uint32_t router_id = router_names.size();
+    router_names.push_back(router_name);
+    router_ids[router_name] = router_id;
+    links_per_router.push_back(0);
+    return router_id;
+}
+
+int LinkStateStore::find_router(const std::string& router_name) const
+{
+    auto it = router_ids.find(router_name);
+    if (it == router_ids.end())
+    {
+        return -1;
+    }
+    return it->second;
+}
+
+std::vector<uint32_t> LinkStateStore::get_router_ids() const
+{
+    std::vector<uint32_t> ids;
+    for (uint32_t router_id = 0; router_id < router_names.size(); ++router_id)
+    {
+        if (links_per_router[router_id] > 0)
+        {
+            ids.push_back(router_id);
+        }
+    }
+
+    // Same order as the keys of the std::map lsdb
+    std::sort(ids.begin(), ids.end(), [this](uint32_t a, uint32_t b) {
+        return router_names[a] < router_names[b];
+    });
+    return ids;
+}
+
+size_t LinkStateStore::router_link_count(uint32_t router_id) const
+{
+    if (router_id >= links_per_router.size())
+    {
+        return 0;
+    }
+    return links_per_router[router_id];
+}
+
+uint64_t LinkStateStore::link_key(uint32_t router_id, uint32_t address, uint8_t prefix_len)
+{
+    // 26 bits of router id is way more than R0-R999999
+    return ((uint64_t)router_id << 38) | ((uint64_t)prefix_len << 32) | address;
+}
+
+bool LinkStateStore::add_router_declaration(const RouterDeclaration& new_declaration)
+{
+    uint32_t address;
+    uint8_t prefix_len;
+    if (!parse_ip_with_mask(new_declaration.ip_with_mask, address, prefix_len))
+    {
+        std::cerr << "Warning: Ignoring declaration with invalid IP/Mask "
+                  << new_declaration.ip_with_mask << std::endl;
+        return false;
+    }
+
+    uint32_t router_id = intern_router(new_declaration.router_name);
+    uint64_t key = link_key(router_id, address, prefix_len);
+
+    auto withdrawn = withdrawn_links.find(key);
+    if (withdrawn != withdrawn_links.end())
+    {
+        if (new_declaration.timestamp <= withdrawn->second.timestamp)
+        {
+            return false; // Old copy of a withdrawn link
+        }
+        withdrawn_links.erase(withdrawn);
+    }
+
+    if (new_declaration.link_cost == LINK_COST_WITHDRAWN)
+    {
+        auto it = link_index.find(key);
+        if (it != link_index.end())
+        {
+            if (new_declaration.timestamp <= links[it->second].timestamp)
+            {
+                return false; // The link came back after this withdrawal
+            }
+            erase_link(it->second);
+        }
+        // Kept even if the link was unknown here, so it is flooded further and blocks the old copies
+        withdrawn_links[key] = {new_declaration.timestamp, ++change_counter};
+        return true;
+    }
+
+    auto it = link_index.find(key);
+    if (it == link_index.end())
+    {
+        // Case were the link does't exist for this router (or the router is new)
+        link_index[key] = links.size();
+        links.push_back({router_id, address, new_declaration.timestamp, new_declaration.link_cost, prefix_len, false, ++change_counter,
+                         new_declaration.capacity_mbps});
+        links_per_router[router_id]++;
+        log_topology_change(links.back(), new_declaration.link_cost);
+        return true;
+    }
+
+    PackedLink& existing = links[it->second];
+    existing.stale = false; // Even an old copy tells that the link still exists
+    if (new_declaration.timestamp > existing.timestamp)
+    {
+        // Case were the new declaration is newer than the existing one
+        // A new capacity changes the paths of the capacity metrics (see metric.h)
+        if (existing.link_cost != new_declaration.link_cost || existing.capacity_mbps != new_declaration.capacity_mbps)
+        {
+            log_topology_change(existing, new_declaration.link_cost);
+        }
+        existing.timestamp = new_declaration.timestamp;
+        existing.link_cost = new_declaration.link_cost;
+        existing.capacity_mbps = new_declaration.capacity_mbps;
+        existing.change_sequence = ++change_counter;
+        return true;
+    }
+
+    return false; // No update made
+}
+
+// Swap with the last link so the array stays contiguous
+void LinkStateStore::erase_link(size_t index)
+{
+    const PackedLink& removed = links[index];
+    link_index.erase(link_key(removed.router_id, removed.address, removed.prefix_len));
+    links_per_router[removed.router_id]--;
+    log_topology_change(removed, LINK_COST_WITHDRAWN);
+
+    if (index != links.size() - 1)
+    {
+        links[index] = links.back();
+        const PackedLink& moved = links[index];
+        link_index[link_key(moved.router_id, moved.address, moved.prefix_len)] = index;
+    }
+    links.pop_back();
+}
+
+void LinkStateStore::log_topology_change(const PackedLink& link, int32_t link_cost)
+{
+    topology_counter++;
+    if (topology_log.size() >= 2 * MAX_TOPOLOGY_LOG)
+    {
+        topology_log.erase(topology_log.begin(), topology_log.begin() + MAX_TOPOLOGY_LOG);
+    }
+    topology_log.push_back({topology_counter, link.router_id, link.address, link.prefix_len, link_cost});
+}
+
+bool LinkStateStore::get_topology_changes_since(uint64_t sequence, std::vector<TopologyChange>& changes) const
+{
+    changes.clear();
+    if (sequence >= topology_counter)
+    {
+        return true; // Nothing new
+    }
+    if (topology_log.empty() || topology_log.front().sequence > sequence + 1)
+    {
+        return false; // Already dropped from the log
+    }
+
+    auto first = std::upper_bound(topology_log.begin(), topology_log.end(), sequence,
+                                  [](uint64_t value, const TopologyChange& change) { return value < change.sequence; });
+    changes.assign(first, topology_log.end());
+    return true;
+}
+
+bool LinkStateStore::cleanup_old_declarations(long long threshold_ms)
+{
+    bool cleaned = false;
+    long long current_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+
+    size_t i = 0;
+    while (i < links.size())
+    {
+        if (current_time - links[i].timestamp > threshold_ms)
+        {
+            erase_link(i); // The last link is now at i so don't move forward
+            cleaned = true;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    // Older copies of a withdrawn link would be aged out anyway, no need to block them anymore
+    for (auto it = withdrawn_links.begin(); it != withdrawn_links.end();)
+    {
+        if (current_time - it->second.timestamp > threshold_ms)
+        {
+            it = withdrawn_links.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    return cleaned;
+}
+
+void LinkStateStore::refresh_router(const std::string& router_name, long long new_timestamp)
+{
+    int router_id = find_router(router_name);
+    if (router_id < 0)
+    {
+        return;
+    }
+
+    for (PackedLink& link : links)
+    {
+        if (link.router_id == (uint32_t)router_id)
+        {
+            link.timestamp = new_timestamp;
+            link.stale = false;
+            link.change_sequence = ++change_counter;
+        }
+    }
+}
+
+void LinkStateStore::mark_all_stale()
+{
+    for (PackedLink& link : links)
+    {
+        link.stale = true;
+    }
+}
+
+size_t LinkStateStore::stale_link_count() const
+{
+    size_t count = 0;
+    for (const PackedLink& link : links)
+    {
+        if (link.stale)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t LinkStateStore::sweep_stale_links()
+{
+    size_t removed = 0;
+    size_t i = 0;
+    while (i < links.size())
+    {
+        if (links[i].stale)
+        {
+            erase_link(i); // The last link is now at i so don't move forward
+            removed++;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    return removed;
+}
+
+bool LinkStateStore::withdraw_link(const std::string& router_name, uint32_t address, uint8_t prefix_len)
+{
+    int router_id = find_router(router_name);
+    if (router_id < 0)
+    {
+        return false;
+    }
+
+    uint64_t key = link_key(router_id, address, prefix_len);
+    auto it = link_index.find(key);
+    if (it == link_index.end())
+    {
+        return false;
+    }
+
+    // One ms newer than the last copy of the neighbor, so the other routers take it in place of that copy
+    withdrawn_links[key] = {links[it->second].timestamp + 1, ++change_counter};
+    erase_link(it->second);
+    return true;
+}
+
+RouterDeclaration LinkStateStore::to_declaration(const PackedLink& link) const
+{
+    RouterDeclaration declaration;
+    declaration.router_name = router_names[link.router_id];
+    declaration.ip_with_mask = uint_to_ip(link.address) + "/" + std::to_string(link.prefix_len);
+    declaration.link_cost = link.link_cost;
+    declaration.timestamp = link.timestamp;
+    declaration.capacity_mbps = link.capacity_mbps;
+    return declaration;
+}
+
+RouterDeclaration LinkStateStore::to_withdrawal(uint64_t key, const WithdrawnLink& withdrawn) const
+{
+    // Inverse of link_key
+    RouterDeclaration declaration;
+    declaration.router_name = router_names[key >> 38];
+    declaration.ip_with_mask = uint_to_ip((uint32_t)key) + "/" + std::to_string((key >> 32) & 0x3F);
+    declaration.link_cost = LINK_COST_WITHDRAWN;
+    declaration.timestamp = withdrawn.timestamp;
+    return declaration;
+}
+
+std::vector<RouterDeclaration> LinkStateStore::get_declarations_changed_since(uint64_t sequence) const
+{
+    std::vector<RouterDeclaration> declarations;
+    for (const PackedLink& link : links)
+    {
+        if (link.change_sequence > sequence)
+        {
+            declarations.push_back(to_declaration(link));
+        }
+    }
+    for (const auto& [key, withdrawn] : withdrawn_links)
+    {
+        if (withdrawn.change_sequence > sequence)
+        {
+            declarations.push_back(to_withdrawal(key, withdrawn));
+        }
+    }
+    return declarations;
+}
+
+std::vector<RouterDeclaration> LinkStateStore::get_withdrawn_declarations() const
+{
+    std::vector<RouterDeclaration> declarations;
+    for (const auto& [key, withdrawn] : withdrawn_links)
+    {
+        declarations.push_back(to_withdrawal(key, withdrawn));
+    }
+    return declarations;
+}
+
+std::map<std::string, std::map<std::string, RouterDeclaration>> LinkStateStore::to_map() const
+{
+    std::map<std::string, std::map<std::string, RouterDeclaration>> local_lsdb;
+    for (const PackedLink& link : links)
+    {
+        RouterDeclaration declaration = to_declaration(link);
+        local_lsdb[declaration.router_name][declaration.ip_with_mask] = declaration;
+    }
+    return local_lsdb;
+}
+
+size_t LinkStateStore::memory_usage() const
+{
+    size_t bytes = sizeof(*this);
+    bytes += links.capacity() * sizeof(PackedLink);
+    bytes += link_index.bucket_count() * sizeof(void*);
+    bytes += link_index.size() * (sizeof(std::pair<const uint64_t, uint32_t>) + sizeof(void*));
+    bytes += links_per_router.capacity() * sizeof(uint32_t);
+    for (const std::string& name : router_names)
+    {
+        bytes += sizeof(std::string) + (name.capacity() > 15 ? name.capacity() + 1 : 0);
+    }
+    bytes += router_ids.bucket_count() * sizeof(void*);
+    bytes += router_ids.size() * (sizeof(std::pair<const std::string, uint32_t>) + sizeof(void*));
+    return bytes;
+}
+
+void debug_known_router(const LinkStateStore& local_lsdb)
+{
+    // Same output as the std::map version
+    debug_known_router(local_lsdb.to_map());
+}
+
+void update_lsdb(LinkStateStore& local_lsdb, const std::string& ROUTER_ID)
+{
+    // Firstly remove old declarations
+    long long threshold_ms = 30000; // 30 seconds threshold for old declarations
+    bool cleaned = local_lsdb.cleanup_old_declarations(threshold_ms);
+    if(cleaned)
+    {
+        std::cout << "Old declarations cleaned up." << std::endl;
+    }
+    else
+    {
+        std::cout << "No old declarations to clean up." << std::endl;
+    }
+
+    // Then give a new timestamp to this router own declarations
+    long long new_timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+    local_lsdb.refresh_router(ROUTER_ID, new_timestamp);
+}
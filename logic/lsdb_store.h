@@ -0,0 +1,107 @@
+#ifndef LSDB_STORE_H
+#define LSDB_STORE_H
+
+#include <string>
+#include <map>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "logic.h" // For RouterDeclaration
+
+// One declaration of the lsdb without any string (40 bytes instead of a RouterDeclaration + two map nodes)
+struct PackedLink {
+    uint32_t router_id; // Interned router name (see LinkStateStore::router_name)
+    uint32_t address; // Router ip on the subnet, host order
+    int64_t timestamp; // Timestamp of the declaration, used for the age of the link
+    int32_t link_cost; // Cost of the link
+    uint8_t prefix_len; // Subnet mask bits (0-32)
+    bool stale; // Loaded from a checkpoint and not confirmed by a declaration since
+    uint64_t change_sequence; // Value of the store change counter the last time this link was added or updated
+    uint32_t capacity_mbps; // Advertised nominal capacity, 0 if unknown
+
+    uint32_t network() const
+    {
+        uint32_t mask = (prefix_len == 0) ? 0 : (0xFFFFFFFF << (32 - prefix_len));
+        return address & mask;
+    }
+};
+
+// One entry of the topology log, used by the incremental SPF to know what to repair
+struct TopologyChange {
+    uint64_t sequence; // Topology sequence right after this change
+    uint32_t router_id;
+    uint32_t address;
+    uint8_t prefix_len;
+    int32_t link_cost; // New cost, LINK_COST_WITHDRAWN when the link was removed
+};
+
+// Lsdb stored in flat arrays with router names interned into dense ids
+// The string-keyed functions take and give RouterDeclaration like the std::map version
+class LinkStateStore {
+public:
+    // Router names <-> ids, ids are never reused so they stay valid for the whole run
+    uint32_t intern_router(const std::string& router_name);
+    int find_router(const std::string& router_name) const; // -1 if unknown
+    const std::string& router_name(uint32_t router_id) const { return router_names[router_id]; }
+    size_t interned_router_count() const { return router_names.size(); }
+    std::vector<uint32_t> get_router_ids() const; // Routers with at least one link, sorted by name
+
+    // Same behavior as the free functions working on the std::map lsdb
+    bool add_router_declaration(const RouterDeclaration& new_declaration);
+    bool cleanup_old_declarations(long long threshold_ms);
+    void refresh_router(const std::string& router_name, long long new_timestamp);
+
+    // Warm restart : links restored from a checkpoint stay stale until a declaration confirms them,
+    // the ones still stale after the first refresh round are removed by sweep_stale_links
+    void mark_all_stale();
+    size_t stale_link_count() const;
+    size_t sweep_stale_links();
+
+    // A neighbor declared dead by the hellos : its link leaves the store at once, and the copies
+    // other routers still flood are refused until the neighbor sends a newer one
+    // The withdrawal is flooded like any other change (LINK_COST_WITHDRAWN), so the other routers drop the link too
+    bool withdraw_link(const std::string& router_name, uint32_t address, uint8_t prefix_len);
+    std::vector<RouterDeclaration> get_withdrawn_declarations() const; // For the full flood mode
+
+    const std::vector<PackedLink>& get_links() const { return links; }
+    // Every add or update gets the next sequence, so a flooder only has to remember the last one it sent
+    uint64_t get_change_sequence() const { return change_counter; }
+    // Only moves when SPF could give another result : link added or removed, cost changed (not on refreshes)
+    uint64_t get_topology_sequence() const { return topology_counter; }
+    // False when some of the changes after sequence are not in the log anymore, the caller has to start over
+    bool get_topology_changes_since(uint64_t sequence, std::vector<TopologyChange>& changes) const;
+    std::vector<RouterDeclaration> get_declarations_changed_since(uint64_t sequence) const;
+    size_t link_count() const { return links.size(); }
+    size_t router_link_count(uint32_t router_id) const;
+    RouterDeclaration to_declaration(const PackedLink& link) const;
+    std::map<std::string, std::map<std::string, RouterDeclaration>> to_map() const;
+    size_t memory_usage() const;
+
+private:
+    static uint64_t link_key(uint32_t router_id, uint32_t address, uint8_t prefix_len);
+    void erase_link(size_t index);
+    void log_topology_change(const PackedLink& link, int32_t link_cost);
+
+    static const size_t MAX_TOPOLOGY_LOG = 4096; // Half of the log is dropped when it gets twice this size
+
+    std::vector<std::string> router_names; // Id -> name
+    std::unordered_map<std::string, uint32_t> router_ids; // Name -> id
+    std::vector<uint32_t> links_per_router; // Id -> number of links in the store
+
+    std::vector<PackedLink> links; // All the declarations, no particular order
+    std::unordered_map<uint64_t, uint32_t> link_index; // (router, address, mask) -> position in links
+    struct WithdrawnLink {
+        int64_t timestamp; // Older declarations of the link are refused
+        uint64_t change_sequence; // Value of the change counter when the link was withdrawn
+    };
+    RouterDeclaration to_withdrawal(uint64_t key, const WithdrawnLink& withdrawn) const;
+    std::unordered_map<uint64_t, WithdrawnLink> withdrawn_links; // (router, address, mask) -> withdrawn link
+    uint64_t change_counter = 0;
+    uint64_t topology_counter = 0;
+    std::vector<TopologyChange> topology_log; // Sorted by sequence
+};
+
+void debug_known_router(const LinkStateStore& local_lsdb);
+void update_lsdb(LinkStateStore& local_lsdb, const std::string& ROUTER_ID);
+
+#endif // LSDB_STORE_H
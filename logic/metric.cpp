@@ -0,0 +1,42 @@
+#include <string>
+#include "metric.h"
+
+bool parse_metric_mode(const std::string& text, MetricMode& mode)
+{
+    if (text == "cost")
+    {
+        mode = METRIC_COST;
+    }
+    else if (text == "weighted")
+    {
+        mode = METRIC_WEIGHTED;
+    }
+    else if (text == "hops_capacity")
+    {
+        mode = METRIC_HOPS_CAPACITY;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+const char* metric_mode_name(MetricMode mode)
+{
+    switch (mode)
+    {
+        case METRIC_WEIGHTED: return "weighted";
+        case METRIC_HOPS_CAPACITY: return "hops_capacity";
+        default: return "cost";
+    }
+}
+
+int weighted_link_cost(uint32_t capacity_mbps, const MetricConfig& config)
+{
+    const uint64_t MAX_LINK_COST = 65535; // Keeps the sum of a long path far from the int limit
+    uint64_t capacity = capacity_mbps == 0 ? 1 : capacity_mbps;
+    uint64_t cost = (uint64_t)config.hop_weight + (uint64_t)config.capacity_weight * config.reference_mbps / capacity;
+    if (cost < 1) cost = 1; // Dijkstra and the incremental repair expect costs > 0
+    return cost > MAX_LINK_COST ? MAX_LINK_COST : cost;
+}
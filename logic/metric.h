@@ -0,0 +1,60 @@
+#ifndef METRIC_H
+#define METRIC_H
+
+#include <string>
+#include <cstdint>
+#include "graph.h" // For PathCost
+
+// What the SPF minimizes :
+//  - cost : the sum of the advertised link costs (the default, and the only one the incremental SPF knows)
+//  - weighted : each link costs hop_weight + capacity_weight * reference / capacity, so a slow
+//    link counts as several hops. Still a plain sum per link, so Dijkstra stays exact
+//  - hops_capacity : the fewest hops first, then the path with the widest bottleneck
+enum MetricMode {
+    METRIC_COST,
+    METRIC_WEIGHTED,
+    METRIC_HOPS_CAPACITY
+};
+
+struct MetricConfig {
+    MetricMode mode = METRIC_COST;
+    int hop_weight = 10;
+    int capacity_weight = 10;
+    uint32_t reference_mbps = 100000; // A link this fast only costs hop_weight
+};
+
+// "cost", "weighted" or "hops_capacity", false for anything else
+bool parse_metric_mode(const std::string& text, MetricMode& mode);
+const char* metric_mode_name(MetricMode mode);
+
+// Cost of one link in weighted mode, an unknown capacity (0) counts as 1 Mbit/s
+int weighted_link_cost(uint32_t capacity_mbps, const MetricConfig& config);
+
+// Path cost in hops_capacity mode, a smaller value is a better path
+struct HopCapacityCost {
+    uint32_t hops;
+    uint32_t bottleneck_mbps; // Lowest capacity along the path
+
+    bool operator<(const HopCapacityCost& other) const
+    {
+        if (hops != other.hops) return hops < other.hops;
+        return bottleneck_mbps > other.bottleneck_mbps;
+    }
+    bool operator>(const HopCapacityCost& other) const { return other < *this; }
+    bool operator==(const HopCapacityCost& other) const
+    {
+        return hops == other.hops && bottleneck_mbps == other.bottleneck_mbps;
+    }
+};
+
+template <> struct PathCost<HopCapacityCost> {
+    static HopCapacityCost zero() { return {0, UINT32_MAX}; }
+    static HopCapacityCost infinity() { return {UINT32_MAX, 0}; }
+    static HopCapacityCost extend(const HopCapacityCost& cost, int /*weight*/, uint32_t capacity_mbps)
+    {
+        uint32_t capacity = capacity_mbps == 0 ? 1 : capacity_mbps; // Unknown links are the narrowest
+        return {cost.hops + 1, capacity < cost.bottleneck_mbps ? capacity : cost.bottleneck_mbps};
+    }
+};
+
+#endif // METRIC_H
@@ -0,0 +1,65 @@
+#include <string>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include "neighbor_table.h"
+
+bool NeighborTable::on_hello(const WireHello& hello, const std::string& interface_ip, long long now_ms)
+{
+    Neighbor& neighbor = neighbors[{hello.router_name, hello.address}];
+    neighbor.router_name = hello.router_name;
+    neighbor.address = hello.address;
+    neighbor.prefix_len = hello.prefix_len;
+    neighbor.interface_ip = interface_ip;
+    neighbor.dead_interval_ms = hello.dead_interval_ms; // The sender knows how often it talks
+    neighbor.last_hello_ms = now_ms;
+    neighbor.hellos_received++;
+
+    if (neighbor.state == NEIGHBOR_UP)
+    {
+        return false;
+    }
+    neighbor.state = NEIGHBOR_UP;
+    neighbor.up_since_ms = now_ms;
+    return true;
+}
+
+std::vector<Neighbor> NeighborTable::expire(long long now_ms)
+{
+    std::vector<Neighbor> went_down;
+    for (auto& [key, neighbor] : neighbors)
+    {
+        if (neighbor.state != NEIGHBOR_UP)
+        {
+            continue;
+        }
+
+        long long silence_ms = now_ms - neighbor.last_hello_ms;
+        if (silence_ms < (long long)neighbor.dead_interval_ms)
+        {
+            continue;
+        }
+
+        // Kept as down so the cli still shows it, a new hello brings it back
+        neighbor.state = NEIGHBOR_DOWN;
+        stats.downs_detected++;
+        stats.last_detection_ms = silence_ms;
+        stats.max_detection_ms = std::max(stats.max_detection_ms, silence_ms);
+        stats.total_detection_ms += silence_ms;
+        went_down.push_back(neighbor);
+    }
+    return went_down;
+}
+
+size_t NeighborTable::up_count() const
+{
+    size_t count = 0;
+    for (const auto& [key, neighbor] : neighbors)
+    {
+        if (neighbor.state == NEIGHBOR_UP)
+        {
+            count++;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,54 @@
+#ifndef NEIGHBOR_TABLE_H
+#define NEIGHBOR_TABLE_H
+
+#include <string>
+#include <map>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include "wire.h" // For WireHello
+
+enum NeighborState {
+    NEIGHBOR_DOWN,
+    NEIGHBOR_UP,
+};
+
+// One adjacency : a router heard on one of our subnets, a router on two shared subnets has two
+struct Neighbor {
+    std::string router_name;
+    uint32_t address = 0; // Its ip on the shared subnet, host order
+    uint8_t prefix_len = 0;
+    std::string interface_ip; // Our ip on that subnet
+    NeighborState state = NEIGHBOR_DOWN;
+    uint32_t dead_interval_ms = 0; // Sent by the neighbor in its hellos
+    long long last_hello_ms = 0; // Monotonic time
+    long long up_since_ms = 0;
+    uint64_t hellos_received = 0;
+};
+
+// How fast dead neighbors are noticed, the detection latency is the time between
+// the last hello heard and the down decision (dead interval + the time before the next check)
+struct LivenessStats {
+    size_t downs_detected = 0;
+    long long last_detection_ms = 0;
+    long long max_detection_ms = 0;
+    long long total_detection_ms = 0;
+};
+
+class NeighborTable {
+public:
+    // Returns true when the hello brings the adjacency up (new neighbor or back from down)
+    bool on_hello(const WireHello& hello, const std::string& interface_ip, long long now_ms);
+    // Adjacencies without a hello for their dead interval go down, they are returned so their links can be withdrawn
+    std::vector<Neighbor> expire(long long now_ms);
+
+    size_t up_count() const;
+    const std::map<std::pair<std::string, uint32_t>, Neighbor>& get_neighbors() const { return neighbors; }
+    const LivenessStats& get_stats() const { return stats; }
+
+private:
+    std::map<std::pair<std::string, uint32_t>, Neighbor> neighbors; // (router name, address) -> adjacency
+    LivenessStats stats;
+};
+
+#endif // NEIGHBOR_TABLE_H
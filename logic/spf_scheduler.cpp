@@ -0,0 +1,49 @@
+#include <string>
+#include <algorithm>
+#include "spf_scheduler.h"
+
+SpfScheduler::SpfScheduler(long long initial_delay_ms, long long hold_ms, long long max_wait_ms)
+    : initial_delay_ms(std::max(0LL, initial_delay_ms)),
+      min_hold_ms(std::max(1LL, hold_ms)),
+      max_wait_ms(std::max(std::max(1LL, hold_ms), max_wait_ms)),
+      hold_ms(std::max(1LL, hold_ms))
+{
+}
+
+long long SpfScheduler::trigger(const std::string& reason, long long now_ms)
+{
+    stats.triggers++;
+    if (pending)
+    {
+        return -1; // Computed with the others in the pending run
+    }
+
+    pending = true;
+    pending_reason = reason;
+    if (last_run_ms < 0 || now_ms - last_run_ms >= 2 * hold_ms)
+    {
+        hold_ms = min_hold_ms; // The topology is stable again
+        run_at_ms = now_ms + initial_delay_ms;
+    }
+    else
+    {
+        run_at_ms = std::max(now_ms + initial_delay_ms, last_run_ms + hold_ms);
+    }
+    return run_at_ms - now_ms;
+}
+
+void SpfScheduler::ran(long long now_ms, long long duration_ms)
+{
+    if (last_run_ms >= 0 && now_ms - last_run_ms < 2 * hold_ms)
+    {
+        hold_ms = std::min(hold_ms * 2, max_wait_ms); // Still changing, back off
+    }
+    last_run_ms = now_ms;
+    pending = false;
+
+    stats.runs++;
+    stats.last_reason = pending_reason;
+    stats.last_duration_ms = duration_ms;
+    stats.max_duration_ms = std::max(stats.max_duration_ms, duration_ms);
+    stats.total_duration_ms += duration_ms;
+}
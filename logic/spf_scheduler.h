@@ -0,0 +1,46 @@
+#ifndef SPF_SCHEDULER_H
+#define SPF_SCHEDULER_H
+
+#include <string>
+#include <cstddef>
+
+// What the SPF runs cost and why they ran, shown by the "spf" cli command
+struct SpfStats {
+    size_t runs = 0;
+    size_t triggers = 0; // Topology changes seen, several of them can end in one run
+    std::string last_reason;
+    long long last_duration_ms = 0;
+    long long max_duration_ms = 0;
+    long long total_duration_ms = 0;
+};
+
+// Runs SPF shortly after a topology change, and less and less often while the changes keep coming :
+//  - after a quiet period the run comes initial_delay_ms after the first trigger
+//  - then each run waits at least hold_ms after the previous one, the hold doubles after every run
+//    up to max_wait_ms and goes back to hold_ms once the lsdb stays quiet for two holds
+// Triggers received while a run is pending only join it. All the times are monotonic ms
+class SpfScheduler {
+public:
+    SpfScheduler(long long initial_delay_ms = 50, long long hold_ms = 200, long long max_wait_ms = 5000);
+
+    // Returns the delay until the run (from now), or -1 if a run was already pending
+    long long trigger(const std::string& reason, long long now_ms);
+    bool is_pending() const { return pending; }
+    long long scheduled_at() const { return run_at_ms; }
+    void ran(long long now_ms, long long duration_ms);
+    const SpfStats& get_stats() const { return stats; }
+    long long current_hold() const { return hold_ms; }
+
+private:
+    long long initial_delay_ms;
+    long long min_hold_ms;
+    long long max_wait_ms;
+    long long hold_ms; // Wait between two runs, grows while the changes keep coming
+    long long last_run_ms = -1;
+    long long run_at_ms = 0;
+    bool pending = false;
+    std::string pending_reason;
+    SpfStats stats;
+};
+
+#endif // SPF_SCHEDULER_H
@@ -1,6 +1,33 @@
 #include <iostream>
 #include <string>
+#include <random>
+#include <algorithm>
+#include <sstream>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "logic.h"
+#include "graph.h"
+#include "lsdb_store.h"
+#include "wire.h"
+#include "fib.h"
+#include "lsdb_checkpoint.h"
+#include "neighbor_table.h"
+#include "spf_scheduler.h"
+#include "incremental_spf.h"
+#include "metric.h"
+#include "link_load.h"
+#include "../debit/scenario.h"
+
+// compute_all_routes prints every route it finds, the tests that call it many times run it through this
+template <typename Function>
+auto quietly(Function function)
+{
+    struct MutedStdout {
+        std::streambuf* saved = std::cout.rdbuf(nullptr);
+        ~MutedStdout() { std::cout.rdbuf(saved); std::cout.clear(); }
+    } muted;
+    return function();
+}
 
 void runIsValidRouterNameTest(const std::string& testName, const std::string& input, bool expectedResult) {
     bool actualResult = isValidRouterName(input);
@@ -402,6 +429,676 @@ int main() {
         std::cout << "first: " << route.first << " second: " << route.second << std::endl;
     }
 
+    std::cout << "\n--- Testing single shortest-path tree against one Dijkstra per subnet ---" << std::endl;
+    for (const char* router : {"R1", "R2", "R3", "R4"})
+    {
+        bool same = compute_all_routes(router, lsdb_4) == compute_all_routes_per_subnet(router, lsdb_4);
+        std::cout << "Routes from " << router << " (lsdb_4): " << (same ? "PASSED" : "FAILED!") << std::endl;
+    }
+    for (const char* router : {"R5", "R6", "R7"})
+    {
+        bool same = compute_all_routes(router, lsdb_5) == compute_all_routes_per_subnet(router, lsdb_5);
+        std::cout << "Routes from " << router << " (lsdb_5): " << (same ? "PASSED" : "FAILED!") << std::endl;
+    }
+    std::cout << "Unknown router gives no route: " << (compute_all_routes("R42", lsdb_5).empty() ? "PASSED" : "FAILED!") << std::endl;
+
+    std::cout << "\n--- Testing the sparse (CSR) graph against the matrix ---" << std::endl;
+    TopologyGraph graph_4 = build_topology_graph(lsdb_4);
+    bool same_nodes = graph_4.node_names == all_nodes_2;
+    std::cout << "Same node ids as get_all_nodes: " << (same_nodes ? "PASSED" : "FAILED!") << std::endl;
+
+    SpfWorkspace workspace;
+    bool same_next_hops = true;
+    for (int start = 0; start < graph_4.router_count; ++start)
+    {
+        for (int target = 0; target < (int)all_nodes_2.size(); ++target)
+        {
+            if (csrNextHop(graph_4, workspace, start, target) != dijkstraNextHop(matrix_3, start, target))
+            {
+                same_next_hops = false;
+            }
+        }
+    }
+    std::cout << "Same next hops as dijkstraNextHop: " << (same_next_hops ? "PASSED" : "FAILED!") << std::endl;
+
+    std::vector<int> r1_subnets = get_neighbor_nodes(graph_4, find_node(graph_4, "R1"));
+    bool r1_neighbors_ok = r1_subnets.size() == 2 &&
+                           graph_4.node_names[r1_subnets[0]] == "10.0.1.0/24" &&
+                           graph_4.node_names[r1_subnets[1]] == "10.0.2.0/24";
+    std::cout << "Neighbor subnets of R1: " << (r1_neighbors_ok ? "PASSED" : "FAILED!") << std::endl;
+    std::cout << "Unknown node: " << (find_node(graph_4, "R42") == -1 && get_neighbor_nodes(graph_4, -1).empty() ? "PASSED" : "FAILED!") << std::endl;
+
+    std::cout << "\n--- Testing the interned lsdb (LinkStateStore) ---" << std::endl;
+    uint32_t parsed_address = 0;
+    uint8_t parsed_mask = 0;
+    bool parse_ok = parse_ip_with_mask("10.0.5.254/8", parsed_address, parsed_mask) &&
+                    parsed_address == 0x0A0005FE && parsed_mask == 8 &&
+                    !parse_ip_with_mask("192.168.1.0/33", parsed_address, parsed_mask) &&
+                    !parse_ip_with_mask("192.168..1.0/24", parsed_address, parsed_mask) &&
+                    !parse_ip_with_mask("1.2.3.4.5/24", parsed_address, parsed_mask) &&
+                    !parse_ip_with_mask("192.168.1.0/", parsed_address, parsed_mask);
+    std::cout << "parse_ip_with_mask: " << (parse_ok ? "PASSED" : "FAILED!") << std::endl;
+
+    LinkStateStore store_4;
+    for (const auto& [router_name, router_links] : lsdb_4)
+    {
+        for (const auto& [ip_mask, declaration] : router_links)
+        {
+            store_4.add_router_declaration(declaration);
+        }
+    }
+    std::cout << "Interned ids are dense: " << (store_4.interned_router_count() == 4 && store_4.find_router("R3") == 2 && store_4.find_router("R42") == -1 ? "PASSED" : "FAILED!") << std::endl;
+
+    auto store_map = store_4.to_map();
+    bool same_content = store_map.size() == lsdb_4.size();
+    for (const auto& [router_name, router_links] : lsdb_4)
+    {
+        for (const auto& [ip_mask, declaration] : router_links)
+        {
+            const RouterDeclaration& copy = store_map[router_name][ip_mask];
+            same_content = same_content && copy == declaration && copy.link_cost == declaration.link_cost && copy.timestamp == declaration.timestamp;
+        }
+    }
+    std::cout << "to_map gives back the declarations: " << (same_content ? "PASSED" : "FAILED!") << std::endl;
+
+    bool same_routes = true;
+    for (const char* router : {"R1", "R2", "R3", "R4"})
+    {
+        same_routes = same_routes && compute_all_routes(router, store_4) == compute_all_routes(router, lsdb_4);
+    }
+    std::cout << "Same routes as the std::map lsdb: " << (same_routes ? "PASSED" : "FAILED!") << std::endl;
+    std::cout << "Same neighbors as the std::map lsdb: " << (display_neighbor_routers("R1", store_4) == display_neighbor_routers("R1", lsdb_4) ? "PASSED" : "FAILED!") << std::endl;
+
+    RouterDeclaration older = r1_1;
+    older.link_cost = 50;
+    older.timestamp = r1_1.timestamp - 1000;
+    RouterDeclaration newer = r1_1;
+    newer.link_cost = 7;
+    newer.timestamp = r1_1.timestamp + 1000;
+    bool update_ok = !store_4.add_router_declaration(older) && store_4.add_router_declaration(newer) &&
+                     store_4.to_map()["R1"]["10.0.1.1/24"].link_cost == 7 && store_4.link_count() == 8;
+    std::cout << "Only newer declarations replace the old ones: " << (update_ok ? "PASSED" : "FAILED!") << std::endl;
+
+    RouterDeclaration invalid = create_router_definition("R9", "10.0.0.300/24", 1);
+    std::cout << "Invalid ip is refused: " << (!store_4.add_router_declaration(invalid) && store_4.link_count() == 8 ? "PASSED" : "FAILED!") << std::endl;
+
+    RouterDeclaration old_r2 = r2_1;
+    old_r2.timestamp -= 100000;
+    RouterDeclaration old_r2_bis = r2_2;
+    old_r2_bis.timestamp -= 100000;
+    LinkStateStore store_cleanup;
+    store_cleanup.add_router_declaration(r1_1);
+    store_cleanup.add_router_declaration(old_r2);
+    store_cleanup.add_router_declaration(old_r2_bis);
+    store_cleanup.add_router_declaration(r1_2);
+    bool cleanup_ok = store_cleanup.cleanup_old_declarations(5000) && store_cleanup.link_count() == 2 &&
+                      store_cleanup.router_link_count(store_cleanup.find_router("R2")) == 0 &&
+                      store_cleanup.get_router_ids().size() == 1 &&
+                      store_cleanup.to_map()["R1"].size() == 2 && !store_cleanup.cleanup_old_declarations(5000);
+    std::cout << "Old declarations are removed: " << (cleanup_ok ? "PASSED" : "FAILED!") << std::endl;
+
+    // Delta flooding only sends what changed after the last sent sequence
+    uint64_t flooded_sequence = store_cleanup.get_change_sequence();
+    bool nothing_changed = store_cleanup.get_declarations_changed_since(flooded_sequence).empty() &&
+                           !store_cleanup.add_router_declaration(r1_1); // Same timestamp, not re-flooded
+    RouterDeclaration newer_r1 = r1_2;
+    newer_r1.timestamp += 1000;
+    store_cleanup.add_router_declaration(newer_r1);
+    std::vector<RouterDeclaration> changed = store_cleanup.get_declarations_changed_since(flooded_sequence);
+    bool delta_ok = nothing_changed && changed.size() == 1 && changed[0] == r1_2 && changed[0].timestamp == newer_r1.timestamp;
+    flooded_sequence = store_cleanup.get_change_sequence();
+    store_cleanup.refresh_router("R1", newer_r1.timestamp + 1000);
+    delta_ok = delta_ok && store_cleanup.get_declarations_changed_since(flooded_sequence).size() == 2;
+    std::cout << "Only changed declarations are flooded: " << (delta_ok ? "PASSED" : "FAILED!") << std::endl;
+
+    std::cout << "\n--- Testing the binary wire format ---" << std::endl;
+    RouterDeclaration wire_router = create_router_definition("R123", "10.0.1.1/24", 5);
+    WireDeclaration wire;
+    uint8_t wire_buffer[WIRE_DECLARATION_SIZE];
+    bool encoded = to_wire_declaration(wire_router, wire) && encode_wire_declaration(wire, wire_buffer, sizeof(wire_buffer)) == WIRE_DECLARATION_SIZE;
+    WireDeclaration decoded_wire;
+    bool decoded = decode_wire_declaration(wire_buffer, sizeof(wire_buffer), decoded_wire);
+    RouterDeclaration decoded_router = from_wire_declaration(decoded_wire);
+    bool round_trip = encoded && decoded && decoded_router == wire_router &&
+                      decoded_router.link_cost == wire_router.link_cost && decoded_router.timestamp == wire_router.timestamp;
+    std::cout << "Binary round trip: " << (round_trip ? "PASSED" : "FAILED!") << std::endl;
+
+    std::cout << "Truncated buffer is refused: " << (!decode_wire_declaration(wire_buffer, WIRE_DECLARATION_SIZE - 1, decoded_wire) ? "PASSED" : "FAILED!") << std::endl;
+    std::cout << "Small output buffer is refused: " << (encode_wire_declaration(wire, wire_buffer, WIRE_DECLARATION_SIZE - 1) == 0 ? "PASSED" : "FAILED!") << std::endl;
+    wire_buffer[0] = 3;
+    std::cout << "Unknown version is refused: " << (!decode_wire_declaration(wire_buffer, sizeof(wire_buffer), decoded_wire) ? "PASSED" : "FAILED!") << std::endl;
+
+    std::string text_message = encode_router_declaration(wire_router, WIRE_FORMAT_TEXT);
+    std::string binary_message = encode_router_declaration(wire_router, WIRE_FORMAT_BINARY);
+    bool detection = detect_wire_format((const uint8_t*)text_message.data(), text_message.size()) == WIRE_FORMAT_TEXT &&
+                     detect_wire_format((const uint8_t*)binary_message.data(), binary_message.size()) == WIRE_FORMAT_BINARY &&
+                     binary_message.size() == WIRE_DECLARATION_SIZE;
+    std::cout << "Format detection: " << (detection ? "PASSED" : "FAILED!") << std::endl;
+
+    RouterDeclaration capacity_router = create_router_definition("R124", "10.0.2.1/24", 5);
+    capacity_router.capacity_mbps = 2500;
+    std::string capacity_binary = encode_router_declaration(capacity_router, WIRE_FORMAT_BINARY);
+    std::vector<RouterDeclaration> capacity_decoded;
+    decode_router_declarations((const uint8_t*)capacity_binary.data(), capacity_binary.size(), capacity_decoded);
+    RouterDeclaration capacity_text = deserialize_router_definition(serialize_router_definition(capacity_router));
+    bool capacity_ok = capacity_binary.size() == WIRE_DECLARATION_CAPACITY_SIZE && capacity_decoded.size() == 1 &&
+                       capacity_decoded[0].capacity_mbps == 2500 && capacity_text.capacity_mbps == 2500 &&
+                       deserialize_router_definition(serialize_router_definition(wire_router)).capacity_mbps == 0 &&
+                       std::count(text_message.begin(), text_message.end(), ',') == 4; // Still 5 segments without a capacity
+    std::cout << "Capacity carried in text and binary: " << (capacity_ok ? "PASSED" : "FAILED!") << std::endl;
+
+    // Only "R<number>" names fit in the binary router id, the others stay in text
+    RouterDeclaration hostname_router = create_router_definition("router-a", "10.0.1.1/24", 5);
+    RouterDeclaration padded_router = create_router_definition("R007", "10.0.1.1/24", 5);
+    bool fallback = encode_router_declaration(hostname_router, WIRE_FORMAT_BINARY) == serialize_router_definition(hostname_router) &&
+                    encode_router_declaration(padded_router, WIRE_FORMAT_BINARY) == serialize_router_definition(padded_router);
+    std::cout << "Text fallback for other names: " << (fallback ? "PASSED" : "FAILED!") << std::endl;
+
+    std::cout << "\n--- Testing many declarations in one datagram ---" << std::endl;
+    std::vector<RouterDeclaration> flood;
+    for (int k = 0; k < 100; ++k)
+    {
+        flood.push_back(create_router_definition("R" + std::to_string(k), "10.0." + std::to_string(k) + ".1/24", k));
+    }
+    flood.push_back(hostname_router); // Text record in the middle of binary ones
+
+    for (WireFormat format : {WIRE_FORMAT_BINARY, WIRE_FORMAT_TEXT})
+    {
+        std::vector<size_t> counts;
+        std::vector<std::string> datagrams = pack_router_declarations(flood, format, WIRE_MAX_DATAGRAM_SIZE, counts);
+        std::vector<RouterDeclaration> unpacked;
+        size_t invalid = 0;
+        bool sizes_ok = counts.size() == datagrams.size();
+        for (size_t d = 0; d < datagrams.size(); ++d)
+        {
+            size_t before = unpacked.size();
+            sizes_ok = sizes_ok && datagrams[d].size() <= WIRE_MAX_DATAGRAM_SIZE;
+            invalid += decode_router_declarations((const uint8_t*)datagrams[d].data(), datagrams[d].size(), unpacked);
+            sizes_ok = sizes_ok && unpacked.size() - before == counts[d];
+        }
+        bool same = unpacked.size() == flood.size() && invalid == 0 && sizes_ok;
+        for (size_t k = 0; same && k < flood.size(); ++k)
+        {
+            same = unpacked[k] == flood[k] && unpacked[k].link_cost == flood[k].link_cost && unpacked[k].timestamp == flood[k].timestamp;
+        }
+        std::cout << (format == WIRE_FORMAT_BINARY ? "Binary" : "Text") << " batch of " << flood.size() << " in "
+                  << datagrams.size() << " datagrams: " << (same ? "PASSED" : "FAILED!") << std::endl;
+    }
+
+    std::cout << "One declaration per datagram with size 0: " << (pack_router_declarations(flood, WIRE_FORMAT_BINARY, 0).size() == flood.size() ? "PASSED" : "FAILED!") << std::endl;
+
+    std::string bad_batch = serialize_router_definition(flood[0]) + "{1,R1,oops}" + serialize_router_definition(flood[1]);
+    std::vector<RouterDeclaration> bad_unpacked;
+    size_t bad_count = decode_router_declarations((const uint8_t*)bad_batch.data(), bad_batch.size(), bad_unpacked);
+    std::cout << "Bad text record is skipped: " << (bad_count == 1 && bad_unpacked.size() == 2 ? "PASSED" : "FAILED!") << std::endl;
+
+    std::string truncated_batch = encode_router_declaration(flood[0], WIRE_FORMAT_BINARY) + encode_router_declaration(flood[1], WIRE_FORMAT_BINARY).substr(0, 10);
+    std::vector<RouterDeclaration> truncated_unpacked;
+    size_t truncated_count = decode_router_declarations((const uint8_t*)truncated_batch.data(), truncated_batch.size(), truncated_unpacked);
+    std::cout << "Truncated binary record is refused: " << (truncated_count == 1 && truncated_unpacked.size() == 1 ? "PASSED" : "FAILED!") << std::endl;
+
+    // Only the withdrawal marker can be negative, in both formats
+    RouterDeclaration negative = flood[1];
+    negative.link_cost = -7;
+    RouterDeclaration withdrawn = flood[1];
+    withdrawn.link_cost = LINK_COST_WITHDRAWN;
+    std::string negative_batch = encode_router_declaration(negative, WIRE_FORMAT_BINARY) + encode_router_declaration(withdrawn, WIRE_FORMAT_BINARY) +
+                                 serialize_router_definition(negative) + serialize_router_definition(withdrawn);
+    std::vector<RouterDeclaration> negative_unpacked;
+    size_t negative_count = decode_router_declarations((const uint8_t*)negative_batch.data(), negative_batch.size(), negative_unpacked);
+    bool negative_ok = negative_count == 2 && negative_unpacked.size() == 2 &&
+                       negative_unpacked[0].link_cost == LINK_COST_WITHDRAWN && negative_unpacked[1].link_cost == LINK_COST_WITHDRAWN;
+    std::cout << "Negative costs other than the withdrawal are refused: " << (negative_ok ? "PASSED" : "FAILED!") << std::endl;
+
+    std::cout << "\n--- Testing the lsdb checkpoint ---" << std::endl;
+    std::string checkpoint_path = "/tmp/unit_test_lsdb.checkpoint";
+    LinkStateStore restored;
+    restored.add_router_declaration(r2_1); // Already known, the checkpoint copy is not newer
+    bool checkpoint_ok = save_lsdb_checkpoint(store_4, checkpoint_path) &&
+                         load_lsdb_checkpoint(restored, checkpoint_path) == (int)store_4.link_count() - 1 &&
+                         restored.to_map() == store_4.to_map();
+    std::cout << "Checkpoint round trip: " << (checkpoint_ok ? "PASSED" : "FAILED!") << std::endl;
+
+    restored.mark_all_stale();
+    restored.add_router_declaration(r1_1); // Old copy, still confirms the link
+    restored.refresh_router("R2", r2_1.timestamp + 1000);
+    size_t stale_before_sweep = restored.stale_link_count();
+    size_t confirmed = restored.link_count() - stale_before_sweep;
+    bool stale_ok = confirmed == 1 + restored.router_link_count(restored.find_router("R2")) &&
+                    restored.sweep_stale_links() == stale_before_sweep &&
+                    restored.link_count() == confirmed && restored.stale_link_count() == 0;
+    std::cout << "Stale links are swept after the restart: " << (stale_ok ? "PASSED" : "FAILED!") << std::endl;
+
+    FILE* corrupted = fopen(checkpoint_path.c_str(), "r+");
+    fseek(corrupted, sizeof(CheckpointHeader) + 2, SEEK_SET);
+    fputc('#', corrupted);
+    fclose(corrupted);
+    LinkStateStore from_corrupted;
+    std::cout << "Corrupted checkpoint is refused: " << (load_lsdb_checkpoint(from_corrupted, checkpoint_path) == -1 && from_corrupted.link_count() == 0 ? "PASSED" : "FAILED!") << std::endl;
+    std::remove(checkpoint_path.c_str());
+
+    // A directory in place of the checkpoint makes the rename fail, the temporary file must not stay
+    std::string blocked_path = "/tmp/unit_test_lsdb_blocked.checkpoint";
+    mkdir(blocked_path.c_str(), 0755);
+    bool blocked_refused = !save_lsdb_checkpoint(store_4, blocked_path);
+    bool tmp_removed = access((blocked_path + ".tmp").c_str(), F_OK) != 0;
+    rmdir(blocked_path.c_str());
+    std::cout << "Checkpoint that could not be renamed leaves no temporary file: " << (blocked_refused && tmp_removed ? "PASSED" : "FAILED!") << std::endl;
+
+    std::cout << "\n--- Testing the FIB delta ---" << std::endl;
+    RouteTable installed_routes = routes_to_table(compute_all_routes("R1", lsdb_4));
+    std::cout << "Same routes, nothing to do: " << (compute_fib_delta(installed_routes, routes_to_table(compute_all_routes("R1", store_4))).size() == 0 ? "PASSED" : "FAILED!") << std::endl;
+
+    RouteTable desired_routes = installed_routes;
+    desired_routes.erase(desired_routes.begin());
+    desired_routes.rbegin()->second = "10.0.9.9";
+    desired_routes["192.168.0.0/16"] = "10.0.1.2";
+    FibDelta fib_delta = compute_fib_delta(installed_routes, desired_routes);
+    bool fib_delta_ok = fib_delta.deleted.size() == 1 && fib_delta.deleted[0].first == installed_routes.begin()->first &&
+                    fib_delta.replaced.size() == 1 && fib_delta.replaced[0].second == "10.0.9.9" &&
+                    fib_delta.added.size() == 1 && fib_delta.added[0].first == "192.168.0.0/16";
+    std::cout << "Add, replace and delete are found: " << (fib_delta_ok ? "PASSED" : "FAILED!") << std::endl;
+    std::cout << "Empty desired table deletes everything: " << (compute_fib_delta(installed_routes, RouteTable()).deleted.size() == installed_routes.size() ? "PASSED" : "FAILED!") << std::endl;
+
+    std::vector<NextHop> parsed_next_hops = parse_next_hops("10.0.1.2*10,10.0.2.3");
+    bool next_hops_ok = parsed_next_hops.size() == 2 && parsed_next_hops[0].address == "10.0.1.2" && parsed_next_hops[0].weight == 10 &&
+                        parsed_next_hops[1].weight == 1 && format_next_hops(parsed_next_hops) == "10.0.1.2*10,10.0.2.3" &&
+                        parse_next_hops("10.0.1.2").size() == 1 && uses_next_hop("10.0.1.2*10,10.0.2.3", "10.0.2.3") &&
+                        !uses_next_hop("10.0.1.2*10,10.0.2.3", "10.0.2.33");
+    std::cout << "Multipath next hops written and read back: " << (next_hops_ok ? "PASSED" : "FAILED!") << std::endl;
+
+    std::cout << "\n--- Testing the hellos and neighbor liveness ---" << std::endl;
+    WireHello hello_out = {"R2", 0x0A000102, 24, 250, 1000};
+    uint8_t hello_buffer[WIRE_HELLO_HEADER_SIZE + WIRE_HELLO_MAX_NAME];
+    size_t hello_length = encode_wire_hello(hello_out, hello_buffer, sizeof(hello_buffer));
+    WireHello hello_in;
+    bool hello_ok = hello_length == WIRE_HELLO_HEADER_SIZE + 2 && decode_wire_hello(hello_buffer, hello_length, hello_in) &&
+                    hello_in.router_name == "R2" && hello_in.address == 0x0A000102 && hello_in.prefix_len == 24 &&
+                    hello_in.hello_interval_ms == 250 && hello_in.dead_interval_ms == 1000;
+    std::cout << "Hello round trip: " << (hello_ok ? "PASSED" : "FAILED!") << std::endl;
+    std::cout << "Truncated hello is refused: " << (!decode_wire_hello(hello_buffer, hello_length - 1, hello_in) ? "PASSED" : "FAILED!") << std::endl;
+
+    NeighborTable neighbor_table;
+    bool came_up = neighbor_table.on_hello(hello_out, "10.0.1.1", 0);
+    bool still_up = !neighbor_table.on_hello(hello_out, "10.0.1.1", 900) && neighbor_table.expire(1800).empty();
+    std::vector<Neighbor> went_down = neighbor_table.expire(1950);
+    bool liveness_ok = came_up && still_up && went_down.size() == 1 && went_down[0].router_name == "R2" &&
+                       neighbor_table.up_count() == 0 && neighbor_table.get_stats().last_detection_ms == 1050 &&
+                       neighbor_table.expire(5000).empty() && neighbor_table.on_hello(hello_out, "10.0.1.1", 6000);
+    std::cout << "Neighbor goes down after its dead interval and comes back: " << (liveness_ok ? "PASSED" : "FAILED!") << std::endl;
+
+    LinkStateStore liveness_store;
+    RouterDeclaration dead_link = create_router_definition("R2", "10.0.1.2/24", 10);
+    liveness_store.add_router_declaration(dead_link);
+    liveness_store.add_router_declaration(create_router_definition("R2", "10.0.2.2/24", 10));
+    LinkStateStore remote_store = liveness_store; // A router that only hears about the failure
+    uint64_t before_dead = liveness_store.get_change_sequence();
+    bool withdraw_ok = liveness_store.withdraw_link("R2", 0x0A000102, 24) && liveness_store.link_count() == 1 &&
+                       !liveness_store.add_router_declaration(dead_link); // Copy flooded back by another router
+    std::vector<RouterDeclaration> dead_flood = liveness_store.get_declarations_changed_since(before_dead);
+    bool dead_flooded = dead_flood.size() == 1 && dead_flood[0].link_cost == LINK_COST_WITHDRAWN &&
+                        remote_store.add_router_declaration(dead_flood[0]) && remote_store.link_count() == 1;
+    std::cout << "Dead neighbor withdrawal is flooded to the other routers: " << (dead_flooded ? "PASSED" : "FAILED!") << std::endl;
+    dead_link.timestamp += 2; // Newer than the withdrawal, which is one ms newer than the last copy
+    withdraw_ok = withdraw_ok && liveness_store.add_router_declaration(dead_link) && liveness_store.link_count() == 2;
+    std::cout << "Dead neighbor link is withdrawn until a newer declaration: " << (withdraw_ok ? "PASSED" : "FAILED!") << std::endl;
+
+    std::cout << "\n--- Testing the withdrawal of a link ---" << std::endl;
+    LinkStateStore withdrawal_store;
+    RouterDeclaration lost_link = create_router_definition("R3", "10.0.3.3/24", 10);
+    withdrawal_store.add_router_declaration(lost_link);
+    withdrawal_store.add_router_declaration(create_router_definition("R3", "10.0.4.3/24", 10));
+    uint64_t before_withdrawal = withdrawal_store.get_change_sequence();
+    RouterDeclaration withdrawal = lost_link;
+    withdrawal.link_cost = LINK_COST_WITHDRAWN;
+    withdrawal.timestamp += 1;
+    std::vector<RouterDeclaration> to_flood;
+    bool withdrawal_ok = withdrawal_store.add_router_declaration(withdrawal) && withdrawal_store.link_count() == 1 &&
+                         !withdrawal_store.add_router_declaration(lost_link) && !withdrawal_store.add_router_declaration(withdrawal);
+    to_flood = withdrawal_store.get_declarations_changed_since(before_withdrawal);
+    withdrawal_ok = withdrawal_ok && to_flood.size() == 1 && to_flood[0].ip_with_mask == "10.0.3.3/24" &&
+                    to_flood[0].link_cost == LINK_COST_WITHDRAWN && withdrawal_store.get_withdrawn_declarations().size() == 1;
+    std::cout << "Withdrawal removes the link and is flooded: " << (withdrawal_ok ? "PASSED" : "FAILED!") << std::endl;
+
+    lost_link.timestamp += 2;
+    bool redeclared_ok = withdrawal_store.add_router_declaration(lost_link) && withdrawal_store.link_count() == 2 &&
+                         withdrawal_store.get_withdrawn_declarations().empty();
+    std::cout << "Link declared again after its withdrawal: " << (redeclared_ok ? "PASSED" : "FAILED!") << std::endl;
+
+    LinkStateStore late_store;
+    late_store.add_router_declaration(withdrawal); // Never had the link, the withdrawal still blocks older copies
+    lost_link.timestamp -= 2;
+    std::cout << "Withdrawal of an unknown link blocks older copies: " << (!late_store.add_router_declaration(lost_link) && late_store.link_count() == 0 ? "PASSED" : "FAILED!") << std::endl;
+
+    std::cout << "\n--- Testing the SPF scheduler ---" << std::endl;
+    SpfScheduler scheduler(50, 200, 1000);
+    bool first_ok = scheduler.trigger("new link", 0) == 50 && scheduler.trigger("cost change", 10) == -1 && scheduler.is_pending();
+    scheduler.ran(50, 3);
+    std::cout << "Burst of changes gives one run after the initial delay: " << (first_ok && scheduler.get_stats().runs == 1 && scheduler.get_stats().triggers == 2 ? "PASSED" : "FAILED!") << std::endl;
+
+    bool backoff_ok = scheduler.trigger("new link", 60) == 190; // Hold of 200 ms after the run at 50
+    scheduler.ran(250, 3);
+    backoff_ok = backoff_ok && scheduler.current_hold() == 400 && scheduler.trigger("new link", 260) == 390;
+    scheduler.ran(650, 3);
+    scheduler.trigger("new link", 700);
+    scheduler.ran(1650, 3);
+    backoff_ok = backoff_ok && scheduler.current_hold() == 1000; // Capped by the max wait
+    std::cout << "Hold doubles while changes keep coming: " << (backoff_ok ? "PASSED" : "FAILED!") << std::endl;
+    std::cout << "Quiet lsdb resets the hold: " << (scheduler.trigger("link removed", 5000) == 50 && scheduler.current_hold() == 200 ? "PASSED" : "FAILED!") << std::endl;
+
+    LinkStateStore topology_store;
+    RouterDeclaration topology_link = create_router_definition("R4", "10.0.4.4/24", 10);
+    topology_store.add_router_declaration(topology_link);
+    uint64_t topology_before = topology_store.get_topology_sequence();
+    topology_store.refresh_router("R4", topology_link.timestamp + 1000);
+    topology_link.timestamp += 2000;
+    topology_store.add_router_declaration(topology_link); // Newer but same cost
+    bool refresh_quiet = topology_store.get_topology_sequence() == topology_before;
+    topology_link.timestamp += 1;
+    topology_link.link_cost = 20;
+    topology_store.add_router_declaration(topology_link);
+    std::cout << "Only topology changes move the topology sequence: " << (refresh_quiet && topology_store.get_topology_sequence() == topology_before + 1 ? "PASSED" : "FAILED!") << std::endl;
+    topology_link.timestamp += 1;
+    topology_link.capacity_mbps = 1000;
+    topology_store.add_router_declaration(topology_link);
+    std::cout << "New capacity is a topology change: " << (topology_store.get_topology_sequence() == topology_before + 2 &&
+                                                          topology_store.to_declaration(topology_store.get_links()[0]).capacity_mbps == 1000 ? "PASSED" : "FAILED!") << std::endl;
+
+    std::cout << "\n--- Testing the incremental SPF against the full computation ---" << std::endl;
+    for (int max_cost : {20, 3})
+    {
+        // Random adds, removals and cost changes on a small topology, the routes must always be the ones
+        // compute_all_routes finds from scratch (equal cost paths included). Costs from 1 to 20 check the
+        // repairs, from 0 to 3 the many ties and the links of cost 0 (full runs while there is one)
+        std::mt19937 gen(max_cost == 20 ? 7 : 1);
+        std::uniform_int_distribution<> router_dis(0, 29);
+        std::uniform_int_distribution<> subnet_dis(0, 19);
+        std::uniform_int_distribution<> cost_dis(max_cost == 20 ? 1 : 0, max_cost);
+        std::uniform_int_distribution<> action_dis(0, 2);
+        LinkStateStore random_store;
+        IncrementalSpf incremental;
+        long long random_timestamp = 1;
+        int mismatches = 0;
+        int multipath_mismatches = 0;
+        size_t multipath_routes = 0;
+
+        for (int step = 0; step < 2000; ++step)
+        {
+            int router = (step < 40) ? step % 30 : router_dis(gen); // Everybody starts with a link
+            int subnet = subnet_dis(gen);
+            RouterDeclaration random_link;
+            random_link.router_name = "R" + std::to_string(router);
+            random_link.ip_with_mask = "10.0." + std::to_string(subnet) + "." + std::to_string(router + 1) + "/24";
+            random_link.link_cost = (step >= 40 && action_dis(gen) == 0) ? LINK_COST_WITHDRAWN : cost_dis(gen);
+            random_link.timestamp = random_timestamp++;
+            random_store.add_router_declaration(random_link);
+
+            incremental.update(random_store, "R0");
+            RouteTable expected = quietly([&] { return routes_to_table(compute_all_routes("R0", random_store)); });
+            if (routes_to_table(incremental.routes()) != expected)
+            {
+                mismatches++;
+            }
+
+            // Same with up to 3 equal cost paths, the partial runs only give the prefixes they touched
+            RouteTable expected_multipath = quietly([&] { return routes_to_table(compute_all_routes("R0", random_store, 3)); });
+            if (routes_to_table(incremental.routes(3)) != expected_multipath)
+            {
+                multipath_mismatches++;
+            }
+            for (const PrefixRoute& prefix_route : incremental.partial_routes(3))
+            {
+                auto it = expected_multipath.find(prefix_route.destination);
+                if (prefix_route.next_hop != (it == expected_multipath.end() ? "" : it->second))
+                {
+                    multipath_mismatches++;
+                }
+            }
+            multipath_routes += std::count_if(expected_multipath.begin(), expected_multipath.end(),
+                                              [](const auto& route) { return route.second.find(',') != std::string::npos; });
+        }
+        std::cout << "Costs up to " << max_cost << ", same routes after 2000 random changes: " << (mismatches == 0 ? "PASSED" : "FAILED!")
+                  << " (" << incremental.incremental_runs << " repaired, " << incremental.partial_runs << " of them partial, "
+                  << incremental.full_runs << " full runs)" << std::endl;
+        std::cout << "Costs up to " << max_cost << ", same equal cost next hops after 2000 random changes: " << (multipath_mismatches == 0 && multipath_routes > 0 ? "PASSED" : "FAILED!")
+                  << " (" << multipath_routes << " multipath routes seen)" << std::endl;
+        if (max_cost == 20)
+        {
+            std::cout << "Most changes are repaired without a full run: " << (incremental.incremental_runs > incremental.full_runs * 4 ? "PASSED" : "FAILED!") << std::endl;
+        }
+    }
+
+    {
+        // Links of cost 0 on both sides of a subnet : the tree must not loop
+        LinkStateStore zero_store;
+        zero_store.add_router_declaration(create_router_definition("R0", "10.0.0.1/24", 10));
+        IncrementalSpf zero_spf;
+        zero_spf.update(zero_store, "R0");
+        zero_store.add_router_declaration(create_router_definition("R0", "10.0.2.1/24", 0));
+        zero_spf.update(zero_store, "R0");
+        zero_store.add_router_declaration(create_router_definition("R3", "10.0.0.4/24", 0));
+        zero_store.add_router_declaration(create_router_definition("R3", "10.0.2.4/24", 0));
+        zero_spf.update(zero_store, "R0");
+        RouteTable zero_expected = quietly([&] { return routes_to_table(compute_all_routes("R0", zero_store)); });
+        std::cout << "Links of cost 0 give the routes of a full computation: "
+                  << (routes_to_table(zero_spf.routes()) == zero_expected && routes_to_table(zero_spf.routes(3)).size() == zero_expected.size() ? "PASSED" : "FAILED!") << std::endl;
+    }
+
+    {
+        // R0 - 10.1.0.0/24 - R1 - 10.1.1.0/24 - R2, then stub subnets on R2
+        LinkStateStore stub_store;
+        stub_store.add_router_declaration(create_router_definition("R0", "10.1.0.1/24", 10));
+        stub_store.add_router_declaration(create_router_definition("R1", "10.1.0.2/24", 10));
+        stub_store.add_router_declaration(create_router_definition("R1", "10.1.1.2/24", 10));
+        stub_store.add_router_declaration(create_router_definition("R2", "10.1.1.3/24", 10));
+        IncrementalSpf stub_spf;
+        stub_spf.update(stub_store, "R0");
+
+        RouterDeclaration stub_link = create_router_definition("R2", "10.1.9.3/24", 5);
+        stub_store.add_router_declaration(stub_link);
+        bool added_ok = stub_spf.update(stub_store, "R0") && stub_spf.last_partial;
+        std::vector<PrefixRoute> prefix_routes = stub_spf.partial_routes();
+        added_ok = added_ok && prefix_routes.size() == 1 && prefix_routes[0].destination == "10.1.9.0/24" && prefix_routes[0].next_hop == "10.1.0.2";
+        std::cout << "New stub subnet only computes its own route: " << (added_ok ? "PASSED" : "FAILED!") << std::endl;
+
+        stub_link.link_cost = LINK_COST_WITHDRAWN;
+        stub_link.timestamp += 1;
+        stub_store.add_router_declaration(stub_link);
+        bool removed_ok = stub_spf.update(stub_store, "R0") && stub_spf.last_partial;
+        prefix_routes = stub_spf.partial_routes();
+        removed_ok = removed_ok && prefix_routes.size() == 1 && prefix_routes[0].next_hop.empty();
+        std::cout << "Removed stub subnet loses its route: " << (removed_ok ? "PASSED" : "FAILED!") << std::endl;
+
+        stub_store.add_router_declaration(create_router_definition("R2", "10.1.7.3/24", 5));
+        stub_spf.update(stub_store, "R0");
+        stub_store.add_router_declaration(create_router_definition("R1", "10.1.7.2/24", 1)); // Not a stub anymore
+        bool shared_ok = stub_spf.update(stub_store, "R0") && !stub_spf.last_partial && stub_spf.partial_routes().empty();
+        RouteTable expected = quietly([&] { return routes_to_table(compute_all_routes("R0", stub_store)); });
+        shared_ok = shared_ok && routes_to_table(stub_spf.routes()) == expected;
+        std::cout << "Second router on a stub subnet needs a real repair: " << (shared_ok ? "PASSED" : "FAILED!") << std::endl;
+    }
+
+    {
+        // R0 reaches 10.3.9.0/24 through R1 and through R2 at the same cost, R3 is one more hop away
+        LinkStateStore ecmp_store;
+        ecmp_store.add_router_declaration(create_router_definition("R0", "10.3.1.1/24", 10));
+        ecmp_store.add_router_declaration(create_router_definition("R0", "10.3.2.1/24", 10));
+        ecmp_store.add_router_declaration(create_router_definition("R1", "10.3.1.2/24", 10));
+        ecmp_store.add_router_declaration(create_router_definition("R2", "10.3.2.3/24", 10));
+        ecmp_store.add_router_declaration(create_router_definition("R1", "10.3.9.2/24", 10));
+        ecmp_store.add_router_declaration(create_router_definition("R2", "10.3.9.3/24", 10));
+        RouteTable single_path = quietly([&] { return routes_to_table(compute_all_routes("R0", ecmp_store)); });
+        RouteTable two_paths = quietly([&] { return routes_to_table(compute_all_routes("R0", ecmp_store, 4)); });
+        RouteTable one_path = quietly([&] { return routes_to_table(compute_all_routes("R0", ecmp_store, 1)); });
+        std::cout << "Both uplinks used for an equal cost destination: " << (two_paths["10.3.9.0/24"] == "10.3.1.2,10.3.2.3" ? "PASSED" : "FAILED!") << std::endl;
+        std::cout << "One path when multipath is off: " << (single_path == one_path && single_path["10.3.9.0/24"] == "10.3.1.2" ? "PASSED" : "FAILED!") << std::endl;
+
+        RouterDeclaration slower = create_router_definition("R2", "10.3.9.3/24", 11);
+        slower.timestamp += 1;
+        ecmp_store.add_router_declaration(slower);
+        two_paths = quietly([&] { return routes_to_table(compute_all_routes("R0", ecmp_store, 4)); });
+        std::cout << "Costlier path dropped from the next hops: " << (two_paths["10.3.9.0/24"] == "10.3.1.2" ? "PASSED" : "FAILED!") << std::endl;
+    }
+
+    std::cout << "\n--- Testing the capacity metrics ---" << std::endl;
+    {
+        // R0 reaches 10.4.9.0/24 in 3 hops through R1 (100 Mbit/s) or R2 (1 Gbit/s),
+        // and in 5 hops through R3 and R4 (10 Gbit/s)
+        LinkStateStore metric_store;
+        auto add_link = [&metric_store](const std::string& router, const std::string& ip, uint32_t capacity_mbps) {
+            RouterDeclaration declaration = create_router_definition(router, ip, 10);
+            declaration.capacity_mbps = capacity_mbps;
+            metric_store.add_router_declaration(declaration);
+        };
+        add_link("R0", "10.4.1.1/24", 100);
+        add_link("R0", "10.4.2.1/24", 1000);
+        add_link("R0", "10.4.3.1/24", 10000);
+        add_link("R1", "10.4.1.2/24", 100);
+        add_link("R1", "10.4.9.2/24", 100);
+        add_link("R2", "10.4.2.3/24", 1000);
+        add_link("R2", "10.4.9.3/24", 1000);
+        add_link("R3", "10.4.3.4/24", 10000);
+        add_link("R3", "10.4.4.4/24", 10000);
+        add_link("R4", "10.4.4.5/24", 10000);
+        add_link("R4", "10.4.9.5/24", 10000);
+
+        MetricConfig hops_capacity;
+        hops_capacity.mode = METRIC_HOPS_CAPACITY;
+        MetricConfig weighted;
+        weighted.mode = METRIC_WEIGHTED;
+        RouteTable by_cost = quietly([&] { return routes_to_table(compute_all_routes("R0", metric_store)); });
+        RouteTable by_hops = quietly([&] { return routes_to_table(compute_all_routes("R0", metric_store, 1, hops_capacity)); });
+        RouteTable by_hops_multipath = quietly([&] { return routes_to_table(compute_all_routes("R0", metric_store, 4, hops_capacity)); });
+        RouteTable by_weight = quietly([&] { return routes_to_table(compute_all_routes("R0", metric_store, 1, weighted)); });
+        std::cout << "Cost metric ignores the capacity: " << (by_cost["10.4.9.0/24"] == "10.4.1.2" ? "PASSED" : "FAILED!") << std::endl;
+        std::cout << "Fewest hops, then the widest bottleneck: " << (by_hops["10.4.9.0/24"] == "10.4.2.3" && by_hops_multipath["10.4.9.0/24"] == "10.4.2.3" &&
+                                                                    by_hops["10.4.4.0/24"] == "10.4.3.4" ? "PASSED" : "FAILED!") << std::endl;
+        std::cout << "Weighted metric takes more hops for more capacity: " << (by_weight["10.4.9.0/24"] == "10.4.3.4" ? "PASSED" : "FAILED!") << std::endl;
+        std::cout << "Weighted link cost: " << (weighted_link_cost(100000, weighted) == 20 && weighted_link_cost(0, weighted) == 65535 &&
+                                               weighted_link_cost(1000, weighted) == 1010 ? "PASSED" : "FAILED!") << std::endl;
+
+        std::string capacity_path = "/tmp/unit_test_capacity.checkpoint";
+        LinkStateStore capacity_restored;
+        bool restored_ok = save_lsdb_checkpoint(metric_store, capacity_path) && load_lsdb_checkpoint(capacity_restored, capacity_path) == 11;
+        for (const PackedLink& link : capacity_restored.get_links())
+        {
+            restored_ok = restored_ok && link.capacity_mbps >= 100;
+        }
+        std::cout << "Capacity kept by the checkpoint: " << (restored_ok ? "PASSED" : "FAILED!") << std::endl;
+        std::remove(capacity_path.c_str());
+    }
+
+    std::cout << "\n--- Testing the link load bands ---" << std::endl;
+    {
+        // 100 Mbit/s link sampled every second, 12.5 MB in a second is a full link
+        LoadCostConfig load_config;
+        load_config.ewma_percent = 100; // No smoothing, the band follows each sample
+        load_config.hold_ms = 0;
+        LinkLoad load(load_config);
+        uint64_t rx = 1000, tx = 5000;
+        long long now_ms = 0;
+        auto step = [&](double utilization) {
+            now_ms += 1000;
+            rx += (uint64_t)(utilization * 12500000);
+            return load.sample(rx, tx, now_ms, 100);
+        };
+        bool first_quiet = !load.sample(rx, tx, now_ms, 100) && load.band() == 0;
+        bool up_ok = !step(0.27) && load.band() == 0 && step(0.31) && load.band() == 1 && load.extra_cost() == 10;
+        bool down_ok = !step(0.22) && load.band() == 1 && step(0.19) && load.band() == 0;
+        bool full_ok = step(1.0) && load.band() == 3 && !step(1.0);
+        std::cout << "Bands change only past the hysteresis: " << (first_quiet && up_ok && down_ok && full_ok ? "PASSED" : "FAILED!") << std::endl;
+
+        LinkLoad reset_load(load_config);
+        reset_load.sample(5000000, 0, 0, 100);
+        bool reset_ok = !reset_load.sample(1000, 0, 1000, 100) && reset_load.utilization() == 0 &&
+                        !reset_load.sample(1000 + 12500000 / 10, 0, 2000, 100) && reset_load.band() == 0;
+        std::cout << "Counter reset is only a new starting point: " << (reset_ok ? "PASSED" : "FAILED!") << std::endl;
+
+        // Load going up and down every second : smoothed, and at most one change per hold
+        LoadCostConfig damped_config;
+        damped_config.hold_ms = 10000;
+        LinkLoad damped(damped_config);
+        uint64_t damped_rx = 0;
+        damped.sample(damped_rx, 0, 0, 100);
+        size_t changes = 0;
+        for (int second = 1; second <= 60; ++second)
+        {
+            damped_rx += (second % 2 == 0) ? 12500000 : 0;
+            changes += damped.sample(damped_rx, 0, second * 1000, 100) ? 1 : 0;
+        }
+        std::cout << "Flapping load is damped: " << (changes >= 1 && changes <= 6 && damped.band_changes == changes ? "PASSED" : "FAILED!")
+                  << " (" << changes << " cost changes in 60 samples)" << std::endl;
+
+        LinkLoad unknown(load_config);
+        unknown.sample(0, 0, 0, 0);
+        std::cout << "Unknown capacity keeps the first band: " << (!unknown.sample(1000000000, 0, 1000, 0) && unknown.band() == 0 ? "PASSED" : "FAILED!") << std::endl;
+    }
+
+    std::cout << "\n--- Testing the debitGenerator scenarios ---" << std::endl;
+    {
+        uint64_t rate = 0, duration = 0;
+        bool rates_ok = parse_rate("10mbit", rate) && rate == 10000000 && parse_rate("500kbit", rate) && rate == 500000 &&
+                        parse_rate("1gbit", rate) && rate == 1000000000 && parse_rate("64000bit", rate) && rate == 64000 &&
+                        parse_rate("1.5MBit", rate) && rate == 1500000;
+        std::cout << "Rates with their units: " << (rates_ok ? "PASSED" : "FAILED!") << std::endl;
+        std::cout << "Rates with a bad number or unit are refused: "
+                  << (!parse_rate("10", rate) && !parse_rate("mbit", rate) && !parse_rate("10mb", rate) && !parse_rate("1.2.3mbit", rate) ? "PASSED" : "FAILED!") << std::endl;
+
+        bool durations_ok = parse_duration_us("250us", duration) && duration == 250 && parse_duration_us("50ms", duration) && duration == 50000 &&
+                            parse_duration_us("2s", duration) && duration == 2000000 && parse_duration_us("1500", duration) && duration == 1500000;
+        std::cout << "Durations with their units, ms without one: " << (durations_ok ? "PASSED" : "FAILED!") << std::endl;
+        std::cout << "Durations with a bad number or unit are refused: "
+                  << (!parse_duration_us("5m", duration) && !parse_duration_us("", duration) && !parse_duration_us("ms", duration) &&
+                     !parse_duration_us("1.5.3s", duration) && !parse_duration_us(".s", duration) ? "PASSED" : "FAILED!") << std::endl;
+
+        std::istringstream scenario("# Comment line\n"
+                                    "\n"
+                                    "1ms   eth0 rate 0      # Removes the rate\n"
+                                    "2s    eth1 delay 40ms\n"
+                                    "250us eth0 rate 5mbit\n"
+                                    "2s    eth1 loss 1.5%\n"
+                                    "2s    eth0 down\n"
+                                    "100us eth1 up\n");
+        std::vector<ScenarioEvent> events;
+        std::string error;
+        bool parsed = parse_scenario(scenario, events, error);
+        bool sorted_ok = parsed && events.size() == 6 && events[0].at_us == 100 && events[0].action == SCENARIO_UP &&
+                         events[1].at_us == 250 && events[1].rate_bps == 5000000 && events[2].at_us == 1000 &&
+                         events[2].action == SCENARIO_RATE && events[2].rate_bps == 0 && events[2].line == 3 &&
+                         events[3].action == SCENARIO_DELAY && events[3].delay_us == 40000 &&
+                         events[4].action == SCENARIO_LOSS && events[4].loss_percent == 1.5 && events[5].action == SCENARIO_DOWN;
+        std::cout << "Scenario sorted by time in microseconds, file order at equal times: " << (sorted_ok ? "PASSED" : "FAILED!") << std::endl;
+
+        bool all_refused = true;
+        for (const char* bad : {"5s eth0 rate", "5s eth0 rate fast", "5s eth0 delay soon", "5s eth0 loss 101%", "5s eth0 loss 2x",
+                                       "5s eth0 down now", "5s eth0 jump", "5s", "5x eth0 up", "5s eth0 clear 0", "1.5.3s eth0 up"})
+        {
+            std::istringstream line("0 eth0 up\n" + std::string(bad) + "\n");
+            std::vector<ScenarioEvent> refused;
+            error.clear();
+            bool refused_ok = !parse_scenario(line, refused, error) && error.find("ligne 2") != std::string::npos;
+            if (!refused_ok)
+            {
+                std::cout << "  accepted: \"" << bad << "\"" << std::endl;
+            }
+            all_refused = all_refused && refused_ok;
+        }
+        std::cout << "Unreadable scenario lines are refused with their number: " << (all_refused ? "PASSED" : "FAILED!") << std::endl;
+
+        LinkCondition condition;
+        apply_to_condition(events[1], condition); // rate 5mbit
+        apply_to_condition(events[3], condition); // delay 40ms
+        apply_to_condition(events[4], condition); // loss 1.5%
+        bool cumulated = condition.rate_bps == 5000000 && condition.delay_us == 40000 && condition.loss_percent == 1.5;
+        apply_to_condition(events[5], condition); // down
+        bool down_kept = condition.rate_bps == 5000000 && condition.delay_us == 40000;
+        ScenarioEvent clear;
+        clear.action = SCENARIO_CLEAR;
+        apply_to_condition(clear, condition);
+        bool cleared = condition.rate_bps == 0 && condition.delay_us == 0 && condition.loss_percent == 0;
+        std::cout << "Conditions add up, down keeps them, clear removes them: " << (cumulated && down_kept && cleared ? "PASSED" : "FAILED!") << std::endl;
+    }
+
     std::cout << "\n--- Testing the display of neightbor---" << std::endl;
     std::cout << display_neighbor_routers("R5", lsdb_5) << std::endl;
     std::cout << display_neighbor_routers("R6", lsdb_5) << std::endl;
@@ -0,0 +1,315 @@
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstring>
+#include "wire.h"
+
+static void put_u32(uint8_t* buffer, uint32_t value)
+{
+    buffer[0] = value >> 24;
+    buffer[1] = value >> 16;
+    buffer[2] = value >> 8;
+    buffer[3] = value;
+}
+
+static uint32_t get_u32(const uint8_t* buffer)
+{
+    return ((uint32_t)buffer[0] << 24) | ((uint32_t)buffer[1] << 16) | ((uint32_t)buffer[2] << 8) | buffer[3];
+}
+
+// "R123" -> 123, only for names that give back the same string with router_id_to_name
+bool router_name_to_id(const std::string& router_name, uint32_t& router_id)
+{
+    size_t length = router_name.length();
+    if (length < 2 || length > 7 || router_name[0] != 'R')
+    {
+        return false;
+    }
+    if (router_name[1] == '0' && length > 2)
+    {
+        return false; // "R007" is a valid name but would come back as "R7"
+    }
+
+    uint32_t value = 0;
+    for (size_t i = 1; i < length; ++i)
+    {
+        if (router_name[i] < '0' || router_name[i] > '9')
+        {
+            return false;
+        }
+        value = value * 10 + (router_name[i] - '0');
+    }
+
+    router_id = value; // 6 digits at most so always in R0-R999999
+    return true;
+}
+
+std::string router_id_to_name(uint32_t router_id)
+{
+    return "R" + std::to_string(router_id);
+}
+
+bool to_wire_declaration(const RouterDeclaration& declaration, WireDeclaration& wire)
+{
+    if (!router_name_to_id(declaration.router_name, wire.router_id))
+    {
+        return false;
+    }
+    if (!parse_ip_with_mask(declaration.ip_with_mask, wire.address, wire.prefix_len))
+    {
+        return false;
+    }
+    wire.link_cost = declaration.link_cost;
+    wire.sequence = declaration.timestamp;
+    wire.capacity_mbps = declaration.capacity_mbps;
+    return true;
+}
+
+RouterDeclaration from_wire_declaration(const WireDeclaration& wire)
+{
+    RouterDeclaration declaration;
+    declaration.router_name = router_id_to_name(wire.router_id);
+    declaration.ip_with_mask = uint_to_ip(wire.address) + "/" + std::to_string(wire.prefix_len);
+    declaration.link_cost = wire.link_cost;
+    declaration.timestamp = wire.sequence;
+    declaration.capacity_mbps = wire.capacity_mbps;
+    return declaration;
+}
+
+size_t encode_wire_declaration(const WireDeclaration& wire, uint8_t* buffer, size_t buffer_size)
+{
+    size_t size = (wire.capacity_mbps != 0) ? WIRE_DECLARATION_CAPACITY_SIZE : WIRE_DECLARATION_SIZE;
+    if (buffer_size < size)
+    {
+        return 0;
+    }
+
+    buffer[0] = WIRE_FORMAT_BINARY;
+    buffer[1] = (wire.capacity_mbps != 0) ? WIRE_MSG_DECLARATION_CAPACITY : WIRE_MSG_DECLARATION;
+    put_u32(buffer + 2, wire.router_id);
+    put_u32(buffer + 6, wire.address);
+    buffer[10] = wire.prefix_len;
+    buffer[11] = 0;
+    put_u32(buffer + 12, (uint32_t)wire.link_cost);
+    put_u32(buffer + 16, (uint32_t)((uint64_t)wire.sequence >> 32));
+    put_u32(buffer + 20, (uint32_t)wire.sequence);
+    if (wire.capacity_mbps != 0)
+    {
+        put_u32(buffer + 24, wire.capacity_mbps);
+    }
+    return size;
+}
+
+bool decode_wire_declaration(const uint8_t* buffer, size_t length, WireDeclaration& wire, size_t* record_size)
+{
+    if (buffer == nullptr || length < WIRE_DECLARATION_SIZE || buffer[0] != WIRE_FORMAT_BINARY)
+    {
+        return false;
+    }
+    size_t size;
+    if (buffer[1] == WIRE_MSG_DECLARATION)
+    {
+        size = WIRE_DECLARATION_SIZE;
+        wire.capacity_mbps = 0;
+    }
+    else if (buffer[1] == WIRE_MSG_DECLARATION_CAPACITY && length >= WIRE_DECLARATION_CAPACITY_SIZE)
+    {
+        size = WIRE_DECLARATION_CAPACITY_SIZE;
+        wire.capacity_mbps = get_u32(buffer + 24);
+    }
+    else
+    {
+        return false;
+    }
+    if (record_size)
+    {
+        *record_size = size;
+    }
+
+    wire.router_id = get_u32(buffer + 2);
+    wire.address = get_u32(buffer + 6);
+    wire.prefix_len = buffer[10];
+    wire.link_cost = (int32_t)get_u32(buffer + 12);
+    wire.sequence = (int64_t)(((uint64_t)get_u32(buffer + 16) << 32) | get_u32(buffer + 20));
+
+    // Same limits as isValidRouterName and assert_ip_and_mask
+    if (wire.router_id > 999999 || wire.prefix_len > 32)
+    {
+        return false;
+    }
+    return true;
+}
+
+size_t encode_wire_hello(const WireHello& hello, uint8_t* buffer, size_t buffer_size)
+{
+    size_t name_length = hello.router_name.length();
+    if (name_length == 0 || name_length > WIRE_HELLO_MAX_NAME || buffer_size < WIRE_HELLO_HEADER_SIZE + name_length)
+    {
+        return 0;
+    }
+
+    buffer[0] = WIRE_FORMAT_BINARY;
+    buffer[1] = WIRE_MSG_HELLO;
+    put_u32(buffer + 2, hello.address);
+    buffer[6] = hello.prefix_len;
+    buffer[7] = name_length;
+    put_u32(buffer + 8, hello.hello_interval_ms);
+    put_u32(buffer + 12, hello.dead_interval_ms);
+    memcpy(buffer + WIRE_HELLO_HEADER_SIZE, hello.router_name.data(), name_length);
+    return WIRE_HELLO_HEADER_SIZE + name_length;
+}
+
+bool decode_wire_hello(const uint8_t* buffer, size_t length, WireHello& hello)
+{
+    if (buffer == nullptr || length < WIRE_HELLO_HEADER_SIZE)
+    {
+        return false;
+    }
+    if (buffer[0] != WIRE_FORMAT_BINARY || buffer[1] != WIRE_MSG_HELLO)
+    {
+        return false;
+    }
+
+    size_t name_length = buffer[7];
+    if (name_length == 0 || name_length > WIRE_HELLO_MAX_NAME || length < WIRE_HELLO_HEADER_SIZE + name_length)
+    {
+        return false;
+    }
+
+    hello.address = get_u32(buffer + 2);
+    hello.prefix_len = buffer[6];
+    hello.hello_interval_ms = get_u32(buffer + 8);
+    hello.dead_interval_ms = get_u32(buffer + 12);
+    hello.router_name.assign((const char*)buffer + WIRE_HELLO_HEADER_SIZE, name_length);
+    if (hello.prefix_len > 32 || hello.dead_interval_ms == 0 || !isValidRouterName(hello.router_name))
+    {
+        return false;
+    }
+    return true;
+}
+
+int detect_wire_format(const uint8_t* buffer, size_t length)
+{
+    if (buffer == nullptr || length == 0)
+    {
+        return -1;
+    }
+    if (buffer[0] == '{')
+    {
+        return WIRE_FORMAT_TEXT;
+    }
+    if (buffer[0] == WIRE_FORMAT_BINARY)
+    {
+        return WIRE_FORMAT_BINARY;
+    }
+    return -1;
+}
+
+std::string encode_router_declaration(const RouterDeclaration& declaration, WireFormat format)
+{
+    WireDeclaration wire;
+    if (format == WIRE_FORMAT_BINARY && to_wire_declaration(declaration, wire))
+    {
+        uint8_t buffer[WIRE_DECLARATION_CAPACITY_SIZE];
+        size_t length = encode_wire_declaration(wire, buffer, sizeof(buffer));
+        return std::string((const char*)buffer, length);
+    }
+    // Router names that are not "R<number>" can only be sent as text
+    return serialize_router_definition(declaration);
+}
+
+// Put as many declarations as possible in each datagram, a record is never split in two
+std::vector<std::string> pack_router_declarations(const std::vector<RouterDeclaration>& declarations, WireFormat format, size_t max_datagram_size)
+{
+    std::vector<size_t> counts;
+    return pack_router_declarations(declarations, format, max_datagram_size, counts);
+}
+
+std::vector<std::string> pack_router_declarations(const std::vector<RouterDeclaration>& declarations, WireFormat format, size_t max_datagram_size,
+                                                  std::vector<size_t>& counts)
+{
+    std::vector<std::string> datagrams;
+    std::string current;
+    current.reserve(max_datagram_size);
+    counts.clear();
+    size_t count = 0;
+
+    for (const RouterDeclaration& declaration : declarations)
+    {
+        std::string record = encode_router_declaration(declaration, format);
+        if (!current.empty() && current.size() + record.size() > max_datagram_size)
+        {
+            datagrams.push_back(current);
+            counts.push_back(count);
+            current.clear();
+            count = 0;
+        }
+        current += record; // A record bigger than max_datagram_size still goes alone
+        count++;
+    }
+
+    if (!current.empty())
+    {
+        datagrams.push_back(current);
+        counts.push_back(count);
+    }
+    return datagrams;
+}
+
+// Split a datagram that can hold several declarations, text and binary records can be mixed
+// Returns the number of records that could not be read, decoding stops at the first unknown byte
+size_t decode_router_declarations(const uint8_t* buffer, size_t length, std::vector<RouterDeclaration>& declarations)
+{
+    size_t invalid = 0;
+    size_t pos = 0;
+
+    while (pos < length)
+    {
+        int format = detect_wire_format(buffer + pos, length - pos);
+        if (format == WIRE_FORMAT_BINARY)
+        {
+            WireDeclaration wire;
+            size_t record_size;
+            if (!decode_wire_declaration(buffer + pos, length - pos, wire, &record_size))
+            {
+                return invalid + 1; // Truncated or unknown record, the rest can't be trusted
+            }
+            if (is_valid_link_cost(wire.link_cost))
+            {
+                declarations.push_back(from_wire_declaration(wire));
+            }
+            else
+            {
+                invalid++; // The record is well formed, only this one is refused
+            }
+            pos += record_size;
+        }
+        else if (format == WIRE_FORMAT_TEXT)
+        {
+            size_t end = pos;
+            while (end < length && buffer[end] != '}')
+            {
+                end++;
+            }
+            if (end == length)
+            {
+                return invalid + 1; // Missing '}'
+            }
+
+            try
+            {
+                declarations.push_back(deserialize_router_definition(std::string((const char*)buffer + pos, end - pos + 1)));
+            }
+            catch (const std::exception& e)
+            {
+                invalid++; // This record is bad but the next one starts after the '}'
+            }
+            pos = end + 1;
+        }
+        else
+        {
+            return invalid + 1;
+        }
+    }
+    return invalid;
+}
@@ -0,0 +1,97 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "logic.h" // For RouterDeclaration
+
+// Versions of the declaration encoding, the first byte of a datagram tells which one is used
+// Version 1 is the text format "{1,R1,10.0.1.1/24,5,1700000000000}" so its first byte is '{'
+enum WireFormat {
+    WIRE_FORMAT_TEXT = 1,
+    WIRE_FORMAT_BINARY = 2,
+};
+
+// Message types of the binary format
+enum WireMessageType {
+    WIRE_MSG_DECLARATION = 1,
+    WIRE_MSG_HELLO = 2,
+    WIRE_MSG_DECLARATION_CAPACITY = 3, // Declaration followed by the capacity of the link
+};
+
+// Binary declaration, all fields in network byte order :
+//  0      version (WIRE_FORMAT_BINARY)
+//  1      message type (WIRE_MSG_DECLARATION)
+//  2-5    router id (the number of "R<id>")
+//  6-9    router ip on the subnet
+//  10     prefix length
+//  11     reserved (0)
+//  12-15  link cost
+//  16-23  sequence (the declaration timestamp, used to know which one is newer)
+const size_t WIRE_DECLARATION_SIZE = 24;
+// Same record with WIRE_MSG_DECLARATION_CAPACITY as message type and 4 more bytes :
+//  24-27  nominal capacity of the link in Mbit/s
+// Only sent when the capacity is known, routers that don't know this type stop reading the datagram there
+const size_t WIRE_DECLARATION_CAPACITY_SIZE = 28;
+
+struct WireDeclaration {
+    uint32_t router_id;
+    uint32_t address;
+    uint8_t prefix_len;
+    int32_t link_cost;
+    int64_t sequence;
+    uint32_t capacity_mbps = 0;
+};
+
+bool router_name_to_id(const std::string& router_name, uint32_t& router_id);
+std::string router_id_to_name(uint32_t router_id);
+bool to_wire_declaration(const RouterDeclaration& declaration, WireDeclaration& wire);
+RouterDeclaration from_wire_declaration(const WireDeclaration& wire);
+
+// No allocation : write into / read from a caller buffer, both return 0 / false if it doesn't fit
+// decode_wire_declaration sets the size of the record it read in record_size
+size_t encode_wire_declaration(const WireDeclaration& wire, uint8_t* buffer, size_t buffer_size);
+bool decode_wire_declaration(const uint8_t* buffer, size_t length, WireDeclaration& wire, size_t* record_size = nullptr);
+
+// Hello, sent on its own port (WIRE_HELLO_PORT) so routers without hellos never see it :
+//  0      version (WIRE_FORMAT_BINARY)
+//  1      message type (WIRE_MSG_HELLO)
+//  2-5    sender ip on the subnet
+//  6      prefix length
+//  7      length of the router name
+//  8-11   hello interval in ms
+//  12-15  dead interval in ms, the receiver declares the sender down after that long without a hello
+//  16-    router name, as text like in the text format (router_name_to_id refuses some valid names)
+const size_t WIRE_HELLO_HEADER_SIZE = 16;
+const size_t WIRE_HELLO_MAX_NAME = 64;
+const int WIRE_HELLO_PORT = 8081;
+
+struct WireHello {
+    std::string router_name;
+    uint32_t address;
+    uint8_t prefix_len;
+    uint32_t hello_interval_ms;
+    uint32_t dead_interval_ms;
+};
+
+size_t encode_wire_hello(const WireHello& hello, uint8_t* buffer, size_t buffer_size);
+bool decode_wire_hello(const uint8_t* buffer, size_t length, WireHello& hello);
+
+int detect_wire_format(const uint8_t* buffer, size_t length); // WireFormat or -1
+
+// Encode with the asked format, falls back to text when the declaration can't be sent in binary
+std::string encode_router_declaration(const RouterDeclaration& declaration, WireFormat format);
+
+// Datagrams can carry several declarations one after the other
+// 1500 bytes ethernet MTU - 20 bytes IPv4 header - 8 bytes UDP header
+const size_t WIRE_MAX_DATAGRAM_SIZE = 1472;
+
+std::vector<std::string> pack_router_declarations(const std::vector<RouterDeclaration>& declarations, WireFormat format, size_t max_datagram_size = WIRE_MAX_DATAGRAM_SIZE);
+// Same datagrams, counts gets the number of declarations in each of them
+std::vector<std::string> pack_router_declarations(const std::vector<RouterDeclaration>& declarations, WireFormat format, size_t max_datagram_size,
+                                                  std::vector<size_t>& counts);
+size_t decode_router_declarations(const uint8_t* buffer, size_t length, std::vector<RouterDeclaration>& declarations);
+
+#endif // WIRE_H